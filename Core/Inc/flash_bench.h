@@ -0,0 +1,81 @@
+/**
+ * \file            flash_bench.h
+ * \brief           On-target W25Q throughput benchmark
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef FLASH_BENCH_HDR_H
+#define FLASH_BENCH_HDR_H
+
+#include <stdint.h>
+#include "main.h"
+#include "w25q.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           Scratch region used by benchmark, one 64KB block is erased
+ */
+#ifndef FLASH_BENCH_ADDR
+#define FLASH_BENCH_ADDR                0x00100000UL
+#endif
+
+/**
+ * \brief           Number of timed calls per operation and size, at most 16
+ */
+#ifndef FLASH_BENCH_ITERATIONS
+#define FLASH_BENCH_ITERATIONS          16
+#endif
+
+/**
+ * \brief           Number of log2 latency histogram buckets (1us to 2^(n-1) us)
+ */
+#define FLASH_BENCH_HIST_BUCKETS        20
+
+/**
+ * \brief           Result of one operation at one transfer size
+ */
+typedef struct {
+    uint32_t count;                             /*!< Number of samples */
+    uint32_t min_us;                            /*!< Fastest call */
+    uint32_t max_us;                            /*!< Slowest call */
+    uint64_t total_cycles;                      /*!< Sum of all calls in CPU cycles */
+    uint16_t hist[FLASH_BENCH_HIST_BUCKETS];    /*!< Calls per latency bucket, bucket `n` is [2^n, 2^(n+1)) us */
+} flash_bench_result_t;
+
+w25q_result_t   flash_bench_run(w25q_t* dev, SPI_HandleTypeDef* hspi, uint32_t address);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* FLASH_BENCH_HDR_H */
@@ -0,0 +1,99 @@
+/**
+ * \file            flash_link.h
+ * \brief           Binary flash programming protocol over USART1/RS485
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef FLASH_LINK_HDR_H
+#define FLASH_LINK_HDR_H
+
+#include <stdint.h>
+#include "main.h"
+#include "w25q.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           UART baudrate used during session, `0` keeps current setting
+ */
+#ifndef FLASH_LINK_BAUD
+#define FLASH_LINK_BAUD                 460800UL
+#endif
+
+/**
+ * \brief           DMA receive ring size in bytes
+ * \note            Must hold at least \ref FLASH_LINK_WINDOW maximum size frames
+ */
+#ifndef FLASH_LINK_RX_SIZE
+#define FLASH_LINK_RX_SIZE              8192
+#endif
+
+/**
+ * \brief           Maximum data bytes in write and read frames
+ */
+#define FLASH_LINK_MAX_DATA             1024
+
+/**
+ * \brief           Number of frames the host may send in one burst before waiting for a reply
+ */
+#define FLASH_LINK_WINDOW               4
+
+/**
+ * \brief           Maximum number of sectors in one CRC request
+ */
+#define FLASH_LINK_MAX_CRC_SECTORS      64
+
+/**
+ * \brief           Protocol version reported in hello reply
+ */
+#define FLASH_LINK_VERSION              2
+
+/**
+ * \brief           Frame types, replies use `type | FLASH_LINK_REPLY`
+ */
+#define FLASH_LINK_HELLO                0x01    /*!< Get device parameters */
+#define FLASH_LINK_SECTOR_CRC           0x02    /*!< CRC-32 of consecutive sectors */
+#define FLASH_LINK_ERASE                0x03    /*!< Erase sector-aligned range */
+#define FLASH_LINK_WRITE                0x04    /*!< Program data, target must be erased */
+#define FLASH_LINK_READ                 0x05    /*!< Read data */
+#define FLASH_LINK_END                  0x06    /*!< End session */
+#define FLASH_LINK_NAK                  0x7F    /*!< Frame lost, `seq` is next expected frame */
+#define FLASH_LINK_POLL                 0x40    /*!< Set on last host frame of a burst, target replies */
+#define FLASH_LINK_REPLY                0x80
+
+w25q_result_t   flash_link_run(w25q_t* dev, UART_HandleTypeDef* huart, uint32_t idle_timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* FLASH_LINK_HDR_H */
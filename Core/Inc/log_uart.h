@@ -0,0 +1,71 @@
+/**
+ * \file            log_uart.h
+ * \brief           Interrupt driven ring buffered UART log output
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef LOG_UART_HDR_H
+#define LOG_UART_HDR_H
+
+#include <stdint.h>
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           Transmit ring size in bytes
+ */
+#ifndef LOG_UART_BUF_SIZE
+#define LOG_UART_BUF_SIZE               2048
+#endif
+
+/**
+ * \brief           Log output statistics
+ */
+typedef struct {
+    uint32_t written;                           /*!< Bytes accepted into ring */
+    uint32_t dropped;                           /*!< Bytes dropped because ring was full or output disabled */
+    uint32_t dropped_writes;                    /*!< Write calls dropped */
+    uint32_t high_water;                        /*!< Highest ring fill level */
+} log_uart_stats_t;
+
+void            log_uart_init(UART_HandleTypeDef* huart);
+void            log_uart_enable(uint8_t enable);
+uint32_t        log_uart_write(const void* data, uint32_t len);
+uint8_t         log_uart_flush(uint32_t timeout_ms);
+void            log_uart_get_stats(log_uart_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* LOG_UART_HDR_H */
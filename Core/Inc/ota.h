@@ -0,0 +1,125 @@
+/**
+ * \file            ota.h
+ * \brief           Firmware update staged in W25Q flash
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef OTA_HDR_H
+#define OTA_HDR_H
+
+#include <stdint.h>
+#include "main.h"
+#include "w25q.h"
+#include "w25q_unpack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           Internal flash address the image is installed to
+ * \note            Installer must run from code outside of the application region,
+ *                  \ref ota_install returns \ref W25Q_ERR_PARAM otherwise
+ */
+#ifndef OTA_APP_ADDR
+#define OTA_APP_ADDR                    0x08008000UL
+#endif
+
+/**
+ * \brief           End of internal flash (exclusive)
+ */
+#ifndef OTA_APP_END
+#define OTA_APP_END                     (FLASH_BANK1_END + 1UL)
+#endif
+
+/**
+ * \brief           Verify raw images with \ref ota_verify before installing
+ *
+ * Keeps a corrupt slot away from internal flash, at the cost of reading the
+ * whole image twice. With `0` the single install pass checks the CRC at the
+ * end, and a corrupt image leaves a partly written application.
+ */
+#ifndef OTA_VERIFY_BEFORE_INSTALL
+#define OTA_VERIFY_BEFORE_INSTALL       0
+#endif
+
+/**
+ * \brief           Offset of image data in W25Q slot, first page holds the header
+ */
+#define OTA_DATA_OFFSET                 256UL
+
+/**
+ * \brief           Image header stored in the first page of a W25Q slot
+ */
+typedef struct {
+    uint32_t size;                              /*!< Stored image size in bytes */
+    uint32_t crc;                               /*!< CRC-32 of stored image */
+    uint8_t format;                             /*!< Combination of `W25Q_UNPACK_*` flags */
+    uint8_t window_bits;                        /*!< LZ window bits for compressed images */
+    uint32_t out_size;                          /*!< Size of decoded firmware */
+    uint32_t out_crc;                           /*!< CRC-32 of decoded firmware */
+} ota_image_t;
+
+/**
+ * \brief           Image staging context
+ */
+typedef struct {
+    w25q_t* dev;                                /*!< Flash device */
+    uint32_t slot_addr;                         /*!< Slot start address (sector-aligned) */
+    uint32_t size;                              /*!< Expected image size */
+    uint32_t written;                           /*!< Bytes received so far */
+    uint32_t erased_end;                        /*!< Slot offset up to which flash is erased */
+    uint32_t crc;                               /*!< Running CRC of data read back from W25Q */
+    uint16_t fill;                              /*!< Bytes in page buffer */
+    uint8_t page[256];                          /*!< Page buffer */
+} ota_t;
+
+/**
+ * \brief           Install statistics
+ */
+typedef struct {
+    uint32_t pages_skipped;                     /*!< Internal pages already holding image data */
+    uint32_t pages_erased;                      /*!< Internal pages erased */
+    uint32_t halfwords_programmed;              /*!< Half-words programmed */
+    uint32_t bytes_read;                        /*!< Bytes read from W25Q slot */
+} ota_install_stats_t;
+
+w25q_result_t   ota_begin(ota_t* ota, w25q_t* dev, uint32_t slot_addr, uint32_t size);
+w25q_result_t   ota_write(ota_t* ota, const uint8_t* data, uint32_t len);
+w25q_result_t   ota_finish(ota_t* ota, const ota_image_t* image);
+w25q_result_t   ota_get_image(w25q_t* dev, uint32_t slot_addr, ota_image_t* image);
+w25q_result_t   ota_verify(w25q_t* dev, uint32_t slot_addr);
+w25q_result_t   ota_install(w25q_t* dev, uint32_t slot_addr, ota_install_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* OTA_HDR_H */
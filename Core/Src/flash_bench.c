@@ -0,0 +1,243 @@
+/**
+ * \file            flash_bench.c
+ * \brief           On-target W25Q throughput benchmark implementation
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#include "flash_bench.h"
+#include "log_uart.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FLASH_BENCH_BLOCK_SIZE          65536UL
+
+/* Each program size fills one 4KB sector of 16 pages, 4KB erases sweep the 64KB block */
+#if FLASH_BENCH_ITERATIONS > 16
+#error "FLASH_BENCH_ITERATIONS must not exceed 16"
+#endif
+
+/* SPI prescalers swept, fastest first */
+static const uint32_t bench_prescalers[] = {
+    SPI_BAUDRATEPRESCALER_2, SPI_BAUDRATEPRESCALER_4, SPI_BAUDRATEPRESCALER_8,
+    SPI_BAUDRATEPRESCALER_16, SPI_BAUDRATEPRESCALER_32,
+};
+static const uint32_t bench_read_sizes[] = {16, 256, 4096};
+static const uint32_t bench_program_sizes[] = {16, 64, 256};
+
+static uint8_t bench_buf[4096];
+
+/**
+ * \brief           Start DWT cycle counter
+ */
+static void
+prv_cycles_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * \brief           Add sample to result
+ * \param[in,out]   res: Result to update
+ * \param[in]       cycles: Call duration in CPU cycles
+ */
+static void
+prv_sample(flash_bench_result_t* res, uint32_t cycles) {
+    uint32_t us, bucket;
+
+    us = cycles / (SystemCoreClock / 1000000UL);
+    if (res->count == 0 || us < res->min_us) {
+        res->min_us = us;
+    }
+    if (us > res->max_us) {
+        res->max_us = us;
+    }
+    res->count++;
+    res->total_cycles += cycles;
+
+    for (bucket = 0; bucket < FLASH_BENCH_HIST_BUCKETS - 1 && (us >> (bucket + 1)) != 0; ++bucket) {}
+    res->hist[bucket]++;
+}
+
+/**
+ * \brief           Print result line and histogram
+ * \param[in]       op: Operation name
+ * \param[in]       size: Bytes per call
+ * \param[in]       spi_khz: SPI clock
+ * \param[in]       res: Result to print
+ */
+static void
+prv_report(const char* op, uint32_t size, uint32_t spi_khz, const flash_bench_result_t* res) {
+    uint32_t avg_us, kbps;
+    uint64_t total_us;
+
+    total_us = res->total_cycles / (SystemCoreClock / 1000000UL);
+    avg_us = res->count > 0 ? (uint32_t)(total_us / res->count) : 0;
+    kbps = total_us > 0 ? (uint32_t)((uint64_t)size * res->count * 1000000ULL / 1024ULL / total_us) : 0;
+
+    printf("bench,%lu,%s,%lu,%lu,%lu,%lu,%lu,%lu\r\n", (unsigned long)spi_khz, op, (unsigned long)size,
+           (unsigned long)res->count, (unsigned long)res->min_us, (unsigned long)avg_us,
+           (unsigned long)res->max_us, (unsigned long)kbps);
+    printf("hist,%lu,%s,%lu", (unsigned long)spi_khz, op, (unsigned long)size);
+    for (uint32_t i = 0; i < FLASH_BENCH_HIST_BUCKETS; ++i) {
+        printf(",%u", res->hist[i]);
+    }
+    printf("\r\n");
+
+    /* Drain output so UART interrupts do not disturb the next measurement */
+    log_uart_flush(1000);
+}
+
+/**
+ * \brief           Run all operations at current SPI clock
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: 64KB aligned scratch block
+ * \param[in]       spi_khz: SPI clock for report
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_run_clock(w25q_t* dev, uint32_t address, uint32_t spi_khz) {
+    flash_bench_result_t res;
+    w25q_result_t r;
+    uint32_t start, i, s;
+
+    /* Reads */
+    for (s = 0; s < sizeof(bench_read_sizes) / sizeof(bench_read_sizes[0]); ++s) {
+        memset(&res, 0, sizeof(res));
+        for (i = 0; i < FLASH_BENCH_ITERATIONS; ++i) {
+            start = DWT->CYCCNT;
+            r = w25q_read(dev, address + (i * bench_read_sizes[s]) % FLASH_BENCH_BLOCK_SIZE, bench_buf,
+                          bench_read_sizes[s]);
+            prv_sample(&res, DWT->CYCCNT - start);
+            if (r != W25Q_OK) {
+                return r;
+            }
+        }
+        prv_report("read", bench_read_sizes[s], spi_khz, &res);
+    }
+
+    /* Page programs into freshly erased block, erase itself not timed */
+    if ((r = w25q_erase_block_64k(dev, address)) != W25Q_OK) {
+        return r;
+    }
+    memset(bench_buf, 0x5A, sizeof(bench_buf));
+    for (s = 0; s < sizeof(bench_program_sizes) / sizeof(bench_program_sizes[0]); ++s) {
+        memset(&res, 0, sizeof(res));
+        for (i = 0; i < FLASH_BENCH_ITERATIONS; ++i) {
+            /* Each size uses its own 4KB sector, one page per call */
+            start = DWT->CYCCNT;
+            r = w25q_write_page(dev, address + s * 4096UL + i * 256UL, bench_buf, bench_program_sizes[s]);
+            prv_sample(&res, DWT->CYCCNT - start);
+            if (r != W25Q_OK) {
+                return r;
+            }
+        }
+        prv_report("program", bench_program_sizes[s], spi_khz, &res);
+    }
+
+    /* Erases */
+    memset(&res, 0, sizeof(res));
+    for (i = 0; i < FLASH_BENCH_ITERATIONS; ++i) {
+        start = DWT->CYCCNT;
+        r = w25q_erase_sector(dev, address + i * 4096UL);
+        prv_sample(&res, DWT->CYCCNT - start);
+        if (r != W25Q_OK) {
+            return r;
+        }
+    }
+    prv_report("erase", 4096, spi_khz, &res);
+
+    memset(&res, 0, sizeof(res));
+    for (i = 0; i < 2; ++i) {
+        start = DWT->CYCCNT;
+        r = w25q_erase_block_32k(dev, address + i * 32768UL);
+        prv_sample(&res, DWT->CYCCNT - start);
+        if (r != W25Q_OK) {
+            return r;
+        }
+    }
+    prv_report("erase", 32768, spi_khz, &res);
+
+    memset(&res, 0, sizeof(res));
+    start = DWT->CYCCNT;
+    r = w25q_erase_block_64k(dev, address);
+    prv_sample(&res, DWT->CYCCNT - start);
+    if (r != W25Q_OK) {
+        return r;
+    }
+    prv_report("erase", 65536, spi_khz, &res);
+
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Benchmark reads, page programs and erases at several SPI clocks
+ *
+ * Results are printed as CSV lines:
+ * `bench,spi_khz,op,size,count,min_us,avg_us,max_us,kb_per_s` followed by
+ * `hist,spi_khz,op,size,<FLASH_BENCH_HIST_BUCKETS counts>`.
+ *
+ * \note            Content of the 64KB block at `address` is destroyed
+ * \param[in]       dev: Initialized W25Q device handle
+ * \param[in]       hspi: SPI handle used by the low-level port, prescaler is restored on return
+ * \param[in]       address: 64KB aligned scratch block
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+flash_bench_run(w25q_t* dev, SPI_HandleTypeDef* hspi, uint32_t address) {
+    uint32_t prescaler, spi_khz;
+    w25q_result_t res = W25Q_OK;
+
+    if (dev == NULL || hspi == NULL || (address % FLASH_BENCH_BLOCK_SIZE) != 0) {
+        return W25Q_ERR_PARAM;
+    }
+
+    prv_cycles_init();
+    prescaler = hspi->Init.BaudRatePrescaler;
+    printf("bench,spi_khz,op,size,count,min_us,avg_us,max_us,kb_per_s\r\n");
+
+    for (uint32_t p = 0; p < sizeof(bench_prescalers) / sizeof(bench_prescalers[0]); ++p) {
+        hspi->Init.BaudRatePrescaler = bench_prescalers[p];
+        if (HAL_SPI_Init(hspi) != HAL_OK) {
+            res = W25Q_ERR;
+            break;
+        }
+        spi_khz = HAL_RCC_GetPCLK2Freq() / (2UL << (bench_prescalers[p] >> SPI_CR1_BR_Pos)) / 1000UL;
+        if ((res = prv_run_clock(dev, address, spi_khz)) != W25Q_OK) {
+            break;
+        }
+    }
+
+    hspi->Init.BaudRatePrescaler = prescaler;
+    if (HAL_SPI_Init(hspi) != HAL_OK && res == W25Q_OK) {
+        res = W25Q_ERR;
+    }
+    return res;
+}
@@ -0,0 +1,485 @@
+/**
+ * \file            flash_link.c
+ * \brief           Binary flash programming protocol over USART1/RS485 implementation
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+
+/*
+ * Frame layout, multi-byte values little-endian:
+ *
+ *  0xA5 | type | seq | len (2) | payload (len) | CRC-32 of type..payload (4)
+ *
+ * Host frames and payloads:
+ *  HELLO       -
+ *  SECTOR_CRC  address (4), sector count (4)
+ *  ERASE       address (4), length (4), both sector-aligned
+ *  WRITE       address (4), data (up to FLASH_LINK_MAX_DATA)
+ *  READ        address (4), length (4)
+ *  END         -
+ *
+ * The line is half-duplex RS485, so the target only transmits while the
+ * host listens. The host sends bursts of up to FLASH_LINK_WINDOW frames back
+ * to back and marks the last one with FLASH_LINK_POLL in the type, then
+ * stops. Frames are executed in sequence order as they arrive, so reception
+ * of the next frames by DMA overlaps programming of the current one. Only a
+ * poll frame is answered, with a reply frame of the same seq carrying a
+ * status byte (w25q_result_t) and 3 padding bytes, followed by data for
+ * HELLO (window, version, device ID, max data, capacity), SECTOR_CRC (CRC
+ * per sector) and READ. A reply confirms all frames up to its seq; frames
+ * with reply data always end a burst. If a frame of the burst fails, the
+ * rest of the burst is dropped and the reply carries seq and status of the
+ * failed frame instead.
+ *
+ * Frames with bad CRC or out of order seq are dropped. A poll frame after a
+ * gap is answered with a NAK carrying the expected seq, a lost poll frame
+ * makes the host time out; either way the host resends from the first
+ * unconfirmed frame. Already executed frames that arrive again are
+ * confirmed without running erase or write a second time.
+ */
+#include "flash_link.h"
+#include "log_uart.h"
+#include "w25q_crc.h"
+#include <string.h>
+
+#define FLASH_LINK_SOF                  0xA5
+#define FLASH_LINK_HDR_SIZE             5
+#define FLASH_LINK_CRC_SIZE             4
+#define FLASH_LINK_MAX_PAYLOAD          (8 + FLASH_LINK_MAX_DATA)
+#define FLASH_LINK_MAX_FRAME            (FLASH_LINK_HDR_SIZE + FLASH_LINK_MAX_PAYLOAD + FLASH_LINK_CRC_SIZE)
+
+#define FLASH_LINK_SECTOR_SIZE          4096UL
+#define FLASH_LINK_BLOCK_SIZE           65536UL
+#define FLASH_LINK_PAGE_SIZE            256UL
+
+/**
+ * \brief           Session state
+ */
+typedef struct {
+    w25q_t* dev;                                /*!< Flash device */
+    UART_HandleTypeDef* huart;                  /*!< UART handle */
+    uint32_t rd;                                /*!< Read index in receive ring */
+    uint8_t expect;                             /*!< Next expected sequence number */
+    uint8_t err_type;                           /*!< Type of failed frame `expect` in current burst */
+    w25q_result_t err;                          /*!< Status of failed frame, \ref W25Q_OK if none */
+    uint8_t done;                               /*!< End frame executed */
+} flash_link_t;
+
+static uint8_t link_rx[FLASH_LINK_RX_SIZE];
+static uint8_t link_frame[FLASH_LINK_MAX_FRAME];
+static uint8_t link_tx[4 + FLASH_LINK_MAX_CRC_SECTORS * 4 > 4 + FLASH_LINK_MAX_DATA
+                       ? 4 + FLASH_LINK_MAX_CRC_SECTORS * 4 : 4 + FLASH_LINK_MAX_DATA];
+static uint8_t link_page[FLASH_LINK_PAGE_SIZE];
+
+/**
+ * \brief           Store 32-bit value as little-endian
+ * \param[out]      buf: Output buffer
+ * \param[in]       val: Value to store
+ */
+static void
+prv_put_u32(uint8_t* buf, uint32_t val) {
+    buf[0] = (uint8_t)val;
+    buf[1] = (uint8_t)(val >> 8);
+    buf[2] = (uint8_t)(val >> 16);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
+/**
+ * \brief           Load little-endian 32-bit value
+ * \param[in]       buf: Input buffer
+ * \return          Loaded value
+ */
+static uint32_t
+prv_get_u32(const uint8_t* buf) {
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/**
+ * \brief           Get DMA write index in receive ring
+ * \param[in]       link: Session state
+ * \return          Index in range `0..FLASH_LINK_RX_SIZE-1`
+ */
+static uint32_t
+prv_rx_head(flash_link_t* link) {
+    return (FLASH_LINK_RX_SIZE - __HAL_DMA_GET_COUNTER(link->huart->hdmarx)) % FLASH_LINK_RX_SIZE;
+}
+
+/**
+ * \brief           Start or restart circular DMA reception
+ * \param[in]       link: Session state
+ */
+static void
+prv_rx_start(flash_link_t* link) {
+    HAL_UART_AbortReceive(link->huart);
+    link->rd = 0;
+    HAL_UART_Receive_DMA(link->huart, link_rx, FLASH_LINK_RX_SIZE);
+}
+
+/**
+ * \brief           Send frame, RS485 driver is enabled only while transmitting
+ * \param[in]       link: Session state
+ * \param[in]       type: Frame type
+ * \param[in]       seq: Sequence number
+ * \param[in]       payload: Payload, can be `NULL` if `len` is `0`
+ * \param[in]       len: Payload length
+ */
+static void
+prv_send(flash_link_t* link, uint8_t type, uint8_t seq, const uint8_t* payload, uint32_t len) {
+    uint8_t hdr[FLASH_LINK_HDR_SIZE], crc[FLASH_LINK_CRC_SIZE];
+    uint32_t c;
+
+    hdr[0] = FLASH_LINK_SOF;
+    hdr[1] = type;
+    hdr[2] = seq;
+    hdr[3] = (uint8_t)len;
+    hdr[4] = (uint8_t)(len >> 8);
+    c = w25q_crc32_update(W25Q_CRC32_INIT, &hdr[1], FLASH_LINK_HDR_SIZE - 1);
+    c = w25q_crc32_update(c, payload, len);
+    prv_put_u32(crc, W25Q_CRC32_FINAL(c));
+
+    HAL_GPIO_WritePin(RS485_TXEN_GPIO_Port, RS485_TXEN_Pin, GPIO_PIN_SET);
+    HAL_UART_Transmit(link->huart, hdr, sizeof(hdr), HAL_MAX_DELAY);
+    if (len > 0) {
+        HAL_UART_Transmit(link->huart, (uint8_t*)payload, (uint16_t)len, HAL_MAX_DELAY);
+    }
+    /* Blocking transmit returns after transmission complete flag, line is idle */
+    HAL_UART_Transmit(link->huart, crc, sizeof(crc), HAL_MAX_DELAY);
+    HAL_GPIO_WritePin(RS485_TXEN_GPIO_Port, RS485_TXEN_Pin, GPIO_PIN_RESET);
+}
+
+/**
+ * \brief           Send reply with status and optional data in `link_tx`
+ * \param[in]       link: Session state
+ * \param[in]       type: Request frame type
+ * \param[in]       seq: Request sequence number
+ * \param[in]       res: Execution status
+ * \param[in]       data_len: Data bytes in `link_tx` after status word
+ */
+static void
+prv_reply(flash_link_t* link, uint8_t type, uint8_t seq, w25q_result_t res, uint32_t data_len) {
+    link_tx[0] = (uint8_t)res;
+    link_tx[1] = 0;
+    link_tx[2] = 0;
+    link_tx[3] = 0;
+    prv_send(link, type | FLASH_LINK_REPLY, seq, link_tx, 4 + (res == W25Q_OK ? data_len : 0));
+}
+
+/**
+ * \brief           Erase sector-aligned range with largest possible erase units
+ * \param[in]       dev: Flash device
+ * \param[in]       address: Start address
+ * \param[in]       len: Length in bytes
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_erase(w25q_t* dev, uint32_t address, uint32_t len) {
+    w25q_result_t res = W25Q_OK;
+
+    if ((address % FLASH_LINK_SECTOR_SIZE) != 0 || (len % FLASH_LINK_SECTOR_SIZE) != 0) {
+        return W25Q_ERR_PARAM;
+    }
+    while (len > 0 && res == W25Q_OK) {
+        if ((address % FLASH_LINK_BLOCK_SIZE) == 0 && len >= FLASH_LINK_BLOCK_SIZE) {
+            res = w25q_erase_block_64k(dev, address);
+            address += FLASH_LINK_BLOCK_SIZE;
+            len -= FLASH_LINK_BLOCK_SIZE;
+        } else {
+            res = w25q_erase_sector(dev, address);
+            address += FLASH_LINK_SECTOR_SIZE;
+            len -= FLASH_LINK_SECTOR_SIZE;
+        }
+    }
+    return res;
+}
+
+/**
+ * \brief           Program data, pages left fully erased are skipped
+ * \param[in]       dev: Flash device
+ * \param[in]       address: Start address
+ * \param[in]       data: Data to program
+ * \param[in]       len: Number of bytes
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_write(w25q_t* dev, uint32_t address, const uint8_t* data, uint32_t len) {
+    w25q_result_t res = W25Q_OK;
+    uint32_t chunk, i;
+
+    while (len > 0 && res == W25Q_OK) {
+        chunk = FLASH_LINK_PAGE_SIZE - (address % FLASH_LINK_PAGE_SIZE);
+        if (chunk > len) {
+            chunk = len;
+        }
+        for (i = 0; i < chunk && data[i] == 0xFF; ++i) {}
+        if (i < chunk) {
+            res = w25q_write_page(dev, address, data, chunk);
+        }
+        address += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+    return res;
+}
+
+/**
+ * \brief           Compute CRC-32 of consecutive sectors into `link_tx`
+ * \param[in]       dev: Flash device
+ * \param[in]       address: Sector-aligned start address
+ * \param[in]       count: Number of sectors
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_sector_crc(w25q_t* dev, uint32_t address, uint32_t count) {
+    w25q_result_t res;
+    uint32_t crc, s, off;
+
+    if ((address % FLASH_LINK_SECTOR_SIZE) != 0 || count == 0 || count > FLASH_LINK_MAX_CRC_SECTORS) {
+        return W25Q_ERR_PARAM;
+    }
+    for (s = 0; s < count; ++s) {
+        crc = W25Q_CRC32_INIT;
+        for (off = 0; off < FLASH_LINK_SECTOR_SIZE; off += FLASH_LINK_PAGE_SIZE) {
+            res = w25q_read(dev, address + off, link_page, FLASH_LINK_PAGE_SIZE);
+            if (res != W25Q_OK) {
+                return res;
+            }
+            crc = w25q_crc32_update(crc, link_page, FLASH_LINK_PAGE_SIZE);
+        }
+        prv_put_u32(&link_tx[4 + s * 4], W25Q_CRC32_FINAL(crc));
+        address += FLASH_LINK_SECTOR_SIZE;
+    }
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Execute valid frame in `link_frame`, reply if it ends a burst
+ * \param[in]       link: Session state
+ */
+static void
+prv_handle(flash_link_t* link) {
+    uint8_t type = link_frame[1] & (uint8_t)~FLASH_LINK_POLL, seq = link_frame[2];
+    uint8_t poll = (link_frame[1] & FLASH_LINK_POLL) != 0;
+    uint32_t len = (uint32_t)link_frame[3] | ((uint32_t)link_frame[4] << 8);
+    const uint8_t* p = &link_frame[FLASH_LINK_HDR_SIZE];
+    w25q_info_t info;
+    w25q_result_t res = W25Q_ERR_PARAM;
+    uint32_t data_len = 0, arg;
+    uint8_t dup;
+
+    if (seq != link->expect) {
+        /* Frames up to one window back were already executed, their reply got lost */
+        dup = (uint8_t)(link->expect - seq) <= FLASH_LINK_WINDOW;
+        if (!dup) {
+            /* Gap, or rest of the burst after a failed frame */
+            if (poll && link->err != W25Q_OK) {
+                prv_reply(link, link->err_type, link->expect, link->err, 0);
+                link->err = W25Q_OK;
+            } else if (poll) {
+                prv_send(link, FLASH_LINK_NAK, link->expect, NULL, 0);
+            }
+            return;
+        }
+        if (type == FLASH_LINK_ERASE || type == FLASH_LINK_WRITE || type == FLASH_LINK_END) {
+            if (poll) {
+                prv_reply(link, type, seq, W25Q_OK, 0);
+            }
+            return;
+        }
+    } else {
+        link->expect++;
+        link->err = W25Q_OK;
+    }
+
+    arg = (len >= 8) ? prv_get_u32(&p[4]) : 0;
+    switch (type) {
+        case FLASH_LINK_HELLO:
+            w25q_get_info(link->dev, &info);
+            link_tx[4] = FLASH_LINK_WINDOW;
+            link_tx[5] = FLASH_LINK_VERSION;
+            link_tx[6] = info.device_id;
+            link_tx[7] = 0;
+            prv_put_u32(&link_tx[8], FLASH_LINK_MAX_DATA);
+            prv_put_u32(&link_tx[12], info.capacity_bytes);
+            res = W25Q_OK;
+            data_len = 12;
+            break;
+        case FLASH_LINK_SECTOR_CRC:
+            if (len == 8) {
+                res = prv_sector_crc(link->dev, prv_get_u32(p), arg);
+                data_len = arg * 4;
+            }
+            break;
+        case FLASH_LINK_ERASE:
+            if (len == 8) {
+                res = prv_erase(link->dev, prv_get_u32(p), arg);
+            }
+            break;
+        case FLASH_LINK_WRITE:
+            if (len > 4) {
+                res = prv_write(link->dev, prv_get_u32(p), p + 4, len - 4);
+            }
+            break;
+        case FLASH_LINK_READ:
+            if (len == 8 && arg <= FLASH_LINK_MAX_DATA) {
+                res = w25q_read(link->dev, prv_get_u32(p), &link_tx[4], arg);
+                data_len = arg;
+            }
+            break;
+        case FLASH_LINK_END:
+            res = W25Q_OK;
+            link->done = 1;
+            break;
+        default:
+            break;
+    }
+    if (poll) {
+        prv_reply(link, type, seq, res, data_len);
+    } else if (res != W25Q_OK) {
+        /* Failed frame counts as not executed, following frames are dropped until poll */
+        link->expect = seq;
+        link->err_type = type;
+        link->err = res;
+    }
+}
+
+/**
+ * \brief           Parse received bytes and execute complete frames
+ * \param[in]       link: Session state
+ * \return          `1` if a valid frame was processed, `0` otherwise
+ */
+static uint8_t
+prv_poll(flash_link_t* link) {
+    uint32_t head, avail, len, need, i, crc;
+
+    head = prv_rx_head(link);
+    avail = (head + FLASH_LINK_RX_SIZE - link->rd) % FLASH_LINK_RX_SIZE;
+
+    /* Skip to start of frame */
+    while (avail > 0 && link_rx[link->rd] != FLASH_LINK_SOF) {
+        link->rd = (link->rd + 1) % FLASH_LINK_RX_SIZE;
+        avail--;
+    }
+    if (avail < FLASH_LINK_HDR_SIZE) {
+        return 0;
+    }
+
+    len = (uint32_t)link_rx[(link->rd + 3) % FLASH_LINK_RX_SIZE]
+          | ((uint32_t)link_rx[(link->rd + 4) % FLASH_LINK_RX_SIZE] << 8);
+    need = FLASH_LINK_HDR_SIZE + len + FLASH_LINK_CRC_SIZE;
+    if (len > FLASH_LINK_MAX_PAYLOAD) {
+        /* Not a frame start, resynchronize on next byte */
+        link->rd = (link->rd + 1) % FLASH_LINK_RX_SIZE;
+        return 0;
+    }
+    if (avail < need) {
+        return 0;
+    }
+
+    for (i = 0; i < need; ++i) {
+        link_frame[i] = link_rx[(link->rd + i) % FLASH_LINK_RX_SIZE];
+    }
+    crc = W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, &link_frame[1], FLASH_LINK_HDR_SIZE - 1 + len));
+    if (crc != prv_get_u32(&link_frame[FLASH_LINK_HDR_SIZE + len])) {
+        /* Host may still be sending, no reply; the gap is reported on next poll frame */
+        link->rd = (link->rd + 1) % FLASH_LINK_RX_SIZE;
+        return 0;
+    }
+
+    link->rd = (link->rd + need) % FLASH_LINK_RX_SIZE;
+    prv_handle(link);
+    return 1;
+}
+
+/**
+ * \brief           Run programming session on UART
+ *
+ * Takes over the UART: log output is flushed and disabled, the baudrate is
+ * switched to \ref FLASH_LINK_BAUD and the RS485 driver is enabled only
+ * while replying. Everything is restored on return.
+ *
+ * \param[in]       dev: Initialized W25Q device handle
+ * \param[in]       huart: UART handle with receive DMA linked
+ * \param[in]       idle_timeout_ms: Session ends when no valid frame arrives for this long
+ * \return          \ref W25Q_OK when host ended session, \ref W25Q_ERR_TIMEOUT on idle timeout,
+ *                      member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+flash_link_run(w25q_t* dev, UART_HandleTypeDef* huart, uint32_t idle_timeout_ms) {
+    flash_link_t link;
+    uint32_t baud, last;
+    w25q_result_t res = W25Q_ERR_TIMEOUT;
+
+    if (dev == NULL || huart == NULL || huart->hdmarx == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+
+    log_uart_flush(1000);
+    log_uart_enable(0);
+    baud = huart->Init.BaudRate;
+    if (FLASH_LINK_BAUD != 0) {
+        huart->Init.BaudRate = FLASH_LINK_BAUD;
+        if (HAL_UART_Init(huart) != HAL_OK) {
+            res = W25Q_ERR;
+            goto restore;
+        }
+    }
+
+    memset(&link, 0, sizeof(link));
+    link.dev = dev;
+    link.huart = huart;
+    HAL_GPIO_WritePin(RS485_TXEN_GPIO_Port, RS485_TXEN_Pin, GPIO_PIN_RESET);
+    prv_rx_start(&link);
+
+    last = HAL_GetTick();
+    while (!link.done) {
+        /* Reception stops on UART errors such as overrun, lost data is recovered by resend */
+        if (huart->RxState != HAL_UART_STATE_BUSY_RX) {
+            prv_rx_start(&link);
+        }
+        if (prv_poll(&link)) {
+            last = HAL_GetTick();
+        } else if (HAL_GetTick() - last >= idle_timeout_ms) {
+            break;
+        }
+    }
+    if (link.done) {
+        res = W25Q_OK;
+    }
+    HAL_UART_AbortReceive(huart);
+
+restore:
+    HAL_GPIO_WritePin(RS485_TXEN_GPIO_Port, RS485_TXEN_Pin, GPIO_PIN_SET);
+    if (huart->Init.BaudRate != baud) {
+        huart->Init.BaudRate = baud;
+        HAL_UART_Init(huart);
+    }
+    log_uart_enable(1);
+    return res;
+}
@@ -0,0 +1,187 @@
+/**
+ * \file            log_uart.c
+ * \brief           Interrupt driven ring buffered UART log output implementation
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#include "log_uart.h"
+#include <string.h>
+
+static UART_HandleTypeDef* log_huart;
+static uint8_t log_buf[LOG_UART_BUF_SIZE];
+static volatile uint32_t log_head;              /* Free running write index, written by producer */
+static volatile uint32_t log_tail;              /* Free running read index, written by interrupt */
+static volatile uint32_t log_tx_len;            /* Bytes of current interrupt transfer */
+static uint8_t log_enabled;
+static log_uart_stats_t log_stats;
+
+/**
+ * \brief           Start transfer of pending data if UART is idle
+ * \note            Call with interrupts disabled or from UART interrupt
+ */
+static void
+prv_start(void) {
+    uint32_t tail, len;
+
+    if (log_tx_len != 0 || log_head == log_tail) {
+        return;
+    }
+
+    /* Send contiguous part, the rest follows from completion callback */
+    tail = log_tail % LOG_UART_BUF_SIZE;
+    len = log_head - log_tail;
+    if (len > LOG_UART_BUF_SIZE - tail) {
+        len = LOG_UART_BUF_SIZE - tail;
+    }
+    if (HAL_UART_Transmit_IT(log_huart, &log_buf[tail], (uint16_t)len) == HAL_OK) {
+        log_tx_len = len;
+    }
+}
+
+/**
+ * \brief           Initialize log output
+ * \note            UART interrupt must be enabled in NVIC
+ * \param[in]       huart: Initialized UART handle
+ */
+void
+log_uart_init(UART_HandleTypeDef* huart) {
+    log_huart = huart;
+    log_head = 0;
+    log_tail = 0;
+    log_tx_len = 0;
+    log_enabled = 1;
+    memset(&log_stats, 0, sizeof(log_stats));
+}
+
+/**
+ * \brief           Enable or disable log output
+ *
+ * While disabled, writes are dropped and counted. Used when another module
+ * takes over the UART.
+ *
+ * \param[in]       enable: `1` to enable, `0` to disable
+ */
+void
+log_uart_enable(uint8_t enable) {
+    log_enabled = enable ? 1 : 0;
+}
+
+/**
+ * \brief           Queue data for transmission without blocking
+ *
+ * Writes that do not fit in the ring, or arrive while output is disabled,
+ * are dropped as a whole so lines are not cut. Single producer: do not
+ * call from interrupts while main code logs.
+ *
+ * \param[in]       data: Data to send
+ * \param[in]       len: Number of bytes
+ * \return          `len` if queued, `0` if dropped
+ */
+uint32_t
+log_uart_write(const void* data, uint32_t len) {
+    uint32_t head, used, first, primask;
+
+    if (log_huart == NULL || len == 0) {
+        return 0;
+    }
+
+    head = log_head;
+    used = head - log_tail;
+    if (!log_enabled || len > LOG_UART_BUF_SIZE - used) {
+        log_stats.dropped += len;
+        log_stats.dropped_writes++;
+        return 0;
+    }
+
+    first = LOG_UART_BUF_SIZE - (head % LOG_UART_BUF_SIZE);
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&log_buf[head % LOG_UART_BUF_SIZE], data, first);
+    memcpy(log_buf, (const uint8_t*)data + first, len - first);
+    log_head = head + len;
+
+    log_stats.written += len;
+    if (used + len > log_stats.high_water) {
+        log_stats.high_water = used + len;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    prv_start();
+    __set_PRIMASK(primask);
+    return len;
+}
+
+/**
+ * \brief           Wait until all queued data is sent
+ * \param[in]       timeout_ms: Maximum time to wait
+ * \return          `1` if ring is empty, `0` on timeout
+ */
+uint8_t
+log_uart_flush(uint32_t timeout_ms) {
+    uint32_t start = HAL_GetTick(), primask;
+
+    while (log_head != log_tail || log_tx_len != 0) {
+        if (HAL_GetTick() - start >= timeout_ms) {
+            return 0;
+        }
+
+        /* Restart output if UART was busy when data was queued */
+        primask = __get_PRIMASK();
+        __disable_irq();
+        prv_start();
+        __set_PRIMASK(primask);
+    }
+    return 1;
+}
+
+/**
+ * \brief           Get log output statistics
+ * \param[out]      stats: Pointer to store statistics
+ */
+void
+log_uart_get_stats(log_uart_stats_t* stats) {
+    *stats = log_stats;
+}
+
+/**
+ * \brief           UART transmit complete callback
+ * \param[in]       huart: UART handle
+ */
+void
+HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart) {
+    if (huart != log_huart) {
+        return;
+    }
+    log_tail += log_tx_len;
+    log_tx_len = 0;
+    prv_start();
+}
@@ -18,6 +18,7 @@
 /* USER CODE END Header */
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
+#include "dma.h"
 #include "spi.h"
 #include "usart.h"
 #include "gpio.h"
@@ -25,6 +26,11 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "w25q.h"
+#include "w25q_crc.h"
+#include "flash_bench.h"
+#include "w25q_trace.h"
+#include "log_uart.h"
+#include "flash_link.h"
 #include <stdio.h>
 #include <string.h>
 #include <sys/unistd.h>
@@ -37,6 +43,14 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+/* Set to 1 to run throughput benchmark after demo test */
+#define FLASH_BENCH_ENABLE              0
+/* Set to 1 to trace SPI transactions and dump them over USART1 after demo test */
+#define W25Q_TRACE_ENABLE               0
+#define W25Q_TRACE_RECORDS              256
+/* Set to 1 to accept a bulk programming session from host after demo test */
+#define FLASH_LINK_ENABLE               0
+#define FLASH_LINK_IDLE_MS              10000
 
 /* USER CODE END PD */
 
@@ -49,6 +63,10 @@
 
 /* USER CODE BEGIN PV */
 static w25q_t w25q_device;
+#if W25Q_TRACE_ENABLE
+static w25q_trace_t w25q_trace;
+static w25q_trace_rec_t w25q_trace_recs[W25Q_TRACE_RECORDS];
+#endif /* W25Q_TRACE_ENABLE */
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -61,21 +79,25 @@ static void w25q_demo_test(void);
 /* USER CODE BEGIN 0 */
 /**
  * \brief           Printf qua UART1 - Sử dụng _write() cho GCC
+ *
+ * Output is queued to the interrupt driven log ring, output that does not
+ * fit is dropped instead of stalling the caller.
  */
 #if defined(__GNUC__)
 int _write(int fd, char *ptr, int len) {
-    HAL_UART_Transmit(&huart1, (uint8_t *)ptr, len, HAL_MAX_DELAY);
+    log_uart_write(ptr, len);
     return len;
 }
 #elif defined(__ICCARM__)
 #include "LowLevelIOInterface.h"
 size_t __write(int handle, const unsigned char *buffer, size_t size) {
-    HAL_UART_Transmit(&huart1, (uint8_t *)buffer, size, HAL_MAX_DELAY);
+    log_uart_write(buffer, size);
     return size;
 }
 #elif defined(__CC_ARM)
 int fputc(int ch, FILE *f) {
-    HAL_UART_Transmit(&huart1, (uint8_t *)&ch, 1, HAL_MAX_DELAY);
+    uint8_t c = (uint8_t)ch;
+    log_uart_write(&c, 1);
     return ch;
 }
 #endif
@@ -140,6 +162,37 @@ prv_spi_receive(uint8_t* data, uint32_t len) {
     return (status == HAL_OK) ? 1 : 0;
 }
 
+/**
+ * \brief           Start receiving data via SPI DMA
+ *
+ * Master receive clocks out the buffer content as dummy bytes on TX DMA.
+ *
+ * \param[out]      data: Buffer to store received data
+ * \param[in]       len: Number of bytes to receive
+ * \return          `1` on success, `0` otherwise
+ */
+static uint8_t
+prv_spi_receive_start(uint8_t* data, uint32_t len) {
+    return HAL_SPI_Receive_DMA(&hspi1, data, (uint16_t)len) == HAL_OK;
+}
+
+/**
+ * \brief           Wait for SPI DMA receive to complete
+ * \return          `1` on success, `0` on error or timeout
+ */
+static uint8_t
+prv_spi_receive_wait(void) {
+    uint32_t start = HAL_GetTick();
+
+    while (HAL_SPI_GetState(&hspi1) != HAL_SPI_STATE_READY) {
+        if (HAL_GetTick() - start > 100) {
+            HAL_SPI_Abort(&hspi1);
+            return 0;
+        }
+    }
+    return hspi1.ErrorCode == HAL_SPI_ERROR_NONE;
+}
+
 /**
  * \brief           Transmit and receive data via SPI (full-duplex)
  * \param[in]       tx_data: Data buffer to transmit
@@ -164,6 +217,69 @@ prv_delay_ms(uint32_t ms) {
     HAL_Delay(ms);
 }
 
+/**
+ * \brief           Get free-running microsecond time
+ *
+ * HAL tick is driven by TIM7 counting at 1 MHz with 1 ms period.
+ *
+ * \return          Time in microseconds
+ */
+static uint32_t
+prv_time_us(void) {
+    uint32_t ms, us;
+
+    do {
+        ms = HAL_GetTick();
+        us = TIM7->CNT;
+    } while (ms != HAL_GetTick());
+    return ms * 1000UL + us;
+}
+
+/**
+ * \brief           Update reflected CRC-32 with the CRC peripheral
+ *
+ * The F1 CRC unit shifts words MSB first without input or output reflection,
+ * so each word is bit-reversed on the way in and the state on the way out.
+ * The unit keeps the bit-reversed running value, a call continues in hardware
+ * when it still holds `crc`. Tail bytes and foreign states use software.
+ *
+ * \param[in]       crc: Running CRC value
+ * \param[in]       data: Data to process
+ * \param[in]       len: Number of bytes to process
+ * \return          Updated running CRC value
+ */
+static uint32_t
+prv_crc32_update(uint32_t crc, const uint8_t* data, uint32_t len) {
+    uint32_t word;
+
+    if (crc == W25Q_CRC32_INIT) {
+        CRC->CR = CRC_CR_RESET;
+    } else if (CRC->DR != __RBIT(crc)) {
+        return w25q_crc32_update(crc, data, len);
+    }
+    for (; len >= 4; len -= 4, data += 4) {
+        memcpy(&word, data, sizeof(word));
+        CRC->DR = __RBIT(word);
+    }
+    return w25q_crc32_update(__RBIT(CRC->DR), data, len);
+}
+
+#if W25Q_TRACE_ENABLE
+/**
+ * \brief           Write binary trace data to UART
+ * \param[in]       data: Data to write
+ * \param[in]       len: Number of bytes
+ * \param[in]       arg: UART handle
+ * \return          `1` on success, `0` otherwise
+ */
+static uint8_t
+prv_trace_write(const void* data, uint32_t len, void* arg) {
+    /* Binary data must not be dropped, send it after pending log output */
+    log_uart_flush(1000);
+    return HAL_UART_Transmit((UART_HandleTypeDef*)arg, (uint8_t*)data, (uint16_t)len, HAL_MAX_DELAY) == HAL_OK;
+}
+#endif /* W25Q_TRACE_ENABLE */
+
 /* Low-level function structure for W25Q library */
 static const w25q_ll_t w25q_ll_stm32 = {
     .init = prv_spi_init,
@@ -173,6 +289,10 @@ static const w25q_ll_t w25q_ll_stm32 = {
     .receive = prv_spi_receive,
     .transmit_receive = prv_spi_transmit_receive,
     .delay_ms = prv_delay_ms,
+    .get_time_us = prv_time_us,
+    .receive_start = prv_spi_receive_start,
+    .receive_wait = prv_spi_receive_wait,
+    .crc32_update = prv_crc32_update,
 };
 
 /**
@@ -258,6 +378,11 @@ w25q_demo_test(void) {
 
     printf("SUCCESS: W25Q initialized!\r\n\r\n");
 
+#if W25Q_TRACE_ENABLE
+    w25q_trace_init(&w25q_trace, w25q_trace_recs, W25Q_TRACE_RECORDS);
+    w25q_trace_attach(&w25q_trace, &w25q_device);
+#endif /* W25Q_TRACE_ENABLE */
+
     /* Lấy thông tin chip */
     w25q_get_info(&w25q_device, &info);
     print_chip_info(&info);
@@ -447,11 +572,30 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_SPI1_Init();
   MX_USART1_UART_Init();
   /* USER CODE BEGIN 2 */
+  __HAL_RCC_CRC_CLK_ENABLE();
+  log_uart_init(&huart1);
   HAL_Delay(100);
   w25q_demo_test();
+#if FLASH_BENCH_ENABLE
+  if (w25q_wake_up(&w25q_device) == W25Q_OK) {
+      flash_bench_run(&w25q_device, &hspi1, FLASH_BENCH_ADDR);
+      w25q_power_down(&w25q_device);
+  }
+#endif /* FLASH_BENCH_ENABLE */
+#if W25Q_TRACE_ENABLE
+  w25q_trace_export(&w25q_trace, prv_trace_write, &huart1);
+#endif /* W25Q_TRACE_ENABLE */
+#if FLASH_LINK_ENABLE
+  if (w25q_wake_up(&w25q_device) == W25Q_OK) {
+      printf("Flash link: %s\r\n",
+             flash_link_run(&w25q_device, &huart1, FLASH_LINK_IDLE_MS) == W25Q_OK ? "done" : "timeout");
+      w25q_power_down(&w25q_device);
+  }
+#endif /* FLASH_LINK_ENABLE */
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -0,0 +1,534 @@
+/**
+ * \file            ota.c
+ * \brief           Firmware update staged in W25Q flash implementation
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#include "ota.h"
+#include "w25q_crc.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Image header layout, stored little-endian at slot start */
+#define OTA_MAGIC                       0x3141544FUL    /* "OTA1" */
+#define OTA_HDR_SIZE                    28
+#define OTA_OFF_MAGIC                   0
+#define OTA_OFF_SIZE                    4
+#define OTA_OFF_CRC                     8
+#define OTA_OFF_FORMAT                  12
+#define OTA_OFF_WINDOW_BITS             13
+#define OTA_OFF_OUT_SIZE                16
+#define OTA_OFF_OUT_CRC                 20
+#define OTA_OFF_HDR_CRC                 24
+
+#define OTA_W25Q_PAGE_SIZE              256UL
+#define OTA_W25Q_SECTOR_SIZE            4096UL
+#define OTA_W25Q_BLOCK_SIZE             65536UL
+
+/**
+ * \brief           Decoded data sink state for packed images
+ */
+typedef struct {
+    uint32_t crc;                               /*!< Running CRC of decoded data */
+    uint32_t fill;                              /*!< Bytes in `ota_buf` */
+    uint32_t base;                              /*!< Image offset of `ota_buf` */
+    uint8_t program;                            /*!< Set to `0` for CRC-only dry run */
+    ota_install_stats_t* stats;                 /*!< Install statistics */
+} prv_sink_t;
+
+/* One internal flash page, half-word aligned for programming */
+static uint16_t ota_buf[FLASH_PAGE_SIZE / 2];
+
+/* Decoder state, kept off the stack because of the LZ window */
+static w25q_unpack_t ota_unpack;
+
+/**
+ * \brief           Store 32-bit value as little-endian
+ * \param[out]      buf: Output buffer
+ * \param[in]       val: Value to store
+ */
+static void
+prv_put_u32(uint8_t* buf, uint32_t val) {
+    buf[0] = (uint8_t)val;
+    buf[1] = (uint8_t)(val >> 8);
+    buf[2] = (uint8_t)(val >> 16);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
+/**
+ * \brief           Load little-endian 32-bit value
+ * \param[in]       buf: Input buffer
+ * \return          Decoded value
+ */
+static uint32_t
+prv_get_u32(const uint8_t* buf) {
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8)
+           | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/**
+ * \brief           Program one W25Q page of the slot and fold its read-back into CRC
+ *
+ * Slot is erased lazily just ahead of the write position, using 64KB block
+ * erase where the remaining image covers a whole aligned block.
+ *
+ * \param[in]       ota: OTA context
+ * \param[in]       offset: Slot offset of the page
+ * \param[in]       len: Number of bytes in page buffer
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_flush_page(ota_t* ota, uint32_t offset, uint32_t len) {
+    uint8_t check[OTA_W25Q_PAGE_SIZE];
+    uint32_t end;
+    w25q_result_t res;
+
+    end = OTA_DATA_OFFSET + ota->size;
+    while (ota->erased_end < offset + len) {
+        if ((((ota->slot_addr + ota->erased_end) % OTA_W25Q_BLOCK_SIZE) == 0)
+            && end - ota->erased_end >= OTA_W25Q_BLOCK_SIZE) {
+            res = w25q_erase_block_64k(ota->dev, ota->slot_addr + ota->erased_end);
+            ota->erased_end += OTA_W25Q_BLOCK_SIZE;
+        } else {
+            res = w25q_erase_sector(ota->dev, ota->slot_addr + ota->erased_end);
+            ota->erased_end += OTA_W25Q_SECTOR_SIZE;
+        }
+        if (res != W25Q_OK) {
+            return res;
+        }
+    }
+
+    if ((res = w25q_write_page(ota->dev, ota->slot_addr + offset, ota->page, len)) != W25Q_OK
+        || (res = w25q_read(ota->dev, ota->slot_addr + offset, check, len)) != W25Q_OK) {
+        return res;
+    }
+
+    /* CRC covers what actually landed in flash, not what was received */
+    ota->crc = w25q_crc32_update(ota->crc, check, len);
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Start receiving an image into W25Q slot
+ * \param[in]       ota: OTA context
+ * \param[in]       dev: Initialized W25Q device handle
+ * \param[in]       slot_addr: Slot start address (sector-aligned)
+ * \param[in]       size: Image size in bytes
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+ota_begin(ota_t* ota, w25q_t* dev, uint32_t slot_addr, uint32_t size) {
+    if (ota == NULL || dev == NULL || size == 0
+        || (slot_addr % OTA_W25Q_SECTOR_SIZE) != 0
+        || size > OTA_APP_END - OTA_APP_ADDR
+        || slot_addr + OTA_DATA_OFFSET + size > dev->info.capacity_bytes) {
+        return W25Q_ERR_PARAM;
+    }
+
+    ota->dev = dev;
+    ota->slot_addr = slot_addr;
+    ota->size = size;
+    ota->written = 0;
+    ota->erased_end = 0;
+    ota->crc = W25Q_CRC32_INIT;
+    ota->fill = 0;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Append received image data
+ * \param[in]       ota: OTA context
+ * \param[in]       data: Received data
+ * \param[in]       len: Number of bytes
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+ota_write(ota_t* ota, const uint8_t* data, uint32_t len) {
+    uint32_t chunk;
+    w25q_result_t res;
+
+    if (ota == NULL || ota->dev == NULL || data == NULL || ota->written + len > ota->size) {
+        return W25Q_ERR_PARAM;
+    }
+
+    while (len > 0) {
+        chunk = sizeof(ota->page) - ota->fill;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(&ota->page[ota->fill], data, chunk);
+        ota->fill += chunk;
+        ota->written += chunk;
+        data += chunk;
+        len -= chunk;
+
+        if (ota->fill == sizeof(ota->page)) {
+            if ((res = prv_flush_page(ota, OTA_DATA_OFFSET + ota->written - ota->fill, ota->fill)) != W25Q_OK) {
+                return res;
+            }
+            ota->fill = 0;
+        }
+    }
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Finish image reception, verify it and commit slot header
+ * \param[in]       ota: OTA context
+ * \param[in]       image: Image description. `size` and `crc` are checked against
+ *                      received data. For \ref W25Q_UNPACK_RAW images `out_size`
+ *                      and `out_crc` are taken from `size` and `crc`
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR on size or CRC mismatch,
+ *                      member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+ota_finish(ota_t* ota, const ota_image_t* image) {
+    uint8_t hdr[OTA_HDR_SIZE];
+    uint8_t raw;
+    w25q_result_t res;
+
+    if (ota == NULL || ota->dev == NULL || image == NULL
+        || (image->format & ~(W25Q_UNPACK_LZ | W25Q_UNPACK_DELTA))) {
+        return W25Q_ERR_PARAM;
+    }
+    raw = image->format == W25Q_UNPACK_RAW;
+    if (!raw && (image->out_size == 0 || image->out_size > OTA_APP_END - OTA_APP_ADDR)) {
+        return W25Q_ERR_PARAM;
+    }
+    if (ota->fill > 0) {
+        if ((res = prv_flush_page(ota, OTA_DATA_OFFSET + ota->written - ota->fill, ota->fill)) != W25Q_OK) {
+            return res;
+        }
+        ota->fill = 0;
+    }
+    if (ota->written != ota->size || image->size != ota->size
+        || W25Q_CRC32_FINAL(ota->crc) != image->crc) {
+        return W25Q_ERR;
+    }
+
+    memset(hdr, 0xFF, sizeof(hdr));
+    prv_put_u32(&hdr[OTA_OFF_MAGIC], OTA_MAGIC);
+    prv_put_u32(&hdr[OTA_OFF_SIZE], image->size);
+    prv_put_u32(&hdr[OTA_OFF_CRC], image->crc);
+    hdr[OTA_OFF_FORMAT] = image->format;
+    hdr[OTA_OFF_WINDOW_BITS] = image->window_bits;
+    prv_put_u32(&hdr[OTA_OFF_OUT_SIZE], raw ? image->size : image->out_size);
+    prv_put_u32(&hdr[OTA_OFF_OUT_CRC], raw ? image->crc : image->out_crc);
+    prv_put_u32(&hdr[OTA_OFF_HDR_CRC],
+                W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, hdr, OTA_OFF_HDR_CRC)));
+    return w25q_write_page(ota->dev, ota->slot_addr, hdr, sizeof(hdr));
+}
+
+/**
+ * \brief           Read and validate image header of a slot
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       slot_addr: Slot start address
+ * \param[out]      image: Pointer to store image information
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR if slot holds no valid image,
+ *                      member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+ota_get_image(w25q_t* dev, uint32_t slot_addr, ota_image_t* image) {
+    uint8_t hdr[OTA_HDR_SIZE];
+    w25q_result_t res;
+
+    if (dev == NULL || image == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+    if ((res = w25q_read(dev, slot_addr, hdr, sizeof(hdr))) != W25Q_OK) {
+        return res;
+    }
+    if (prv_get_u32(&hdr[OTA_OFF_MAGIC]) != OTA_MAGIC
+        || prv_get_u32(&hdr[OTA_OFF_HDR_CRC])
+               != W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, hdr, OTA_OFF_HDR_CRC))) {
+        return W25Q_ERR;
+    }
+    image->size = prv_get_u32(&hdr[OTA_OFF_SIZE]);
+    image->crc = prv_get_u32(&hdr[OTA_OFF_CRC]);
+    image->format = hdr[OTA_OFF_FORMAT];
+    image->window_bits = hdr[OTA_OFF_WINDOW_BITS];
+    image->out_size = prv_get_u32(&hdr[OTA_OFF_OUT_SIZE]);
+    image->out_crc = prv_get_u32(&hdr[OTA_OFF_OUT_CRC]);
+    if (image->out_size == 0 || image->out_size > OTA_APP_END - OTA_APP_ADDR) {
+        return W25Q_ERR;
+    }
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Check image data in a slot against the CRC in its header
+ *
+ * Data is checksummed with \ref w25q_crc32, which uses the CRC peripheral
+ * while the next chunk is received. Nothing is written.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       slot_addr: Slot start address
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR on invalid header or
+ *                      CRC mismatch, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+ota_verify(w25q_t* dev, uint32_t slot_addr) {
+    ota_image_t image;
+    uint32_t crc;
+    w25q_result_t res;
+
+    if ((res = ota_get_image(dev, slot_addr, &image)) != W25Q_OK
+        || (res = w25q_crc32(dev, slot_addr + OTA_DATA_OFFSET, image.size, &crc)) != W25Q_OK) {
+        return res;
+    }
+    return crc == image.crc ? W25Q_OK : W25Q_ERR;
+}
+
+/**
+ * \brief           Program one internal flash page from `ota_buf`
+ *
+ * Page is erased only when a half-word has to change from a programmed value,
+ * half-words that are already correct or should stay erased are not written.
+ *
+ * \param[in]       addr: Internal flash page address
+ * \param[in]       len: Number of valid bytes in `ota_buf`, rounded up to half-words
+ * \param[in]       stats: Statistics to update
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_program_page(uint32_t addr, uint32_t len, ota_install_stats_t* stats) {
+    FLASH_EraseInitTypeDef erase;
+    const volatile uint16_t* dst = (const volatile uint16_t*)addr;
+    uint32_t i, count, page_err;
+
+    count = (len + 1) / 2;
+    for (i = 0; i < count; ++i) {
+        if (dst[i] != ota_buf[i] && dst[i] != 0xFFFF) {
+            break;
+        }
+    }
+    if (i < count) {
+        erase.TypeErase = FLASH_TYPEERASE_PAGES;
+        erase.Banks = FLASH_BANK_1;
+        erase.PageAddress = addr;
+        erase.NbPages = 1;
+        if (HAL_FLASHEx_Erase(&erase, &page_err) != HAL_OK) {
+            return W25Q_ERR;
+        }
+        stats->pages_erased++;
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (ota_buf[i] != 0xFFFF && dst[i] != ota_buf[i]) {
+            if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr + 2 * i, ota_buf[i]) != HAL_OK) {
+                return W25Q_ERR;
+            }
+            stats->halfwords_programmed++;
+        }
+    }
+    return memcmp((const void*)addr, ota_buf, 2 * count) == 0 ? W25Q_OK : W25Q_ERR;
+}
+
+/**
+ * \brief           Bring one internal flash page in line with `ota_buf`
+ * \param[in]       off: Image offset of the page
+ * \param[in]       len: Number of valid bytes in `ota_buf`
+ * \param[in]       stats: Statistics to update
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_install_page(uint32_t off, uint32_t len, ota_install_stats_t* stats) {
+    if (len & 0x01) {
+        ((uint8_t*)ota_buf)[len] = 0xFF;
+    }
+    if (memcmp((const void*)(OTA_APP_ADDR + off), ota_buf, len) == 0) {
+        stats->pages_skipped++;
+        return W25Q_OK;
+    }
+    return prv_program_page(OTA_APP_ADDR + off, len, stats);
+}
+
+/**
+ * \brief           Decoder sink, collects decoded data into internal flash pages
+ * \param[in]       arg: Sink state, \ref prv_sink_t
+ * \param[in]       offset: Output offset of first byte
+ * \param[in]       data: Decoded data
+ * \param[in]       len: Number of bytes
+ * \return          `1` on success, `0` otherwise
+ */
+static uint8_t
+prv_sink(void* arg, uint32_t offset, const uint8_t* data, uint32_t len) {
+    prv_sink_t* sink = arg;
+    uint32_t chunk;
+
+    (void)offset;
+    sink->crc = w25q_crc32_update(sink->crc, data, len);
+    if (!sink->program) {
+        return 1;
+    }
+    while (len > 0) {
+        chunk = FLASH_PAGE_SIZE - sink->fill;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy((uint8_t*)ota_buf + sink->fill, data, chunk);
+        sink->fill += chunk;
+        data += chunk;
+        len -= chunk;
+        if (sink->fill == FLASH_PAGE_SIZE) {
+            if (prv_install_page(sink->base, sink->fill, sink->stats) != W25Q_OK) {
+                return 0;
+            }
+            sink->base += sink->fill;
+            sink->fill = 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * \brief           Decode packed image from slot
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       slot_addr: Slot start address
+ * \param[in]       image: Image header
+ * \param[in]       program: Set to `1` to program internal flash, `0` for CRC-only dry run
+ * \param[in]       stats: Install statistics
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_install_packed(w25q_t* dev, uint32_t slot_addr, const ota_image_t* image, uint8_t program,
+                   ota_install_stats_t* stats) {
+    w25q_unpack_cfg_t cfg;
+    prv_sink_t sink;
+    w25q_result_t res;
+
+    memset(&sink, 0x00, sizeof(sink));
+    sink.crc = W25Q_CRC32_INIT;
+    sink.program = program;
+    sink.stats = stats;
+
+    cfg.format = image->format;
+    cfg.window_bits = image->window_bits;
+    cfg.out_size = image->out_size;
+    cfg.old = (const uint8_t*)OTA_APP_ADDR;
+    cfg.old_size = OTA_APP_END - OTA_APP_ADDR;
+    cfg.inplace_page = FLASH_PAGE_SIZE;
+    cfg.sink = prv_sink;
+    cfg.arg = &sink;
+
+    res = w25q_unpack(&ota_unpack, dev, slot_addr + OTA_DATA_OFFSET, image->size, &cfg);
+    stats->bytes_read += image->size;
+    if (res == W25Q_OK && sink.fill > 0) {
+        res = prv_install_page(sink.base, sink.fill, stats);
+    }
+    if (res == W25Q_OK && W25Q_CRC32_FINAL(sink.crc) != image->out_crc) {
+        res = W25Q_ERR;
+    }
+    return res;
+}
+
+/**
+ * \brief           Install image from W25Q slot into internal flash
+ *
+ * Raw images are copied in a single pass: each W25Q chunk is read once and
+ * feeds the image CRC, the comparison against internal flash and the
+ * programming. Set \ref OTA_VERIFY_BEFORE_INSTALL to check the slot with
+ * \ref ota_verify first, which reads the image twice. Compressed images are
+ * decoded on the fly with a small RAM window. Internal pages that already
+ * match are skipped without erase.
+ *
+ * Delta images patch the installed firmware in place, so they are decoded
+ * once without programming to verify the result before anything is erased.
+ *
+ * The installer must run from a bootloader linked below \ref OTA_APP_ADDR.
+ * Called from code inside the application region it would erase itself, so
+ * it refuses to run.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       slot_addr: Slot start address
+ * \param[out]      stats: Optional install statistics, can be `NULL`
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR on invalid image or
+ *                      programming error, \ref W25Q_ERR_PARAM if the installer
+ *                      lies in the application region, member of
+ *                      \ref w25q_result_t otherwise
+ */
+w25q_result_t
+ota_install(w25q_t* dev, uint32_t slot_addr, ota_install_stats_t* stats) {
+    ota_install_stats_t local;
+    ota_image_t image;
+    uint32_t off, len, crc, self;
+    w25q_result_t res;
+
+    if (stats == NULL) {
+        stats = &local;
+    }
+    memset(stats, 0x00, sizeof(*stats));
+
+    /* Single image build has the installer inside the region it overwrites */
+    self = (uint32_t)(uintptr_t)ota_install;
+    if (self >= OTA_APP_ADDR && self < OTA_APP_END) {
+        return W25Q_ERR_PARAM;
+    }
+    if ((res = ota_get_image(dev, slot_addr, &image)) != W25Q_OK) {
+        return res;
+    }
+
+#if OTA_VERIFY_BEFORE_INSTALL
+    if (image.format == W25Q_UNPACK_RAW && (res = ota_verify(dev, slot_addr)) != W25Q_OK) {
+        return res;
+    }
+#endif /* OTA_VERIFY_BEFORE_INSTALL */
+    if (image.format & W25Q_UNPACK_DELTA) {
+        if ((res = prv_install_packed(dev, slot_addr, &image, 0, stats)) != W25Q_OK) {
+            return res;
+        }
+    }
+
+    HAL_FLASH_Unlock();
+    if (image.format != W25Q_UNPACK_RAW) {
+        res = prv_install_packed(dev, slot_addr, &image, 1, stats);
+    } else {
+        crc = W25Q_CRC32_INIT;
+        for (off = 0; off < image.size; off += len) {
+            len = image.size - off;
+            if (len > FLASH_PAGE_SIZE) {
+                len = FLASH_PAGE_SIZE;
+            }
+            if ((res = w25q_read(dev, slot_addr + OTA_DATA_OFFSET + off, (uint8_t*)ota_buf, len)) != W25Q_OK) {
+                break;
+            }
+            stats->bytes_read += len;
+            crc = w25q_crc32_update(crc, ota_buf, len);
+            if ((res = prv_install_page(off, len, stats)) != W25Q_OK) {
+                break;
+            }
+        }
+        if (res == W25Q_OK && W25Q_CRC32_FINAL(crc) != image.crc) {
+            res = W25Q_ERR;
+        }
+    }
+    HAL_FLASH_Lock();
+    return res;
+}
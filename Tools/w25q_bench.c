@@ -0,0 +1,307 @@
+/**
+ * \file            w25q_bench.c
+ * \brief           Host benchmark of library API on emulated chip
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+
+/*
+ * Runs standard workloads through the library against w25q_emu and prints
+ * bus traffic and modeled time per API, so throughput regressions show up
+ * as numbers between releases.
+ *
+ * Build:
+ *  gcc -std=c11 -O2 -I../W25Q -I. w25q_bench.c w25q_emu.c ../W25Q/w25q.c ../W25Q/w25q_crc.c -o w25q_bench
+ *
+ * Usage:
+ *  w25q_bench [-c id] [-s hz] [-f json|csv]
+ *      -c id       JEDEC capacity byte of emulated chip (default 0x18, W25Q128)
+ *      -s hz       SPI clock (default 18000000)
+ *      -f format   Output format (default json)
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "w25q.h"
+#include "w25q_emu.h"
+
+#define BENCH_REGION                    0x100000UL  /* Workloads run inside first 1MB */
+#define BENCH_RECORD_SIZE               16
+#define BENCH_STREAM_SIZE               65536UL     /* Transfer size of sequential read */
+
+/* Benchmark result */
+typedef struct {
+    const char* name;                           /* Workload name */
+    const char* api;                            /* API under test */
+    uint32_t ops;                               /* API calls */
+    uint64_t payload;                           /* Useful bytes read, written or erased */
+    w25q_emu_stats_t stats;                     /* Emulator statistics */
+} bench_result_t;
+
+static w25q_t flash;
+static uint8_t buf[4096];
+static uint8_t stream_buf[BENCH_STREAM_SIZE];
+static uint32_t rng = 0x12345678UL;
+static bench_result_t results[16];
+static uint32_t result_count;
+static uint32_t failures;
+
+/**
+ * \brief           Pseudo random number
+ * \return          Next value
+ */
+static uint32_t
+prv_rand(void) {
+    rng = rng * 1664525UL + 1013904223UL;
+    return rng >> 8;
+}
+
+/**
+ * \brief           Check API result
+ * \param[in]       res: Result to check
+ */
+static void
+prv_check(w25q_result_t res) {
+    if (res != W25Q_OK) {
+        failures++;
+    }
+}
+
+/**
+ * \brief           Start measured section
+ */
+static void
+prv_begin(void) {
+    w25q_emu_reset_stats();
+}
+
+/**
+ * \brief           Finish measured section and store result
+ */
+static void
+prv_end(const char* name, const char* api, uint32_t ops, uint64_t payload) {
+    bench_result_t* r = &results[result_count++];
+
+    r->name = name;
+    r->api = api;
+    r->ops = ops;
+    r->payload = payload;
+    w25q_emu_get_stats(&r->stats);
+}
+
+/**
+ * \brief           Erase benchmark region, not measured
+ */
+static void
+prv_prepare(void) {
+    for (uint32_t a = 0; a < BENCH_REGION; a += 65536) {
+        prv_check(w25q_erase_block_64k(&flash, a));
+    }
+}
+
+/**
+ * \brief           Stream benchmark region with large reads
+ */
+static void
+prv_seq_read(void) {
+    uint32_t ops = 0;
+
+    prv_begin();
+    for (uint32_t a = 0; a < BENCH_REGION; a += BENCH_STREAM_SIZE) {
+        prv_check(w25q_read(&flash, a, stream_buf, BENCH_STREAM_SIZE));
+        ops++;
+    }
+    prv_end("seq_read_64k", "w25q_read", ops, BENCH_REGION);
+}
+
+/**
+ * \brief           Read 4KB sectors in random order
+ */
+static void
+prv_rand_read(void) {
+    const uint32_t ops = 256;
+
+    prv_begin();
+    for (uint32_t i = 0; i < ops; ++i) {
+        uint32_t a = (prv_rand() % (BENCH_REGION / 4096)) * 4096;
+
+        prv_check(w25q_read(&flash, a, buf, 4096));
+    }
+    prv_end("rand_read_4k", "w25q_read", ops, (uint64_t)ops * 4096);
+}
+
+/**
+ * \brief           Program full pages sequentially
+ */
+static void
+prv_seq_write(void) {
+    const uint32_t size = 256UL * 1024;
+    uint32_t ops = 0;
+
+    prv_prepare();
+    for (uint32_t i = 0; i < 256; ++i) {
+        buf[i] = (uint8_t)prv_rand();
+    }
+    prv_begin();
+    for (uint32_t a = 0; a < size; a += 256) {
+        prv_check(w25q_write_page(&flash, a, buf, 256));
+        ops++;
+    }
+    prv_end("seq_page_write", "w25q_write_page", ops, size);
+}
+
+/**
+ * \brief           Program small records back to back, one call per record
+ */
+static void
+prv_record_write(void) {
+    const uint32_t size = 64UL * 1024;
+    uint32_t ops = 0;
+
+    prv_prepare();
+    prv_begin();
+    for (uint32_t a = 0; a < size; a += BENCH_RECORD_SIZE) {
+        prv_check(w25q_write_page(&flash, a, buf, BENCH_RECORD_SIZE));
+        ops++;
+    }
+    prv_end("small_record_write", "w25q_write_page", ops, size);
+}
+
+/**
+ * \brief           Erase region with 4KB, 32KB and 64KB erases
+ */
+static void
+prv_erase_sweep(void) {
+    uint32_t ops;
+
+    ops = 0;
+    prv_begin();
+    for (uint32_t a = 0; a < 256UL * 1024; a += 4096) {
+        prv_check(w25q_erase_sector(&flash, a));
+        ops++;
+    }
+    prv_end("erase_sweep_4k", "w25q_erase_sector", ops, 256UL * 1024);
+
+    ops = 0;
+    prv_begin();
+    for (uint32_t a = 0; a < BENCH_REGION; a += 32768) {
+        prv_check(w25q_erase_block_32k(&flash, a));
+        ops++;
+    }
+    prv_end("erase_sweep_32k", "w25q_erase_block_32k", ops, BENCH_REGION);
+
+    ops = 0;
+    prv_begin();
+    for (uint32_t a = 0; a < BENCH_REGION; a += 65536) {
+        prv_check(w25q_erase_block_64k(&flash, a));
+        ops++;
+    }
+    prv_end("erase_sweep_64k", "w25q_erase_block_64k", ops, BENCH_REGION);
+}
+
+/**
+ * \brief           Print results
+ * \param[in]       csv: Set to `1` for CSV, `0` for JSON
+ */
+static void
+prv_print(uint8_t csv, uint8_t capacity_id, uint32_t spi_hz) {
+    if (csv) {
+        printf("workload,api,ops,payload_bytes,bus_bytes,cs_toggles,status_polls,time_us,mb_per_s,us_per_op,violations\n");
+    } else {
+        printf("{\n  \"chip\": \"0x%02X\",\n  \"spi_hz\": %lu,\n  \"results\": [\n", capacity_id, (unsigned long)spi_hz);
+    }
+    for (uint32_t i = 0; i < result_count; ++i) {
+        const bench_result_t* r = &results[i];
+        double us = (double)r->stats.time_ns / 1000.0;
+        double mbps = us > 0 ? (double)r->payload / us : 0;
+
+        if (csv) {
+            printf("%s,%s,%lu,%llu,%llu,%llu,%llu,%.1f,%.3f,%.2f,%llu\n", r->name, r->api, (unsigned long)r->ops,
+                   (unsigned long long)r->payload,
+                   (unsigned long long)(r->stats.bytes_tx + r->stats.bytes_rx),
+                   (unsigned long long)r->stats.cs_toggles, (unsigned long long)r->stats.status_polls, us, mbps,
+                   us / r->ops, (unsigned long long)r->stats.violations);
+        } else {
+            printf("    {\"workload\": \"%s\", \"api\": \"%s\", \"ops\": %lu, \"payload_bytes\": %llu, "
+                   "\"bus_bytes\": %llu, \"cs_toggles\": %llu, \"status_polls\": %llu, \"time_us\": %.1f, "
+                   "\"mb_per_s\": %.3f, \"us_per_op\": %.2f, \"violations\": %llu}%s\n",
+                   r->name, r->api, (unsigned long)r->ops, (unsigned long long)r->payload,
+                   (unsigned long long)(r->stats.bytes_tx + r->stats.bytes_rx),
+                   (unsigned long long)r->stats.cs_toggles, (unsigned long long)r->stats.status_polls, us, mbps,
+                   us / r->ops, (unsigned long long)r->stats.violations, i + 1 < result_count ? "," : "");
+        }
+    }
+    if (!csv) {
+        printf("  ]\n}\n");
+    }
+}
+
+int
+main(int argc, char** argv) {
+    w25q_emu_cfg_t cfg;
+    uint8_t capacity_id = W25Q128, csv = 0;
+    uint32_t spi_hz = 18000000UL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            capacity_id = (uint8_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            spi_hz = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            csv = strcmp(argv[++i], "csv") == 0;
+        } else {
+            fprintf(stderr, "usage: %s [-c id] [-s hz] [-f json|csv]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    w25q_emu_default_cfg(&cfg, capacity_id);
+    cfg.spi_hz = spi_hz;
+    if (w25q_emu_init(&cfg) != 0 || w25q_init(&flash, &w25q_emu_ll) != W25Q_OK) {
+        fprintf(stderr, "cannot initialize emulated chip 0x%02X\n", capacity_id);
+        return 1;
+    }
+
+    prv_seq_write();
+    prv_seq_read();
+    prv_rand_read();
+    prv_record_write();
+    prv_erase_sweep();
+
+    prv_print(csv, capacity_id, spi_hz);
+    w25q_emu_deinit();
+
+    if (failures > 0) {
+        fprintf(stderr, "%lu API calls failed\n", (unsigned long)failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,948 @@
+/**
+ * \file            w25q_emu.c
+ * \brief           Host-side W25Q chip emulator with timing model
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+
+/*
+ * Emulates a W25Q chip behind the w25q_ll_t port so the library and the
+ * modules above it can be exercised and benchmarked on a host.
+ *
+ * The command stream is decoded byte by byte as a real chip would see it.
+ * NOR semantics are enforced: programming can only clear bits, page program
+ * wraps inside the 256-byte page, program/erase require WEL and set BUSY,
+ * and commands other than status reads are ignored while busy. Sector and
+ * block erases can be suspended (0x75) and resumed (0x7A); reading the range
+ * being erased or writing while suspended is a violation. Ignored and
+ * malformed commands are counted as violations.
+ *
+ * Time is virtual: SPI transfers advance the clock by the number of bytes
+ * at the configured clock rate plus a per-call and per-CS overhead, while
+ * delay_ms advances it by the requested amount. Erase and program busy
+ * times follow the configured tSE/tBE/tPP values.
+ *
+ * Build together with the library:
+ *  gcc -std=c11 -O2 -I../W25Q -I. app.c w25q_emu.c ../W25Q/w25q.c ../W25Q/w25q_crc.c
+ */
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "w25q_emu.h"
+
+#define EMU_PAGE_SIZE                   256
+#define EMU_SECTOR_SIZE                 4096
+#define EMU_3BYTE_LIMIT                 0x1000000UL
+
+#define EMU_SR1_BUSY                    0x01
+#define EMU_SR1_WEL                     0x02
+#define EMU_SR2_QE                      0x02
+#define EMU_SR2_SUS                     0x80
+#define EMU_T_SUS_US                    20
+#define EMU_SR3_ADS                     0x01
+
+/* Command classes */
+typedef enum {
+    EMU_OP_NONE = 0,                            /* Unknown or ignored command */
+    EMU_OP_SIMPLE,                              /* No data phase, acts on deselect */
+    EMU_OP_STATUS,                              /* Status register read */
+    EMU_OP_WRITE_STATUS,                        /* Status register write */
+    EMU_OP_READ,                                /* Array read */
+    EMU_OP_PROGRAM,                             /* Page program */
+    EMU_OP_ERASE,                               /* Sector or block erase */
+    EMU_OP_ID,                                  /* Identification read */
+    EMU_OP_PARAM,                               /* Set read parameters */
+    EMU_OP_WRAP,                                /* Set burst with wrap */
+} emu_op_t;
+
+/* Command descriptor */
+typedef struct {
+    emu_op_t op;                                /* Command class */
+    uint8_t addr;                               /* Command carries an address */
+    uint8_t dummy;                              /* Dummy bytes after address */
+} emu_cmd_t;
+
+static struct {
+    w25q_emu_cfg_t cfg;                         /* Active configuration */
+    uint64_t capacity;                          /* Array size in bytes */
+    uint8_t** sectors;                          /* Sparse array, `NULL` sector is erased */
+    uint8_t* map;                               /* mmap'd array when file backed */
+    int fd;                                     /* Image file descriptor */
+    uint64_t now;                               /* Virtual time in nanoseconds */
+    uint64_t stats_start;                       /* Time of last statistics reset */
+    uint64_t busy_until;                        /* Time BUSY clears */
+    uint8_t erasing;                            /* Busy with sector or block erase */
+    uint8_t suspended;                          /* Erase suspended */
+    uint64_t susp_left;                         /* Erase time left when suspended, in ns */
+    uint64_t erase_addr;                        /* Range of last sector or block erase */
+    uint64_t erase_size;
+    uint64_t rx_until;                          /* Time background receive completes */
+    uint8_t rx_pending;                         /* Background receive started, not waited for */
+    uint8_t sr[3];                              /* Status registers 1-3 */
+    uint8_t addr4;                              /* 4-byte address mode */
+    uint8_t powered_down;                       /* Deep power-down */
+    uint8_t reset_enabled;                      /* Previous command was 0x66 */
+    uint8_t qpi;                                /* QPI mode, all phases on 4 lines */
+    uint8_t read_param;                         /* Read parameters set with 0xC0 */
+    uint8_t cont;                               /* Continuous read mode, next transaction starts with address */
+    uint8_t mode_bits;                          /* M7-0 of current 0xEB read */
+    uint8_t wrap;                               /* W7-0 set with 0x77, W4 set disables wrap */
+    uint32_t wrap_len;                          /* Wrap line size of current read, `0` linear */
+    uint8_t uid[8];                             /* Unique ID */
+
+    uint8_t cs;                                 /* Chip selected */
+    uint8_t lines;                              /* Bus lines used for transfers */
+    uint8_t opcode;                             /* Current command */
+    emu_cmd_t cmd;                              /* Current command descriptor */
+    uint32_t pos;                               /* Bytes clocked since select */
+    uint64_t addr;                              /* Collected address */
+    uint8_t page[EMU_PAGE_SIZE];                /* Page program latch */
+    uint32_t page_bytes;                        /* Bytes latched */
+    uint8_t data[2];                            /* Status write data */
+
+    w25q_emu_stats_t stats;                     /* Statistics */
+} emu;
+
+/**
+ * \brief           Report protocol violation
+ * \param[in]       msg: Description
+ */
+static void
+prv_violation(const char* msg) {
+    emu.stats.violations++;
+    if (emu.cfg.strict) {
+        fprintf(stderr, "w25q_emu: %s (cmd 0x%02X, t=%llu ns)\r\n", msg, emu.opcode,
+                (unsigned long long)emu.now);
+    }
+}
+
+/**
+ * \brief           Check whether chip is busy at current time
+ * \return          `1` if busy, `0` otherwise
+ */
+static uint8_t
+prv_busy(void) {
+    return emu.now < emu.busy_until;
+}
+
+/**
+ * \brief           Start internal operation
+ * \param[in]       us: Operation time in microseconds
+ */
+static void
+prv_set_busy(uint64_t us) {
+    emu.busy_until = emu.now + us * 1000ULL;
+    emu.stats.busy_ns += us * 1000ULL;
+    emu.sr[0] &= ~EMU_SR1_WEL;
+    emu.erasing = 0;
+}
+
+/**
+ * \brief           Get number of address bytes for current mode
+ * \return          `3` or `4`
+ */
+static uint8_t
+prv_addr_len(void) {
+    return emu.addr4 ? 4 : 3;
+}
+
+/**
+ * \brief           Decode opcode
+ * \param[in]       opcode: Command byte
+ * \return          Command descriptor
+ */
+static emu_cmd_t
+prv_decode(uint8_t opcode) {
+    switch (opcode) {
+        case 0x06: case 0x04: case 0xC7: case 0x60: case 0xB9:
+        case 0xB7: case 0xE9: case 0x66: case 0x99: case 0x38: case 0xFF:
+        case 0x75: case 0x7A:
+            return (emu_cmd_t){EMU_OP_SIMPLE, 0, 0};
+        case 0x05: case 0x35: case 0x15:
+            return (emu_cmd_t){EMU_OP_STATUS, 0, 0};
+        case 0x01: case 0x31: case 0x11:
+            return (emu_cmd_t){EMU_OP_WRITE_STATUS, 0, 0};
+        case 0x03:
+            return (emu_cmd_t){EMU_OP_READ, 1, 0};
+        case 0x0B: case 0x3B: case 0x6B:
+            return (emu_cmd_t){EMU_OP_READ, 1, 1};
+        case 0xEB:
+            return (emu_cmd_t){EMU_OP_READ, 1, 3};  /* Mode byte and 4 dummy clocks on 4 lines */
+        case 0x02: case 0x32:
+            return (emu_cmd_t){EMU_OP_PROGRAM, 1, 0};
+        case 0x20: case 0x52: case 0xD8:
+            return (emu_cmd_t){EMU_OP_ERASE, 1, 0};
+        case 0x9F: case 0xAF:
+            return (emu_cmd_t){EMU_OP_ID, 0, 0};
+        case 0xC0:
+            return (emu_cmd_t){EMU_OP_PARAM, 0, 0};
+        case 0x0C:
+            return (emu_cmd_t){EMU_OP_READ, 1, 1};
+        case 0x77:
+            return (emu_cmd_t){EMU_OP_WRAP, 0, 3};  /* 6 dummy clocks and wrap bits on 4 lines */
+        case 0x90:
+            return (emu_cmd_t){EMU_OP_ID, 0, 3};
+        case 0xAB:
+            return (emu_cmd_t){EMU_OP_ID, 0, 3};
+        case 0x4B:
+            return (emu_cmd_t){EMU_OP_ID, 0, 4};
+        default:
+            return (emu_cmd_t){EMU_OP_NONE, 0, 0};
+    }
+}
+
+/**
+ * \brief           Get sector storage
+ * \param[in]       address: Array address
+ * \param[in]       alloc: Set to `1` to allocate erased sector
+ * \return          Pointer to sector start, `NULL` if erased and not allocated
+ */
+static uint8_t*
+prv_sector(uint64_t address, uint8_t alloc) {
+    uint64_t idx = address / EMU_SECTOR_SIZE;
+
+    if (emu.map != NULL) {
+        return &emu.map[idx * EMU_SECTOR_SIZE];
+    }
+    if (emu.sectors[idx] == NULL && alloc) {
+        emu.sectors[idx] = malloc(EMU_SECTOR_SIZE);
+        if (emu.sectors[idx] == NULL) {
+            fprintf(stderr, "w25q_emu: out of memory\r\n");
+            exit(1);
+        }
+        memset(emu.sectors[idx], 0xFF, EMU_SECTOR_SIZE);
+    }
+    return emu.sectors[idx];
+}
+
+/**
+ * \brief           Erase array range
+ * \param[in]       address: Aligned start address
+ * \param[in]       size: Multiple of sector size
+ */
+static void
+prv_erase(uint64_t address, uint64_t size) {
+    for (uint64_t a = address; a < address + size; a += EMU_SECTOR_SIZE) {
+        if (emu.map != NULL) {
+            memset(&emu.map[a], 0xFF, EMU_SECTOR_SIZE);
+        } else {
+            free(emu.sectors[a / EMU_SECTOR_SIZE]);
+            emu.sectors[a / EMU_SECTOR_SIZE] = NULL;
+        }
+    }
+}
+
+/**
+ * \brief           Read one array byte
+ * \param[in]       address: Array address
+ * \return          Byte value
+ */
+static uint8_t
+prv_array_read(uint64_t address) {
+    uint8_t* sector = prv_sector(address, 0);
+
+    return sector != NULL ? sector[address % EMU_SECTOR_SIZE] : 0xFF;
+}
+
+/**
+ * \brief           Get array size visible in current address mode
+ * \return          Size in bytes
+ */
+static uint64_t
+prv_visible(void) {
+    return (!emu.addr4 && emu.capacity > EMU_3BYTE_LIMIT) ? EMU_3BYTE_LIMIT : emu.capacity;
+}
+
+/**
+ * \brief           Process one byte clocked while chip is selected
+ * \param[in]       mosi: Byte from host
+ * \return          Byte to host
+ */
+static uint8_t
+prv_clock(uint8_t mosi) {
+    uint8_t miso = 0xFF;
+    uint32_t idx, alen;
+
+    if (emu.pos == 0 && emu.cont) {
+        /* Continuous read mode, first byte is already part of the address */
+        emu.opcode = 0xEB;
+        emu.cmd = prv_decode(0xEB);
+        emu.addr = 0;
+        emu.mode_bits = 0xFF;
+        emu.wrap_len = (emu.wrap & 0x10) ? 0 : 8U << ((emu.wrap >> 5) & 0x03);
+        emu.stats.commands++;
+        if (emu.lines != 4) {
+            prv_violation("continuous read address on wrong number of lines");
+        }
+        if (emu.qpi) {
+            emu.cmd.dummy = (uint8_t)(((emu.read_param >> 4) & 0x03) + 1);
+        }
+        emu.pos++;
+    } else if (emu.pos == 0) {
+        emu.opcode = mosi;
+        emu.mode_bits = 0xFF;
+        emu.wrap_len = 0;
+        emu.cmd = prv_decode(mosi);
+        emu.addr = 0;
+        emu.page_bytes = 0;
+        emu.stats.commands++;
+        if (!emu.qpi && emu.lines != 1 && (mosi == 0xFF || mosi == 0xAB)) {
+            /* QPI exit or wake-up sent blindly, chip in SPI mode sees no valid opcode */
+            emu.cmd.op = EMU_OP_NONE;
+        } else if (emu.powered_down && mosi != 0xAB) {
+            prv_violation("command in power-down");
+            emu.cmd.op = EMU_OP_NONE;
+        } else if (prv_busy() && emu.cmd.op != EMU_OP_STATUS && mosi != 0x75) {
+            prv_violation("command while busy");
+            emu.cmd.op = EMU_OP_NONE;
+        } else if (emu.suspended && (emu.cmd.op == EMU_OP_PROGRAM || emu.cmd.op == EMU_OP_ERASE
+                                     || emu.cmd.op == EMU_OP_WRITE_STATUS || mosi == 0xC7 || mosi == 0x60)) {
+            prv_violation("write while erase suspended");
+            emu.cmd.op = EMU_OP_NONE;
+        } else if (emu.cmd.op == EMU_OP_NONE) {
+            prv_violation("unsupported command");
+        } else if (emu.lines != (emu.qpi ? 4 : 1)) {
+            prv_violation("opcode on wrong number of lines");
+            emu.cmd.op = EMU_OP_NONE;
+        } else if (emu.qpi && (mosi == 0x9F || mosi == 0x32 || mosi == 0x3B || mosi == 0x6B || mosi == 0x38
+                               || mosi == 0x77)) {
+            prv_violation("command not available in QPI mode");
+            emu.cmd.op = EMU_OP_NONE;
+        } else if (!emu.qpi && (mosi == 0xAF || mosi == 0xC0 || mosi == 0x0C)) {
+            prv_violation("QPI command in SPI mode");
+            emu.cmd.op = EMU_OP_NONE;
+        } else if ((mosi == 0x6B || mosi == 0xEB || mosi == 0x32 || mosi == 0x38 || mosi == 0x77)
+                   && (emu.sr[1] & EMU_SR2_QE) == 0) {
+            prv_violation("quad command without QE");
+        } else if (emu.cmd.op == EMU_OP_PROGRAM) {
+            memset(emu.page, 0xFF, sizeof(emu.page));
+        } else if (emu.cmd.op == EMU_OP_STATUS) {
+            emu.stats.status_polls++;
+        }
+        if (emu.qpi && (mosi == 0x0B || mosi == 0xEB || mosi == 0x0C)) {
+            /* Dummy clocks from read parameters, 2 clocks per byte on 4 lines */
+            emu.cmd.dummy = (uint8_t)(((emu.read_param >> 4) & 0x03) + 1);
+        }
+        if (mosi == 0x0C) {
+            emu.wrap_len = 8U << (emu.read_param & 0x03);
+        } else if (mosi == 0xEB && !emu.qpi && (emu.wrap & 0x10) == 0) {
+            emu.wrap_len = 8U << ((emu.wrap >> 5) & 0x03);
+        }
+        emu.pos++;
+        return miso;
+    }
+
+    idx = emu.pos - 1;
+    emu.pos++;
+    if (emu.cmd.op == EMU_OP_NONE) {
+        return miso;
+    }
+
+    alen = emu.cmd.addr ? prv_addr_len() : 0;
+    if (idx < alen) {
+        emu.addr = (emu.addr << 8) | mosi;
+        if (idx == alen - 1) {
+            emu.addr %= prv_visible();
+        }
+        return miso;
+    }
+    idx -= alen;
+    if (idx < emu.cmd.dummy) {
+        if (idx == 0 && emu.opcode == 0xEB) {
+            emu.mode_bits = mosi;
+        }
+        return miso;
+    }
+    idx -= emu.cmd.dummy;
+
+    switch (emu.cmd.op) {
+        case EMU_OP_STATUS:
+            if (emu.opcode == 0x05) {
+                miso = (uint8_t)((emu.sr[0] & ~EMU_SR1_BUSY) | (prv_busy() ? EMU_SR1_BUSY : 0));
+            } else {
+                miso = emu.sr[emu.opcode == 0x35 ? 1 : 2];
+            }
+            break;
+        case EMU_OP_WRITE_STATUS:
+        case EMU_OP_PARAM:
+        case EMU_OP_WRAP:
+            if (idx < sizeof(emu.data)) {
+                emu.data[idx] = mosi;
+            }
+            break;
+        case EMU_OP_READ:
+            if (emu.suspended && emu.addr >= emu.erase_addr && emu.addr < emu.erase_addr + emu.erase_size) {
+                prv_violation("read of suspended erase range");
+            }
+            miso = prv_array_read(emu.addr);
+            if (emu.wrap_len != 0) {
+                emu.addr = (emu.addr & ~(uint64_t)(emu.wrap_len - 1)) | ((emu.addr + 1) & (emu.wrap_len - 1));
+            } else {
+                emu.addr = (emu.addr + 1) % prv_visible();
+            }
+            emu.stats.read_bytes++;
+            break;
+        case EMU_OP_PROGRAM:
+            /* Data past the page boundary wraps to page start */
+            emu.page[(emu.addr + idx) % EMU_PAGE_SIZE] &= mosi;
+            emu.page_bytes++;
+            break;
+        case EMU_OP_ID:
+            if (emu.opcode == 0x9F || emu.opcode == 0xAF) {
+                const uint8_t id[3] = {0xEF, 0x40, emu.cfg.capacity_id};
+                miso = idx < 3 ? id[idx] : 0x00;
+            } else if (emu.opcode == 0x90) {
+                miso = (idx & 1) ? (uint8_t)(emu.cfg.capacity_id - 1) : 0xEF;
+            } else if (emu.opcode == 0xAB) {
+                miso = (uint8_t)(emu.cfg.capacity_id - 1);
+            } else {
+                miso = emu.uid[idx % sizeof(emu.uid)];
+            }
+            break;
+        default:
+            break;
+    }
+    return miso;
+}
+
+/**
+ * \brief           Execute command on chip deselect
+ */
+static void
+prv_execute(void) {
+    uint32_t alen = emu.cmd.addr ? prv_addr_len() : 0;
+    uint8_t was_reset_enabled = emu.reset_enabled;
+
+    emu.reset_enabled = 0;
+    if (emu.pos == 0 || emu.cmd.op == EMU_OP_NONE) {
+        return;
+    }
+
+    /* M5-4 = 10 keeps chip in continuous read mode, anything else ends it */
+    if (emu.opcode == 0xEB) {
+        emu.cont = (emu.pos > 1 + alen && (emu.mode_bits & 0x30) == 0x20);
+    }
+
+    switch (emu.cmd.op) {
+        case EMU_OP_SIMPLE:
+            if (emu.pos != 1 && emu.opcode == 0xFF) {
+                /* Mode bit reset, clocks beyond opcode make it a no-op */
+                return;
+            } else if (emu.pos != 1) {
+                prv_violation("unexpected data");
+                return;
+            }
+            switch (emu.opcode) {
+                case 0x06: emu.sr[0] |= EMU_SR1_WEL; break;
+                case 0x04: emu.sr[0] &= ~EMU_SR1_WEL; break;
+                case 0xB9: emu.powered_down = 1; break;
+                case 0xB7: emu.addr4 = 1; emu.sr[2] |= EMU_SR3_ADS; break;
+                case 0xE9: emu.addr4 = 0; emu.sr[2] &= ~EMU_SR3_ADS; break;
+                case 0x66: emu.reset_enabled = 1; break;
+                case 0x99:
+                    if (was_reset_enabled) {
+                        emu.sr[0] &= ~EMU_SR1_WEL;
+                        emu.sr[1] &= ~EMU_SR2_SUS;
+                        emu.suspended = 0;
+                        emu.addr4 = 0;
+                        emu.sr[2] &= ~EMU_SR3_ADS;
+                        emu.qpi = 0;
+                        emu.read_param = 0;
+                        emu.wrap = 0x10;
+                    }
+                    break;
+                case 0x38: emu.qpi = 1; break;
+                case 0xFF: emu.qpi = 0; break;
+                case 0x75:
+                    /* Ignored when erase already finished or cannot be suspended */
+                    if (emu.erasing && prv_busy()) {
+                        emu.susp_left = emu.busy_until - emu.now;
+                        emu.stats.busy_ns -= emu.susp_left;
+                        prv_set_busy(EMU_T_SUS_US);
+                        emu.suspended = 1;
+                        emu.sr[1] |= EMU_SR2_SUS;
+                        emu.stats.suspends++;
+                    }
+                    break;
+                case 0x7A:
+                    if (!emu.suspended) {
+                        prv_violation("resume without suspend");
+                        return;
+                    }
+                    emu.busy_until = emu.now + emu.susp_left;
+                    emu.stats.busy_ns += emu.susp_left;
+                    emu.suspended = 0;
+                    emu.erasing = 1;
+                    emu.sr[1] &= ~EMU_SR2_SUS;
+                    break;
+                case 0xC7:
+                case 0x60:
+                    if ((emu.sr[0] & EMU_SR1_WEL) == 0) {
+                        prv_violation("chip erase without WEL");
+                        return;
+                    }
+                    prv_erase(0, emu.capacity);
+                    prv_set_busy((uint64_t)emu.cfg.t_ce_us_per_mb * ((emu.capacity + 0xFFFFF) >> 20));
+                    emu.stats.chip_erases++;
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case EMU_OP_PARAM:
+            if (emu.pos < 2) {
+                prv_violation("read parameters without data");
+                return;
+            }
+            emu.read_param = emu.data[0];
+            break;
+        case EMU_OP_WRAP:
+            if (emu.pos != 5) {
+                prv_violation("malformed set burst with wrap");
+                return;
+            }
+            emu.wrap = emu.data[0];
+            break;
+        case EMU_OP_WRITE_STATUS:
+            if ((emu.sr[0] & EMU_SR1_WEL) == 0) {
+                prv_violation("status write without WEL");
+                return;
+            }
+            if (emu.pos < 2) {
+                prv_violation("status write without data");
+                return;
+            }
+            if (emu.opcode == 0x01) {
+                emu.sr[0] = (uint8_t)(emu.data[0] & ~(EMU_SR1_BUSY | EMU_SR1_WEL));
+                if (emu.pos > 2) {
+                    emu.sr[1] = emu.data[1];
+                }
+            } else {
+                emu.sr[emu.opcode == 0x31 ? 1 : 2] = emu.data[0];
+            }
+            prv_set_busy(emu.cfg.t_w_us);
+            break;
+        case EMU_OP_PROGRAM: {
+            uint64_t base = emu.addr - (emu.addr % EMU_PAGE_SIZE);
+            uint32_t n = emu.page_bytes > EMU_PAGE_SIZE ? EMU_PAGE_SIZE : emu.page_bytes;
+            uint8_t* sector;
+
+            if (emu.pos <= 1 + alen) {
+                prv_violation("program without data");
+                return;
+            }
+            if ((emu.sr[0] & EMU_SR1_WEL) == 0) {
+                prv_violation("program without WEL");
+                return;
+            }
+            sector = prv_sector(base, 1);
+            for (uint32_t i = 0; i < EMU_PAGE_SIZE; ++i) {
+                sector[base % EMU_SECTOR_SIZE + i] &= emu.page[i];
+            }
+            /* Program time has a fixed part and a part proportional to byte count */
+            prv_set_busy(emu.cfg.t_pp_us / 8 + (uint64_t)(emu.cfg.t_pp_us - emu.cfg.t_pp_us / 8) * n / EMU_PAGE_SIZE);
+            emu.stats.page_programs++;
+            emu.stats.program_bytes += n;
+            break;
+        }
+        case EMU_OP_ERASE: {
+            uint64_t size;
+            uint32_t t;
+
+            if (emu.pos != 1 + alen) {
+                prv_violation("malformed erase");
+                return;
+            }
+            if ((emu.sr[0] & EMU_SR1_WEL) == 0) {
+                prv_violation("erase without WEL");
+                return;
+            }
+            if (emu.opcode == 0x20) {
+                size = 4096;
+                t = emu.cfg.t_se_us;
+                emu.stats.sector_erases++;
+            } else if (emu.opcode == 0x52) {
+                size = 32768;
+                t = emu.cfg.t_be32_us;
+                emu.stats.block32_erases++;
+            } else {
+                size = 65536;
+                t = emu.cfg.t_be64_us;
+                emu.stats.block64_erases++;
+            }
+            prv_erase(emu.addr - (emu.addr % size), size);
+            prv_set_busy(t);
+            emu.erasing = 1;
+            emu.erase_addr = emu.addr - (emu.addr % size);
+            emu.erase_size = size;
+            break;
+        }
+        case EMU_OP_ID:
+            if (emu.opcode == 0xAB) {
+                emu.powered_down = 0;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * \brief           Advance clock by bus transfer
+ * \param[in]       len: Number of bytes
+ */
+static void
+prv_transfer_time(uint32_t len) {
+    emu.stats.ll_calls++;
+    emu.now += emu.cfg.call_overhead_ns + (uint64_t)len * (8U / emu.lines) * 1000000000ULL / emu.cfg.spi_hz;
+}
+
+/**
+ * \brief           Check that no background receive is running
+ * \return          `1` if bus is idle, `0` otherwise
+ */
+static uint8_t
+prv_rx_idle(void) {
+    if (emu.rx_pending) {
+        prv_violation("bus access during background receive");
+        return 0;
+    }
+    return 1;
+}
+
+static uint8_t
+prv_ll_init(void) {
+    return 1;
+}
+
+static uint8_t
+prv_ll_select(void) {
+    if (emu.cs) {
+        prv_violation("select while selected");
+    }
+    emu.cs = 1;
+    emu.pos = 0;
+    emu.stats.cs_toggles++;
+    emu.now += emu.cfg.cs_overhead_ns;
+    return 1;
+}
+
+static uint8_t
+prv_ll_deselect(void) {
+    prv_rx_idle();
+    /* Driving CS high while idle is harmless, ports do it on init */
+    if (!emu.cs) {
+        return 1;
+    }
+    emu.cs = 0;
+    prv_execute();
+    return 1;
+}
+
+static uint8_t
+prv_ll_transmit(const uint8_t* data, uint32_t len) {
+    if (!prv_rx_idle()) {
+        return 0;
+    }
+    if (!emu.cs) {
+        prv_violation("transfer without select");
+        return 0;
+    }
+    for (uint32_t i = 0; i < len; ++i) {
+        prv_clock(data[i]);
+    }
+    emu.stats.bytes_tx += len;
+    prv_transfer_time(len);
+    return 1;
+}
+
+static uint8_t
+prv_ll_receive(uint8_t* data, uint32_t len) {
+    if (!prv_rx_idle()) {
+        return 0;
+    }
+    if (!emu.cs) {
+        prv_violation("transfer without select");
+        return 0;
+    }
+    for (uint32_t i = 0; i < len; ++i) {
+        data[i] = prv_clock(0xFF);
+    }
+    emu.stats.bytes_rx += len;
+    prv_transfer_time(len);
+    return 1;
+}
+
+static uint8_t
+prv_ll_transmit_receive(const uint8_t* tx_data, uint8_t* rx_data, uint32_t len) {
+    if (!emu.cs) {
+        prv_violation("transfer without select");
+        return 0;
+    }
+    for (uint32_t i = 0; i < len; ++i) {
+        rx_data[i] = prv_clock(tx_data[i]);
+    }
+    emu.stats.bytes_tx += len;
+    emu.stats.bytes_rx += len;
+    prv_transfer_time(len);
+    return 1;
+}
+
+static uint8_t
+prv_ll_set_lines(uint8_t lines) {
+    if (lines != 1 && lines != 2 && lines != 4) {
+        prv_violation("invalid line count");
+        return 0;
+    }
+    emu.lines = lines;
+    return 1;
+}
+
+/* Bytes are clocked at once, completion time is taken by receive wait like a DMA transfer */
+static uint8_t
+prv_ll_receive_start(uint8_t* data, uint32_t len) {
+    uint64_t start;
+
+    if (!prv_ll_receive(data, len)) {
+        return 0;
+    }
+    start = emu.now;
+    emu.now -= (uint64_t)len * (8U / emu.lines) * 1000000000ULL / emu.cfg.spi_hz;
+    emu.rx_until = start;
+    emu.rx_pending = 1;
+    return 1;
+}
+
+static uint8_t
+prv_ll_receive_wait(void) {
+    if (!emu.rx_pending) {
+        prv_violation("receive wait without background receive");
+        return 0;
+    }
+    emu.rx_pending = 0;
+    if (emu.now < emu.rx_until) {
+        emu.now = emu.rx_until;
+    }
+    return 1;
+}
+
+static void
+prv_ll_delay_ms(uint32_t ms) {
+    emu.now += (uint64_t)ms * 1000000ULL;
+}
+
+static uint32_t
+prv_ll_time_us(void) {
+    return (uint32_t)(emu.now / 1000ULL);
+}
+
+const w25q_ll_t w25q_emu_ll = {
+    .init = prv_ll_init,
+    .select = prv_ll_select,
+    .deselect = prv_ll_deselect,
+    .transmit = prv_ll_transmit,
+    .receive = prv_ll_receive,
+    .transmit_receive = prv_ll_transmit_receive,
+    .delay_ms = prv_ll_delay_ms,
+    .get_time_us = prv_ll_time_us,
+    .set_lines = prv_ll_set_lines,
+    .receive_start = prv_ll_receive_start,
+    .receive_wait = prv_ll_receive_wait,
+};
+
+/**
+ * \brief           Fill configuration with datasheet typical values
+ * \param[out]      cfg: Configuration to fill
+ * \param[in]       capacity_id: JEDEC capacity byte, e.g. \ref W25Q16
+ */
+void
+w25q_emu_default_cfg(w25q_emu_cfg_t* cfg, uint8_t capacity_id) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->capacity_id = capacity_id;
+    cfg->spi_hz = 18000000UL;
+    cfg->cs_overhead_ns = 500;
+    cfg->call_overhead_ns = 1500;
+    cfg->t_pp_us = 700;
+    cfg->t_se_us = 45000;
+    cfg->t_be32_us = 120000;
+    cfg->t_be64_us = 150000;
+    cfg->t_ce_us_per_mb = 2500000;
+    cfg->t_w_us = 10000;
+}
+
+/**
+ * \brief           Create emulated chip
+ * \param[in]       cfg: Configuration, see \ref w25q_emu_default_cfg
+ * \return          `0` on success, `-1` otherwise
+ */
+int
+w25q_emu_init(const w25q_emu_cfg_t* cfg) {
+    uint64_t capacity;
+    struct stat st;
+
+    if (cfg == NULL || cfg->spi_hz == 0) {
+        return -1;
+    }
+    if (cfg->capacity_id >= 0x11 && cfg->capacity_id <= 0x19) {
+        capacity = 1ULL << cfg->capacity_id;
+    } else if (cfg->capacity_id == 0x20 || cfg->capacity_id == 0x21) {
+        capacity = 1ULL << (cfg->capacity_id - 0x20 + 26);
+    } else {
+        return -1;
+    }
+
+    w25q_emu_deinit();
+    memset(&emu, 0, sizeof(emu));
+    emu.cfg = *cfg;
+    emu.capacity = capacity;
+    emu.fd = -1;
+    emu.lines = 1;
+    emu.wrap = 0x10;
+    for (uint32_t i = 0; i < sizeof(emu.uid); ++i) {
+        emu.uid[i] = (uint8_t)(0xA0 + i);
+    }
+
+    if (cfg->image_path != NULL) {
+        emu.fd = open(cfg->image_path, O_RDWR | O_CREAT, 0644);
+        if (emu.fd < 0 || fstat(emu.fd, &st) != 0) {
+            goto fail;
+        }
+        if ((uint64_t)st.st_size < capacity) {
+            if (ftruncate(emu.fd, (off_t)capacity) != 0) {
+                goto fail;
+            }
+        }
+        emu.map = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, emu.fd, 0);
+        if (emu.map == MAP_FAILED) {
+            emu.map = NULL;
+            goto fail;
+        }
+        /* New image area reads as erased */
+        if ((uint64_t)st.st_size < capacity) {
+            memset(&emu.map[st.st_size], 0xFF, capacity - (uint64_t)st.st_size);
+        }
+    } else {
+        emu.sectors = calloc(capacity / EMU_SECTOR_SIZE, sizeof(*emu.sectors));
+        if (emu.sectors == NULL) {
+            goto fail;
+        }
+    }
+    return 0;
+
+fail:
+    w25q_emu_deinit();
+    return -1;
+}
+
+/**
+ * \brief           Release emulated chip, file backed image is flushed
+ */
+void
+w25q_emu_deinit(void) {
+    if (emu.map != NULL) {
+        munmap(emu.map, emu.capacity);
+        emu.map = NULL;
+    }
+    if (emu.fd >= 0) {
+        close(emu.fd);
+        emu.fd = -1;
+    }
+    if (emu.sectors != NULL) {
+        for (uint64_t i = 0; i < emu.capacity / EMU_SECTOR_SIZE; ++i) {
+            free(emu.sectors[i]);
+        }
+        free(emu.sectors);
+        emu.sectors = NULL;
+    }
+}
+
+/**
+ * \brief           Get virtual time
+ * \return          Time in nanoseconds since \ref w25q_emu_init
+ */
+uint64_t
+w25q_emu_now_ns(void) {
+    return emu.now;
+}
+
+/**
+ * \brief           Advance virtual time, models host processing between bus calls
+ * \param[in]       ns: Time in nanoseconds
+ */
+void
+w25q_emu_advance_ns(uint64_t ns) {
+    emu.now += ns;
+}
+
+/**
+ * \brief           Get statistics
+ * \param[out]      stats: Statistics copy
+ */
+void
+w25q_emu_get_stats(w25q_emu_stats_t* stats) {
+    *stats = emu.stats;
+    stats->time_ns = emu.now - emu.stats_start;
+}
+
+/**
+ * \brief           Reset statistics, virtual clock keeps running
+ */
+void
+w25q_emu_reset_stats(void) {
+    memset(&emu.stats, 0, sizeof(emu.stats));
+    emu.stats_start = emu.now;
+}
+
+/**
+ * \brief           Read array content without bus traffic
+ * \param[in]       address: Array address
+ * \param[out]      data: Buffer to fill
+ * \param[in]       len: Number of bytes
+ */
+void
+w25q_emu_peek(uint64_t address, uint8_t* data, uint32_t len) {
+    for (uint32_t i = 0; i < len; ++i) {
+        data[i] = prv_array_read((address + i) % emu.capacity);
+    }
+}
+
+/**
+ * \brief           Get emulated array size
+ * \return          Size in bytes
+ */
+uint64_t
+w25q_emu_capacity(void) {
+    return emu.capacity;
+}
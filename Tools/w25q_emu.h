@@ -0,0 +1,107 @@
+/**
+ * \file            w25q_emu.h
+ * \brief           Host-side W25Q chip emulator with timing model
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef W25Q_EMU_HDR_H
+#define W25Q_EMU_HDR_H
+
+#include <stdint.h>
+#include "w25q.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           Emulator configuration
+ *
+ * All times are typical values, program time scales with number of bytes.
+ */
+typedef struct {
+    uint8_t capacity_id;                        /*!< JEDEC capacity byte, `0x11` (W25Q10) to `0x21` (W25Q01) */
+    uint32_t spi_hz;                            /*!< SPI clock frequency */
+    uint32_t cs_overhead_ns;                    /*!< Host cost of one chip select/deselect pair */
+    uint32_t call_overhead_ns;                  /*!< Host cost of one transfer call */
+    uint32_t t_pp_us;                           /*!< Page program time for 256 bytes (tPP) */
+    uint32_t t_se_us;                           /*!< Sector erase time (tSE) */
+    uint32_t t_be32_us;                         /*!< 32KB block erase time (tBE1) */
+    uint32_t t_be64_us;                         /*!< 64KB block erase time (tBE2) */
+    uint32_t t_ce_us_per_mb;                    /*!< Chip erase time per MB (tCE) */
+    uint32_t t_w_us;                            /*!< Status register write time (tW) */
+    const char* image_path;                     /*!< File backing the array through mmap,
+                                                        `NULL` for sparse RAM storage */
+    uint8_t strict;                             /*!< Set to `1` to print protocol violations */
+} w25q_emu_cfg_t;
+
+/**
+ * \brief           Bus and timing statistics
+ */
+typedef struct {
+    uint64_t time_ns;                           /*!< Virtual time elapsed since statistics reset */
+    uint64_t busy_ns;                           /*!< Time the chip spent busy */
+    uint64_t bytes_tx;                          /*!< Bytes clocked host to chip */
+    uint64_t bytes_rx;                          /*!< Bytes clocked chip to host */
+    uint64_t ll_calls;                          /*!< Transfer calls */
+    uint64_t cs_toggles;                        /*!< Chip select assertions */
+    uint64_t commands;                          /*!< Commands decoded */
+    uint64_t status_polls;                      /*!< Status register reads */
+    uint64_t read_bytes;                        /*!< Array bytes read */
+    uint64_t page_programs;                     /*!< Page program operations */
+    uint64_t program_bytes;                     /*!< Bytes programmed */
+    uint64_t sector_erases;                     /*!< 4KB sector erases */
+    uint64_t block32_erases;                    /*!< 32KB block erases */
+    uint64_t block64_erases;                    /*!< 64KB block erases */
+    uint64_t chip_erases;                       /*!< Chip erases */
+    uint64_t suspends;                          /*!< Erase suspends */
+    uint64_t violations;                        /*!< Protocol violations (missing WEL, command while busy, ...) */
+} w25q_emu_stats_t;
+
+/**
+ * \brief           Low-level functions to pass to \ref w25q_init
+ */
+extern const w25q_ll_t w25q_emu_ll;
+
+void            w25q_emu_default_cfg(w25q_emu_cfg_t* cfg, uint8_t capacity_id);
+int             w25q_emu_init(const w25q_emu_cfg_t* cfg);
+void            w25q_emu_deinit(void);
+uint64_t        w25q_emu_now_ns(void);
+void            w25q_emu_advance_ns(uint64_t ns);
+void            w25q_emu_get_stats(w25q_emu_stats_t* stats);
+void            w25q_emu_reset_stats(void);
+void            w25q_emu_peek(uint64_t address, uint8_t* data, uint32_t len);
+uint64_t        w25q_emu_capacity(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* W25Q_EMU_HDR_H */
@@ -0,0 +1,144 @@
+/**
+ * \file            w25q_hpp_check.cpp
+ * \brief           Host compile and run check of C++ wrapper
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+
+/*
+ * Instantiates w25q.hpp for every chip, then writes and reads back through
+ * the wrapper on the emulator, once with the direct single-line read path
+ * and once with lock hooks set, where reads must go through w25q_read.
+ * Build with -std=c++20 as well to cover the std::span overloads.
+ *
+ * Build:
+ *  gcc -std=c11 -O2 -I../W25Q -I. -c w25q_emu.c ../W25Q/w25q.c ../W25Q/w25q_crc.c
+ *  g++ -std=c++17 -O2 -I../W25Q -I. w25q_hpp_check.cpp w25q_emu.o w25q.o w25q_crc.o -o w25q_hpp_check
+ *
+ * Usage:
+ *  w25q_hpp_check
+ */
+#include <cstdio>
+#include <cstring>
+#include "w25q.hpp"
+#include "w25q_emu.h"
+
+static_assert(W25Q<w25q::W25Q10>::addr_bytes == 3 && W25Q<w25q::W25Q20>::sector_count == 64);
+static_assert(W25Q<w25q::W25Q40>::page_count == 2048 && W25Q<w25q::W25Q80>::block_count == 16);
+static_assert(W25Q<w25q::W25Q16>::capacity == 2097152UL && W25Q<w25q::W25Q32>::block_count == 64);
+static_assert(W25Q<w25q::W25Q64>::sector_count == 2048 && W25Q<w25q::W25Q128>::addr_bytes == 3);
+static_assert(W25Q<w25q::W25Q256>::addr_bytes == 4 && W25Q<w25q::W25Q256>::capacity == 33554432UL);
+
+static uint8_t held;
+static uint32_t unlocked_selects, failures;
+
+static uint8_t
+prv_lock(void) {
+    held = 1;
+    return 1;
+}
+
+static void
+prv_unlock(void) {
+    held = 0;
+}
+
+/* Chip select that counts transfers outside the lock */
+static uint8_t
+prv_select(void) {
+    unlocked_selects += !held;
+    return w25q_emu_ll.select();
+}
+
+/**
+ * \brief           Check result, count failures
+ * \param[in]       ok: Condition that must hold
+ * \param[in]       what: Description printed on failure
+ */
+static void
+prv_check(bool ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "failed: %s\n", what);
+        failures++;
+    }
+}
+
+/**
+ * \brief           Erase, program and read back through the wrapper
+ * \param[in]       ll: Low-level functions
+ * \param[in]       name: Pass name
+ */
+static void
+prv_run(const w25q_ll_t& ll, const char* name) {
+    W25Q<w25q::W25Q128> flash;
+    std::array<uint8_t, 64> w, r{};
+    uint8_t b[16];
+
+    printf("%s\n", name);
+    for (std::size_t i = 0; i < w.size(); ++i) {
+        w[i] = static_cast<uint8_t>(i * 7);
+    }
+    prv_check(flash.init(ll) == W25Q_OK, "init");
+    prv_check(flash.erase_sector<0x10000>() == W25Q_OK, "erase_sector");
+    prv_check(flash.write_page<0x100C0>(w) == W25Q_OK, "write_page");
+    unlocked_selects = 0;
+    prv_check(flash.read<0x100C0>(r) == W25Q_OK && r == w, "read back");
+    prv_check(!W25Q_CFG_LOCK || ll.lock == nullptr || unlocked_selects == 0, "read holds lock");
+    prv_check(flash.read(0x100C4, b, sizeof(b)) == W25Q_OK && memcmp(b, &w[4], sizeof(b)) == 0, "read offset");
+    prv_check(flash.read(0xFFFFF0, r) == W25Q_ERR_PARAM, "read out of range");
+    prv_check(flash.write_page(0x100F0, w) == W25Q_ERR_PARAM, "write across page");
+#if __cplusplus >= 202002L
+    prv_check(flash.read(0x100C4, std::span<uint8_t>(b)) == W25Q_OK && b[0] == w[4], "span read");
+#endif
+}
+
+int
+main(void) {
+    w25q_emu_cfg_t cfg;
+    w25q_ll_t ll = w25q_emu_ll;
+    W25Q<w25q::W25Q64> other;
+
+    w25q_emu_default_cfg(&cfg, W25Q128);
+    if (w25q_emu_init(&cfg) != 0) {
+        fprintf(stderr, "cannot initialize emulated chip\n");
+        return 1;
+    }
+
+    prv_run(ll, "direct");
+    prv_check(other.init(ll) == W25Q_ERR, "other chip rejected");
+    ll.select = prv_select;
+    ll.lock = prv_lock;
+    ll.unlock = prv_unlock;
+    prv_run(ll, "locked");
+    w25q_emu_deinit();
+
+    printf("%lu failures\n", (unsigned long)failures);
+    return failures > 0;
+}
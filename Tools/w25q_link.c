@@ -0,0 +1,576 @@
+/**
+ * \file            w25q_link.c
+ * \brief           Host tool programming flash over the USART1/RS485 link
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+
+/*
+ * Host side of the framed protocol implemented in Core/Src/flash_link.c.
+ *
+ * Writing an image first asks the target for the CRC-32 of every sector the
+ * image covers and only erases and programs sectors that differ. Erase and
+ * write frames are sent in bursts of up to the window reported by the target,
+ * so the serial line keeps transferring while the target programs. The line
+ * is half-duplex: after the last frame of a burst, marked with LINK_POLL, the
+ * tool stops sending until the target replied. A NAK or missing reply makes
+ * the tool resend from the first unacknowledged frame. The last sector is padded with 0xFF, data following the image in
+ * that sector is erased.
+ *
+ * Build:
+ *  gcc -std=c11 -O2 -I../W25Q w25q_link.c ../W25Q/w25q_crc.c -o w25q_link
+ *
+ * Usage:
+ *  w25q_link [-d tty] [-b baud] [-n] -w address image.bin
+ *  w25q_link [-d tty] [-b baud] -r address length out.bin
+ *      -d tty      Serial device (default /dev/ttyUSB0)
+ *      -b baud     Baudrate, must match FLASH_LINK_BAUD (default 460800)
+ *      -n          Skip verification after writing
+ *      -w address  Write image at sector-aligned address
+ *      -r address  Read length bytes from address
+ */
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "w25q_crc.h"
+
+/* Must match Core/Inc/flash_link.h */
+#define LINK_HELLO                      0x01
+#define LINK_SECTOR_CRC                 0x02
+#define LINK_ERASE                      0x03
+#define LINK_WRITE                      0x04
+#define LINK_READ                       0x05
+#define LINK_END                        0x06
+#define LINK_NAK                        0x7F
+#define LINK_POLL                       0x40
+#define LINK_REPLY                      0x80
+#define LINK_VERSION                    2
+#define LINK_MAX_CRC_SECTORS            64
+
+#define LINK_SOF                        0xA5
+#define LINK_HDR_SIZE                   5
+#define LINK_MAX_FRAME                  (LINK_HDR_SIZE + 8 + 4096 + 4)
+#define SECTOR_SIZE                     4096UL
+#define BLOCK_SIZE                      65536UL
+
+#define TIMEOUT_MS                      500
+#define TIMEOUT_ERASE_MS                3000            /* Per erase frame, at most one 64K block */
+#define MAX_RETRIES                     8
+
+/* Queued request frame */
+typedef struct {
+    uint8_t type;
+    uint8_t payload[8 + 4096];
+    uint32_t len;
+    uint8_t* out;                               /* Reply data destination */
+    uint32_t out_len;
+} req_t;
+
+/* Received frame */
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    uint32_t len;
+    uint8_t payload[LINK_MAX_FRAME];
+} frame_t;
+
+static int fd = -1;
+static uint8_t rx_buf[2 * LINK_MAX_FRAME];
+static uint32_t rx_len;
+static uint32_t link_window = 1, link_max_data = 256, link_capacity;
+static uint32_t tx_bytes, resends;
+
+static void
+prv_put_u32(uint8_t* buf, uint32_t val) {
+    buf[0] = (uint8_t)val;
+    buf[1] = (uint8_t)(val >> 8);
+    buf[2] = (uint8_t)(val >> 16);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
+static uint32_t
+prv_get_u32(const uint8_t* buf) {
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static uint64_t
+prv_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static int
+prv_open(const char* path, uint32_t baud) {
+    struct termios tio;
+    speed_t speed;
+
+    switch (baud) {
+        case 115200: speed = B115200; break;
+        case 230400: speed = B230400; break;
+        case 460800: speed = B460800; break;
+        case 921600: speed = B921600; break;
+        default: fprintf(stderr, "unsupported baudrate %u\n", (unsigned)baud); return -1;
+    }
+    fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0 || tcgetattr(fd, &tio) != 0) {
+        fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 1;
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        fprintf(stderr, "cannot configure %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return 0;
+}
+
+static void
+prv_send(uint8_t type, uint8_t seq, const uint8_t* payload, uint32_t len) {
+    uint8_t frame[LINK_MAX_FRAME];
+    uint32_t crc, n = 0;
+    ssize_t w;
+
+    frame[0] = LINK_SOF;
+    frame[1] = type;
+    frame[2] = seq;
+    frame[3] = (uint8_t)len;
+    frame[4] = (uint8_t)(len >> 8);
+    memcpy(&frame[LINK_HDR_SIZE], payload, len);
+    crc = W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, &frame[1], LINK_HDR_SIZE - 1 + len));
+    prv_put_u32(&frame[LINK_HDR_SIZE + len], crc);
+    len += LINK_HDR_SIZE + 4;
+    while (n < len) {
+        w = write(fd, frame + n, len - n);
+        if (w <= 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            fprintf(stderr, "write failed: %s\n", strerror(errno));
+            exit(1);
+        }
+        n += (uint32_t)w;
+    }
+    tx_bytes += len;
+}
+
+/* Receive one frame, returns 1 on success, 0 on timeout */
+static int
+prv_recv(frame_t* f, uint32_t timeout_ms) {
+    uint64_t end = prv_now_ms() + timeout_ms;
+    uint32_t len, need, crc;
+    ssize_t r;
+
+    for (;;) {
+        /* Drop bytes up to start of frame */
+        while (rx_len > 0 && rx_buf[0] != LINK_SOF) {
+            memmove(rx_buf, rx_buf + 1, --rx_len);
+        }
+        if (rx_len >= LINK_HDR_SIZE) {
+            len = (uint32_t)rx_buf[3] | ((uint32_t)rx_buf[4] << 8);
+            need = LINK_HDR_SIZE + len + 4;
+            if (need > LINK_MAX_FRAME) {
+                memmove(rx_buf, rx_buf + 1, --rx_len);
+                continue;
+            }
+            if (rx_len >= need) {
+                crc = W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, &rx_buf[1], LINK_HDR_SIZE - 1 + len));
+                if (crc != prv_get_u32(&rx_buf[LINK_HDR_SIZE + len])) {
+                    memmove(rx_buf, rx_buf + 1, --rx_len);
+                    continue;
+                }
+                f->type = rx_buf[1];
+                f->seq = rx_buf[2];
+                f->len = len;
+                memcpy(f->payload, &rx_buf[LINK_HDR_SIZE], len);
+                rx_len -= need;
+                memmove(rx_buf, rx_buf + need, rx_len);
+                return 1;
+            }
+        }
+        if (prv_now_ms() >= end) {
+            return 0;
+        }
+        r = read(fd, rx_buf + rx_len, sizeof(rx_buf) - rx_len);
+        if (r > 0) {
+            rx_len += (uint32_t)r;
+        } else if (r < 0 && errno != EINTR && errno != EAGAIN) {
+            fprintf(stderr, "read failed: %s\n", strerror(errno));
+            exit(1);
+        }
+    }
+}
+
+/*
+ * Execute requests in go-back-N bursts. Only the last frame of a burst is
+ * answered, frames with reply data always end a burst. Replies carry the
+ * sequence number of the request, target executes strictly in order so a
+ * reply acknowledges all earlier requests as well.
+ */
+static int
+prv_run(req_t* reqs, uint32_t count, uint8_t seq0) {
+    uint32_t base = 0, next = 0, i, idx, retries = 0;
+    uint64_t deadline = 0;
+    uint8_t poll;
+    frame_t f;
+
+    while (base < count) {
+        /* Next burst only after the previous one is answered, the target replies on the same pair */
+        if (base == next) {
+            do {
+                poll = next + 1 == count || next + 1 == base + link_window || reqs[next].out != NULL;
+                prv_send(reqs[next].type | (poll ? LINK_POLL : 0), (uint8_t)(seq0 + next), reqs[next].payload,
+                         reqs[next].len);
+                ++next;
+            } while (!poll);
+            deadline = 0;
+        }
+        if (deadline == 0) {
+            deadline = prv_now_ms() + TIMEOUT_MS;
+            for (i = base; i < next; ++i) {
+                if (reqs[i].type == LINK_ERASE) {
+                    deadline += TIMEOUT_ERASE_MS;
+                }
+            }
+        }
+        if (!prv_recv(&f, (uint32_t)(deadline > prv_now_ms() ? deadline - prv_now_ms() : 0))) {
+            if (++retries > MAX_RETRIES) {
+                fprintf(stderr, "no response from target\n");
+                return -1;
+            }
+            resends += next - base;
+            next = base;
+            continue;
+        }
+        idx = base + (uint8_t)(f.seq - (uint8_t)(seq0 + base));
+        if (f.type == LINK_NAK) {
+            /* Target expects frame idx, everything before it is done */
+            if (idx >= base && idx <= next) {
+                base = idx;
+                resends += next - base;
+                next = base;
+            }
+            continue;
+        }
+        if ((f.type & LINK_REPLY) == 0 || idx < base || idx >= next
+            || (f.type & (uint8_t)~LINK_REPLY) != reqs[idx].type) {
+            continue;
+        }
+        if (f.len < 4 || f.payload[0] != 0) {
+            fprintf(stderr, "request %u (type 0x%02X) failed with status %u\n", (unsigned)idx,
+                    reqs[idx].type, f.len >= 4 ? f.payload[0] : 0xFFU);
+            return -1;
+        }
+        if (reqs[idx].out != NULL) {
+            memcpy(reqs[idx].out, &f.payload[4], f.len - 4 < reqs[idx].out_len ? f.len - 4 : reqs[idx].out_len);
+        }
+        base = idx + 1;
+        retries = 0;
+        deadline = 0;
+    }
+    return 0;
+}
+
+static req_t*
+prv_add(req_t** reqs, uint32_t* count, uint8_t type, uint32_t a, uint32_t b) {
+    req_t* r;
+
+    *reqs = realloc(*reqs, (*count + 1) * sizeof(**reqs));
+    if (*reqs == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    r = &(*reqs)[(*count)++];
+    memset(r, 0, sizeof(*r));
+    r->type = type;
+    prv_put_u32(&r->payload[0], a);
+    prv_put_u32(&r->payload[4], b);
+    r->len = (type == LINK_HELLO || type == LINK_END) ? 0 : 8;
+    return r;
+}
+
+/* Get CRC of every sector in range, `crc` receives `sectors` values */
+static int
+prv_sector_crcs(uint32_t address, uint32_t sectors, uint32_t* crc, uint8_t* seq) {
+    req_t* reqs = NULL;
+    uint32_t count = 0, n, i;
+    uint8_t* raw = malloc(sectors * 4 + 1);
+    int res;
+
+    for (i = 0; i < sectors; i += n) {
+        n = sectors - i < LINK_MAX_CRC_SECTORS ? sectors - i : LINK_MAX_CRC_SECTORS;
+        prv_add(&reqs, &count, LINK_SECTOR_CRC, address + i * SECTOR_SIZE, n);
+    }
+    for (i = 0, n = 0; i < count; ++i) {
+        reqs[i].out = raw + n * 4;
+        reqs[i].out_len = prv_get_u32(&reqs[i].payload[4]) * 4;
+        n += reqs[i].out_len / 4;
+    }
+    res = prv_run(reqs, count, *seq);
+    *seq += (uint8_t)count;
+    for (i = 0; res == 0 && i < sectors; ++i) {
+        crc[i] = prv_get_u32(&raw[i * 4]);
+    }
+    free(raw);
+    free(reqs);
+    return res;
+}
+
+static int
+prv_write_image(uint32_t address, const uint8_t* img, uint32_t size, int verify, uint8_t* seq) {
+    uint32_t sectors = (size + SECTOR_SIZE - 1) / SECTOR_SIZE, i, j, run, off, n, count = 0, dirty = 0;
+    uint32_t *remote, *local;
+    uint8_t* padded;
+    req_t* reqs = NULL;
+    req_t* r;
+    int res = -1;
+
+    if ((address % SECTOR_SIZE) != 0 || address + (uint64_t)sectors * SECTOR_SIZE > link_capacity) {
+        fprintf(stderr, "image does not fit at 0x%08X or address not sector-aligned\n", (unsigned)address);
+        return -1;
+    }
+    padded = malloc(sectors * SECTOR_SIZE);
+    remote = malloc(sectors * sizeof(*remote) + 1);
+    local = malloc(sectors * sizeof(*local) + 1);
+    memset(padded, 0xFF, sectors * SECTOR_SIZE);
+    memcpy(padded, img, size);
+    for (i = 0; i < sectors; ++i) {
+        local[i] = W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, &padded[i * SECTOR_SIZE], SECTOR_SIZE));
+    }
+    if (prv_sector_crcs(address, sectors, remote, seq) != 0) {
+        goto out;
+    }
+
+    /* Erase runs of differing sectors, split at 64K blocks to bound reply latency */
+    for (i = 0; i < sectors; i = j) {
+        if (remote[i] == local[i]) {
+            j = i + 1;
+            continue;
+        }
+        for (j = i + 1; j < sectors && remote[j] != local[j]
+                        && ((address + j * SECTOR_SIZE) % BLOCK_SIZE) != 0; ++j) {}
+        run = j - i;
+        dirty += run;
+        prv_add(&reqs, &count, LINK_ERASE, address + i * SECTOR_SIZE, run * SECTOR_SIZE);
+        for (off = i * SECTOR_SIZE; off < j * SECTOR_SIZE; off += n) {
+            n = j * SECTOR_SIZE - off < link_max_data ? j * SECTOR_SIZE - off : link_max_data;
+            for (run = 0; run < n && padded[off + run] == 0xFF; ++run) {}
+            if (run == n) {
+                continue;
+            }
+            r = prv_add(&reqs, &count, LINK_WRITE, address + off, 0);
+            memcpy(&r->payload[4], &padded[off], n);
+            r->len = 4 + n;
+        }
+    }
+    printf("%u of %u sectors differ\n", (unsigned)dirty, (unsigned)sectors);
+    if (prv_run(reqs, count, *seq) != 0) {
+        goto out;
+    }
+    *seq += (uint8_t)count;
+
+    if (verify && dirty > 0) {
+        if (prv_sector_crcs(address, sectors, remote, seq) != 0) {
+            goto out;
+        }
+        for (i = 0; i < sectors; ++i) {
+            if (remote[i] != local[i]) {
+                fprintf(stderr, "verify failed at sector 0x%08X\n", (unsigned)(address + i * SECTOR_SIZE));
+                goto out;
+            }
+        }
+    }
+    res = 0;
+out:
+    free(reqs);
+    free(local);
+    free(remote);
+    free(padded);
+    return res;
+}
+
+static int
+prv_read(uint32_t address, uint8_t* out, uint32_t len, uint8_t* seq) {
+    req_t* reqs = NULL;
+    req_t* r;
+    uint32_t count = 0, off, n;
+    int res;
+
+    for (off = 0; off < len; off += n) {
+        n = len - off < link_max_data ? len - off : link_max_data;
+        prv_add(&reqs, &count, LINK_READ, address + off, n);
+    }
+    for (off = 0, r = reqs; r < reqs + count; ++r) {
+        r->out = out + off;
+        r->out_len = prv_get_u32(&r->payload[4]);
+        off += r->out_len;
+    }
+    res = prv_run(reqs, count, *seq);
+    *seq += (uint8_t)count;
+    free(reqs);
+    return res;
+}
+
+static uint8_t*
+prv_load(const char* path, uint32_t* size) {
+    FILE* fp = fopen(path, "rb");
+    uint8_t* buf = NULL;
+    long len;
+
+    if (fp == NULL) {
+        return NULL;
+    }
+    if (fseek(fp, 0, SEEK_END) == 0 && (len = ftell(fp)) > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        buf = malloc((size_t)len);
+        if (buf != NULL && fread(buf, 1, (size_t)len, fp) != (size_t)len) {
+            free(buf);
+            buf = NULL;
+        }
+        *size = (uint32_t)len;
+    }
+    fclose(fp);
+    return buf;
+}
+
+int
+main(int argc, char** argv) {
+    const char* dev = "/dev/ttyUSB0";
+    const char* path = NULL;
+    uint32_t baud = 460800, address = 0, length = 0, size = 0, i;
+    int mode = 0, verify = 1, res;
+    uint8_t seq = 0, info[12];
+    uint8_t* data = NULL;
+    uint64_t start;
+    req_t* reqs = NULL;
+    uint32_t count = 0;
+    FILE* fp;
+
+    for (i = 1; i < (uint32_t)argc; ++i) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < (uint32_t)argc) {
+            dev = argv[++i];
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < (uint32_t)argc) {
+            baud = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            verify = 0;
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < (uint32_t)argc) {
+            mode = 'w';
+            address = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 2 < (uint32_t)argc) {
+            mode = 'r';
+            address = (uint32_t)strtoul(argv[++i], NULL, 0);
+            length = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            mode = 0;
+            break;
+        }
+    }
+    if (mode == 0 || path == NULL || (mode == 'r' && length == 0)) {
+        fprintf(stderr, "usage: %s [-d tty] [-b baud] [-n] -w address image.bin\n"
+                        "       %s [-d tty] [-b baud] -r address length out.bin\n", argv[0], argv[0]);
+        return 1;
+    }
+    if (mode == 'w' && (data = prv_load(path, &size)) == NULL) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+    if (prv_open(dev, baud) != 0) {
+        return 1;
+    }
+
+    /* Hello uses window of one, target tells its window in reply */
+    prv_add(&reqs, &count, LINK_HELLO, 0, 0);
+    reqs[0].out = info;
+    reqs[0].out_len = sizeof(info);
+    if (prv_run(reqs, count, seq) != 0) {
+        return 1;
+    }
+    ++seq;
+    if (info[1] != LINK_VERSION) {
+        fprintf(stderr, "unsupported protocol version %u\n", info[1]);
+        return 1;
+    }
+    link_window = info[0] > 0 ? info[0] : 1;
+    link_max_data = prv_get_u32(&info[4]);
+    link_capacity = prv_get_u32(&info[8]);
+    if (link_max_data == 0 || link_max_data > 4096) {
+        link_max_data = 256;
+    }
+    printf("target: device ID 0x%02X, %u bytes, window %u, %u bytes per frame\n", info[2],
+           (unsigned)link_capacity, (unsigned)link_window, (unsigned)link_max_data);
+
+    start = prv_now_ms();
+    if (mode == 'w') {
+        res = prv_write_image(address, data, size, verify, &seq);
+    } else {
+        data = malloc(length);
+        res = prv_read(address, data, length, &seq);
+        if (res == 0) {
+            fp = fopen(path, "wb");
+            if (fp == NULL || fwrite(data, 1, length, fp) != length) {
+                fprintf(stderr, "cannot write %s\n", path);
+                res = -1;
+            }
+            if (fp != NULL) {
+                fclose(fp);
+            }
+        }
+        size = length;
+    }
+    if (res == 0) {
+        count = 0;
+        prv_add(&reqs, &count, LINK_END, 0, 0);
+        res = prv_run(reqs, count, seq);
+    }
+    if (res == 0) {
+        double s = (double)(prv_now_ms() - start) / 1000.0;
+        printf("done: %u bytes in %.2f s, %u bytes sent, %u frames resent\n", (unsigned)size, s,
+               (unsigned)tx_bytes, (unsigned)resends);
+    }
+    free(reqs);
+    free(data);
+    close(fd);
+    return res == 0 ? 0 : 1;
+}
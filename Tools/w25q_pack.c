@@ -0,0 +1,349 @@
+/**
+ * \file            w25q_pack.c
+ * \brief           Host tool packing firmware images for streaming decoder
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+
+/*
+ * Produces LZ compressed images and delta patches understood by w25q_unpack.
+ *
+ * Build:
+ *  gcc -std=c11 -O2 -I../W25Q w25q_pack.c ../W25Q/w25q_crc.c -o w25q_pack
+ *
+ * Usage:
+ *  w25q_pack [-z] [-w bits] [-d old.bin] [-p page] new.bin out.bin
+ *      -z          LZ compress output
+ *      -w bits     LZ window bits, must not exceed W25Q_UNPACK_WINDOW_BITS of target (default 10)
+ *      -d old.bin  Create delta patch against old image
+ *      -p page     Output overwrites old image in place with given page size (e.g. 2048)
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "w25q_crc.h"
+
+#define DELTA_OP_COPY                   0x01
+#define DELTA_OP_INSERT                 0x02
+#define DELTA_OP_DIFF                   0x03
+
+#define LZ_MIN_MATCH                    3
+#define LZ_MAX_MATCH                    (LZ_MIN_MATCH + 15 + 255)
+#define HASH_BITS                       16
+#define HASH_SIZE                       (1UL << HASH_BITS)
+#define CHAIN_LIMIT                     128
+#define DELTA_MIN_COPY                  8
+#define DELTA_MIN_DIFF                  16
+
+/**
+ * \brief           Growable byte buffer
+ */
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+} buf_t;
+
+static void
+buf_put(buf_t* b, uint8_t v) {
+    if (b->len == b->cap) {
+        b->cap = b->cap ? 2 * b->cap : 4096;
+        b->data = realloc(b->data, b->cap);
+        if (b->data == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    b->data[b->len++] = v;
+}
+
+static void
+buf_put_varint(buf_t* b, uint32_t v) {
+    while (v >= 0x80) {
+        buf_put(b, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    buf_put(b, (uint8_t)v);
+}
+
+static uint8_t*
+read_file(const char* path, size_t* len) {
+    FILE* f;
+    uint8_t* data;
+    long size;
+
+    if ((f = fopen(path, "rb")) == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(size > 0 ? (size_t)size : 1);
+    if (data == NULL || fread(data, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, "%s: read error\n", path);
+        exit(1);
+    }
+    fclose(f);
+    *len = (size_t)size;
+    return data;
+}
+
+static uint32_t
+hash4(const uint8_t* p) {
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+
+    return (uint32_t)(v * 2654435761UL) >> (32 - HASH_BITS);
+}
+
+/**
+ * \brief           Check old image byte may be referenced when producing output byte `out`
+ */
+static int
+old_allowed(size_t idx, size_t out, size_t old_len, size_t page) {
+    return idx < old_len && (page == 0 || idx >= out - (out % page));
+}
+
+/**
+ * \brief           Build delta patch of `cur` against `old`
+ */
+static void
+delta_encode(const uint8_t* old, size_t old_len, const uint8_t* cur, size_t cur_len, size_t page, buf_t* out) {
+    int32_t* head = malloc(HASH_SIZE * sizeof(int32_t));
+    int32_t* prev = malloc((old_len + 1) * sizeof(int32_t));
+    size_t p = 0, ins_start = 0, i, best_len, best_off, len, miss, last_match;
+    long bias = 0;
+    int32_t q;
+    int chain;
+
+    for (i = 0; i < HASH_SIZE; ++i) {
+        head[i] = -1;
+    }
+    for (i = 0; i + 4 <= old_len; ++i) {
+        uint32_t h = hash4(&old[i]);
+        prev[i] = head[h];
+        head[h] = (int32_t)i;
+    }
+
+#define FLUSH_INSERT()                                              \
+    do {                                                            \
+        if (p > ins_start) {                                        \
+            buf_put(out, DELTA_OP_INSERT);                          \
+            buf_put_varint(out, (uint32_t)(p - ins_start));         \
+            for (i = ins_start; i < p; ++i) {                       \
+                buf_put(out, cur[i]);                               \
+            }                                                       \
+        }                                                           \
+    } while (0)
+
+    while (p < cur_len) {
+        best_len = 0;
+        best_off = 0;
+        if (p + 4 <= cur_len) {
+            for (q = head[hash4(&cur[p])], chain = 0; q >= 0 && chain < CHAIN_LIMIT; q = prev[q], ++chain) {
+                for (len = 0; p + len < cur_len && old_allowed((size_t)q + len, p + len, old_len, page)
+                              && old[q + len] == cur[p + len]; ++len) {
+                }
+                if (len > best_len) {
+                    best_len = len;
+                    best_off = (size_t)q;
+                }
+            }
+        }
+        if (best_len >= DELTA_MIN_COPY) {
+            FLUSH_INSERT();
+            buf_put(out, DELTA_OP_COPY);
+            buf_put_varint(out, (uint32_t)best_off);
+            buf_put_varint(out, (uint32_t)best_len);
+            bias = (long)best_off - (long)p;
+            p += best_len;
+            ins_start = p;
+            continue;
+        }
+
+        /* Same alignment as last copy with a few changed bytes, e.g. shifted addresses */
+        if ((long)p + bias >= 0) {
+            size_t o = (size_t)((long)p + bias);
+            last_match = 0;
+            miss = 0;
+            for (len = 0; p + len < cur_len && old_allowed(o + len, p + len, old_len, page); ++len) {
+                if (old[o + len] == cur[p + len]) {
+                    last_match = len + 1;
+                    miss = 0;
+                } else if (++miss >= 8) {
+                    break;
+                }
+            }
+            if (last_match >= DELTA_MIN_DIFF) {
+                FLUSH_INSERT();
+                buf_put(out, DELTA_OP_DIFF);
+                buf_put_varint(out, (uint32_t)o);
+                buf_put_varint(out, (uint32_t)last_match);
+                for (i = 0; i < last_match; ++i) {
+                    buf_put(out, (uint8_t)(cur[p + i] - old[o + i]));
+                }
+                p += last_match;
+                ins_start = p;
+                continue;
+            }
+        }
+        ++p;
+    }
+    FLUSH_INSERT();
+#undef FLUSH_INSERT
+
+    free(head);
+    free(prev);
+}
+
+/**
+ * \brief           LZ compress `in` with given window
+ */
+static void
+lz_encode(const uint8_t* in, size_t in_len, unsigned window_bits, buf_t* out) {
+    int32_t* head = malloc(HASH_SIZE * sizeof(int32_t));
+    int32_t* prev = malloc((in_len + 1) * sizeof(int32_t));
+    size_t window = (size_t)1 << window_bits, p = 0, flag_pos = 0, i, len, best_len, best_dist, max;
+    unsigned flag_bit = 8;
+    int32_t q;
+    int chain;
+
+    for (i = 0; i < HASH_SIZE; ++i) {
+        head[i] = -1;
+    }
+
+    while (p < in_len) {
+        if (flag_bit == 8) {
+            flag_pos = out->len;
+            buf_put(out, 0);
+            flag_bit = 0;
+        }
+
+        best_len = 0;
+        best_dist = 0;
+        if (p + 4 <= in_len) {
+            max = in_len - p < LZ_MAX_MATCH ? in_len - p : LZ_MAX_MATCH;
+            for (q = head[hash4(&in[p])], chain = 0; q >= 0 && p - (size_t)q <= window && chain < CHAIN_LIMIT;
+                 q = prev[q], ++chain) {
+                for (len = 0; len < max && in[q + len] == in[p + len]; ++len) {
+                }
+                if (len > best_len) {
+                    best_len = len;
+                    best_dist = p - (size_t)q;
+                }
+            }
+        }
+
+        if (best_len >= LZ_MIN_MATCH) {
+            size_t code = best_len - LZ_MIN_MATCH;
+            buf_put(out, (uint8_t)(best_dist - 1));
+            buf_put(out, (uint8_t)(((best_dist - 1) >> 8) | ((code > 15 ? 15 : code) << 4)));
+            if (code >= 15) {
+                buf_put(out, (uint8_t)(code - 15));
+            }
+        } else {
+            best_len = 1;
+            out->data[flag_pos] |= (uint8_t)(1U << flag_bit);
+            buf_put(out, in[p]);
+        }
+        ++flag_bit;
+
+        for (i = 0; i < best_len; ++i, ++p) {
+            if (p + 4 <= in_len) {
+                uint32_t h = hash4(&in[p]);
+                prev[p] = head[h];
+                head[h] = (int32_t)p;
+            }
+        }
+    }
+
+    free(head);
+    free(prev);
+}
+
+int
+main(int argc, char** argv) {
+    const char *old_path = NULL, *in_path, *out_path;
+    uint8_t *old = NULL, *cur;
+    size_t old_len = 0, cur_len, page = 0;
+    unsigned window_bits = 10, format = 0;
+    buf_t patch = {0}, packed = {0}, *result;
+    FILE* f;
+    int i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+        if (strcmp(argv[i], "-z") == 0) {
+            format |= 0x01;
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            window_bits = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            old_path = argv[++i];
+            format |= 0x02;
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            page = (size_t)atol(argv[++i]);
+        } else {
+            break;
+        }
+    }
+    if (argc - i != 2 || window_bits < 4 || window_bits > 12) {
+        fprintf(stderr, "usage: %s [-z] [-w bits] [-d old.bin] [-p page] new.bin out.bin\n", argv[0]);
+        return 1;
+    }
+    in_path = argv[i];
+    out_path = argv[i + 1];
+
+    cur = read_file(in_path, &cur_len);
+    if (old_path != NULL) {
+        old = read_file(old_path, &old_len);
+        delta_encode(old, old_len, cur, cur_len, page, &patch);
+    } else {
+        patch.data = cur;
+        patch.len = cur_len;
+    }
+    if (format & 0x01) {
+        lz_encode(patch.data, patch.len, window_bits, &packed);
+        result = &packed;
+    } else {
+        result = &patch;
+    }
+
+    if ((f = fopen(out_path, "wb")) == NULL || fwrite(result->data, 1, result->len, f) != result->len) {
+        perror(out_path);
+        return 1;
+    }
+    fclose(f);
+
+    printf("format=%u window_bits=%u size=%zu crc=0x%08lX out_size=%zu out_crc=0x%08lX\n", format,
+           window_bits, result->len,
+           (unsigned long)W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, result->data, (uint32_t)result->len)),
+           cur_len, (unsigned long)W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, cur, (uint32_t)cur_len)));
+    return 0;
+}
@@ -0,0 +1,392 @@
+/**
+ * \file            w25q_replay.c
+ * \brief           Host tool replaying captured SPI traces on the emulator
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+
+/*
+ * Reads a trace exported by w25q_trace_export (raw or embedded in a UART
+ * capture), turns the command stream back into logical read, page program
+ * and erase calls and runs them through the library on w25q_emu. Status
+ * polls and write enables in the trace are dropped, the driver under test
+ * issues its own. Comparing runs with different driver builds or options
+ * shows the effect of a change on the captured workload.
+ *
+ * Build:
+ *  gcc -std=c11 -O2 -I../W25Q -I. w25q_replay.c w25q_emu.c ../W25Q/w25q.c ../W25Q/w25q_crc.c -o w25q_replay
+ *
+ * Usage:
+ *  w25q_replay [-c id] [-s hz] [-m] [-f json|csv] trace.bin
+ *      -c id       JEDEC capacity byte of emulated chip (default 0x18, W25Q128)
+ *      -s hz       SPI clock (default 18000000)
+ *      -m          Merge back-to-back contiguous reads into one call
+ *      -f format   Output format (default json)
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "w25q.h"
+#include "w25q_crc.h"
+#include "w25q_emu.h"
+
+#define TRACE_MAGIC                     0x52353257UL    /* "W25R" */
+#define TRACE_HDR_SIZE                  16
+#define TRACE_REC_SIZE                  16
+#define TRACE_HDR_NO_OPCODE             0x80            /* hdr_len flag, see w25q_trace.h */
+
+/* Logical operation recovered from trace */
+typedef enum {
+    OP_READ,
+    OP_PROGRAM,
+    OP_ERASE_4K,
+    OP_ERASE_32K,
+    OP_ERASE_64K,
+    OP_ERASE_CHIP,
+} op_type_t;
+
+typedef struct {
+    op_type_t type;
+    uint32_t addr;
+    uint32_t len;
+} op_t;
+
+/* Trace summary */
+typedef struct {
+    uint32_t records;                           /* Transactions in trace */
+    uint32_t dropped;                           /* Transactions lost on target */
+    uint32_t status_polls;                      /* Status register reads */
+    uint32_t other;                             /* Commands not replayed */
+    uint64_t bus_bytes;                         /* Header and data bytes */
+    uint32_t span_us;                           /* First to last timestamp */
+} trace_info_t;
+
+static uint8_t buf[65536];
+
+/**
+ * \brief           Load little-endian 32-bit value
+ */
+static uint32_t
+prv_get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * \brief           Find and decode trace in file content
+ * \param[in]       data: File content
+ * \param[in]       size: File size
+ * \param[out]      ops: Allocated array of logical operations
+ * \param[out]      op_count: Number of operations
+ * \param[out]      info: Trace summary
+ * \return          `0` on success, `-1` otherwise
+ */
+static int
+prv_decode(const uint8_t* data, size_t size, op_t** ops, uint32_t* op_count, trace_info_t* info) {
+    const uint8_t* rec;
+    uint32_t count, n = 0, first = 0, last = 0;
+    uint8_t addr4 = 0;
+    size_t pos;
+
+    for (pos = 0; pos + TRACE_HDR_SIZE + 4 <= size; ++pos) {
+        if (prv_get_u32(&data[pos]) != TRACE_MAGIC || data[pos + 5] != TRACE_REC_SIZE) {
+            continue;
+        }
+        count = prv_get_u32(&data[pos + 8]);
+        if ((size - pos - TRACE_HDR_SIZE - 4) / TRACE_REC_SIZE < count) {
+            continue;
+        }
+        if (W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, &data[pos], TRACE_HDR_SIZE + count * TRACE_REC_SIZE))
+            != prv_get_u32(&data[pos + TRACE_HDR_SIZE + count * TRACE_REC_SIZE])) {
+            continue;
+        }
+        break;
+    }
+    if (pos + TRACE_HDR_SIZE + 4 > size) {
+        fprintf(stderr, "no valid trace found\n");
+        return -1;
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->records = count;
+    info->dropped = prv_get_u32(&data[pos + 12]);
+    *ops = calloc(count + 1, sizeof(op_t));
+    if (*ops == NULL) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t addr, len, time;
+        uint8_t opcode, hdr_len, addr_len, addr_bytes, no_opcode;
+
+        rec = &data[pos + TRACE_HDR_SIZE + i * TRACE_REC_SIZE];
+        time = prv_get_u32(&rec[0]);
+        addr = prv_get_u32(&rec[4]);
+        len = prv_get_u32(&rec[8]);
+        opcode = rec[14];
+        no_opcode = (rec[15] & TRACE_HDR_NO_OPCODE) != 0;
+        hdr_len = rec[15] & (uint8_t)~TRACE_HDR_NO_OPCODE;
+        if (i == 0) {
+            first = time;
+        }
+        last = time;
+        info->bus_bytes += hdr_len + len;
+
+        /* Record keeps up to 4 header bytes after the opcode, bytes past the address (mode, dummy) are dropped */
+        addr_len = addr4 ? 4 : 3;
+        addr_bytes = no_opcode ? hdr_len : (hdr_len > 0 ? hdr_len - 1 : 0);
+        if (addr_bytes > 4) {
+            addr_bytes = 4;
+        }
+        if (addr_bytes > addr_len) {
+            addr >>= 8 * (addr_bytes - addr_len);
+        }
+
+        /* Continuous read mode: address without opcode, anything else is a mode reset */
+        if (no_opcode) {
+            if (len > 0) {
+                (*ops)[n++] = (op_t){OP_READ, addr, len};
+            } else {
+                info->other++;
+            }
+            continue;
+        }
+
+        switch (opcode) {
+            case 0x03: case 0x0B: case 0x3B: case 0x6B: case 0xBB: case 0xEB:
+                (*ops)[n++] = (op_t){OP_READ, addr, len};
+                break;
+            case 0x02: case 0x32:
+                (*ops)[n++] = (op_t){OP_PROGRAM, addr, len};
+                break;
+            case 0x20:
+                (*ops)[n++] = (op_t){OP_ERASE_4K, addr, 4096};
+                break;
+            case 0x52:
+                (*ops)[n++] = (op_t){OP_ERASE_32K, addr, 32768};
+                break;
+            case 0xD8:
+                (*ops)[n++] = (op_t){OP_ERASE_64K, addr, 65536};
+                break;
+            case 0xC7: case 0x60:
+                (*ops)[n++] = (op_t){OP_ERASE_CHIP, 0, 0};
+                break;
+            case 0x05:
+                info->status_polls++;
+                break;
+            case 0xB7:
+                addr4 = 1;
+                info->other++;
+                break;
+            case 0xE9:
+                addr4 = 0;
+                info->other++;
+                break;
+            default:
+                info->other++;
+                break;
+        }
+    }
+    info->span_us = last - first;
+    *op_count = n;
+    return 0;
+}
+
+/**
+ * \brief           Merge back-to-back contiguous reads
+ * \param[in,out]   ops: Operations
+ * \param[in]       count: Number of operations
+ * \return          New number of operations
+ */
+static uint32_t
+prv_merge_reads(op_t* ops, uint32_t count) {
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (n > 0 && ops[i].type == OP_READ && ops[n - 1].type == OP_READ
+            && ops[n - 1].addr + ops[n - 1].len == ops[i].addr
+            && ops[n - 1].len + ops[i].len <= sizeof(buf)) {
+            ops[n - 1].len += ops[i].len;
+        } else {
+            ops[n++] = ops[i];
+        }
+    }
+    return n;
+}
+
+/**
+ * \brief           Run operations through library
+ * \param[in]       dev: Device on emulator
+ * \param[in]       ops: Operations
+ * \param[in]       count: Number of operations
+ * \return          Number of failed calls
+ */
+static uint32_t
+prv_replay(w25q_t* dev, const op_t* ops, uint32_t count) {
+    uint32_t failed = 0;
+    w25q_result_t res;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const op_t* op = &ops[i];
+
+        switch (op->type) {
+            case OP_READ:
+                res = W25Q_OK;
+                for (uint32_t done = 0; done < op->len && res == W25Q_OK;) {
+                    uint32_t chunk = op->len - done > sizeof(buf) ? sizeof(buf) : op->len - done;
+
+                    res = w25q_read(dev, op->addr + done, buf, chunk);
+                    done += chunk;
+                }
+                break;
+            case OP_PROGRAM:
+                res = w25q_write_page(dev, op->addr, buf, op->len > 256 ? 256 : op->len);
+                break;
+            case OP_ERASE_4K:
+                res = w25q_erase_sector(dev, op->addr);
+                break;
+            case OP_ERASE_32K:
+                res = w25q_erase_block_32k(dev, op->addr);
+                break;
+            case OP_ERASE_64K:
+                res = w25q_erase_block_64k(dev, op->addr);
+                break;
+            default:
+                res = w25q_erase_chip(dev);
+                break;
+        }
+        if (res != W25Q_OK) {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+int
+main(int argc, char** argv) {
+    w25q_emu_cfg_t cfg;
+    w25q_emu_stats_t st;
+    trace_info_t info;
+    w25q_t flash;
+    op_t* ops;
+    uint8_t* data;
+    const char* path = NULL;
+    uint8_t capacity_id = W25Q128, csv = 0, merge = 0;
+    uint32_t spi_hz = 18000000UL, op_count, failed;
+    long size;
+    FILE* f;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            capacity_id = (uint8_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            spi_hz = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            csv = strcmp(argv[++i], "csv") == 0;
+        } else if (strcmp(argv[i], "-m") == 0) {
+            merge = 1;
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        fprintf(stderr, "usage: %s [-c id] [-s hz] [-m] [-f json|csv] trace.bin\n", argv[0]);
+        return 1;
+    }
+
+    f = fopen(path, "rb");
+    if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+    data = malloc((size_t)size + 1);
+    if (data == NULL || fread(data, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 1;
+    }
+    fclose(f);
+
+    if (prv_decode(data, (size_t)size, &ops, &op_count, &info) != 0) {
+        return 1;
+    }
+    if (merge) {
+        op_count = prv_merge_reads(ops, op_count);
+    }
+
+    w25q_emu_default_cfg(&cfg, capacity_id);
+    cfg.spi_hz = spi_hz;
+    if (w25q_emu_init(&cfg) != 0 || w25q_init(&flash, &w25q_emu_ll) != W25Q_OK) {
+        fprintf(stderr, "cannot initialize emulated chip 0x%02X\n", capacity_id);
+        return 1;
+    }
+    memset(buf, 0x5A, sizeof(buf));
+    w25q_emu_reset_stats();
+    failed = prv_replay(&flash, ops, op_count);
+    w25q_emu_get_stats(&st);
+
+    if (csv) {
+        printf("trace_records,trace_dropped,trace_status_polls,trace_bus_bytes,trace_span_us,ops,failed,"
+               "time_us,bus_bytes,cs_toggles,status_polls,read_bytes,program_bytes,page_programs,"
+               "sector_erases,block32_erases,block64_erases,chip_erases,violations\n");
+        printf("%lu,%lu,%lu,%llu,%lu,%lu,%lu,%.1f,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+               (unsigned long)info.records, (unsigned long)info.dropped, (unsigned long)info.status_polls,
+               (unsigned long long)info.bus_bytes, (unsigned long)info.span_us, (unsigned long)op_count,
+               (unsigned long)failed, (double)st.time_ns / 1000.0, (unsigned long long)(st.bytes_tx + st.bytes_rx),
+               (unsigned long long)st.cs_toggles, (unsigned long long)st.status_polls,
+               (unsigned long long)st.read_bytes, (unsigned long long)st.program_bytes,
+               (unsigned long long)st.page_programs, (unsigned long long)st.sector_erases,
+               (unsigned long long)st.block32_erases, (unsigned long long)st.block64_erases,
+               (unsigned long long)st.chip_erases, (unsigned long long)st.violations);
+    } else {
+        printf("{\n  \"trace\": {\"records\": %lu, \"dropped\": %lu, \"status_polls\": %lu, \"other\": %lu, "
+               "\"bus_bytes\": %llu, \"span_us\": %lu},\n",
+               (unsigned long)info.records, (unsigned long)info.dropped, (unsigned long)info.status_polls,
+               (unsigned long)info.other, (unsigned long long)info.bus_bytes, (unsigned long)info.span_us);
+        printf("  \"replay\": {\"chip\": \"0x%02X\", \"spi_hz\": %lu, \"merge_reads\": %u, \"ops\": %lu, \"failed\": %lu, "
+               "\"time_us\": %.1f, \"bus_bytes\": %llu, \"cs_toggles\": %llu, \"status_polls\": %llu, "
+               "\"read_bytes\": %llu, \"program_bytes\": %llu, \"page_programs\": %llu, \"sector_erases\": %llu, "
+               "\"block32_erases\": %llu, \"block64_erases\": %llu, \"chip_erases\": %llu, \"violations\": %llu}\n}\n",
+               capacity_id, (unsigned long)spi_hz, merge, (unsigned long)op_count, (unsigned long)failed,
+               (double)st.time_ns / 1000.0, (unsigned long long)(st.bytes_tx + st.bytes_rx),
+               (unsigned long long)st.cs_toggles, (unsigned long long)st.status_polls,
+               (unsigned long long)st.read_bytes, (unsigned long long)st.program_bytes,
+               (unsigned long long)st.page_programs, (unsigned long long)st.sector_erases,
+               (unsigned long long)st.block32_erases, (unsigned long long)st.block64_erases,
+               (unsigned long long)st.chip_erases, (unsigned long long)st.violations);
+    }
+
+    w25q_emu_deinit();
+    free(ops);
+    free(data);
+    return failed > 0 ? 1 : 0;
+}
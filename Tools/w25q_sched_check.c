@@ -0,0 +1,309 @@
+/**
+ * \file            w25q_sched_check.c
+ * \brief           Host check of I/O scheduler against serial execution
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+
+/*
+ * Submits random sets of overlapping and interleaved erases and writes to
+ * w25q_sched on the emulator and compares the flash content with the same
+ * requests executed one by one in submit order. Merging and reordering must
+ * never change what ends up on flash.
+ *
+ * Build:
+ *  gcc -std=c11 -O2 -I../W25Q -I. w25q_sched_check.c w25q_emu.c ../W25Q/w25q.c ../W25Q/w25q_crc.c \
+ *      ../W25Q/w25q_sched.c -o w25q_sched_check
+ *
+ * Usage:
+ *  w25q_sched_check [-n rounds] [-r seed]
+ *      -n rounds   Request sets to check (default 200)
+ *      -r seed     Random seed (default 1)
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "w25q.h"
+#include "w25q_emu.h"
+#include "w25q_sched.h"
+
+#define CHECK_REGION                    0x20000UL   /* Requests fall into first two 64KB blocks */
+#define CHECK_MAX_WRITE                 600         /* Longest write, spans up to 4 pages */
+#define CHECK_MAX_SECTORS               20          /* Longest erase in sectors */
+
+/* Request of one round */
+typedef struct {
+    uint32_t address;                           /* Flash address */
+    uint32_t len;                               /* Number of bytes */
+    uint8_t erase;                              /* `1` for erase, `0` for write */
+    uint8_t done;                               /* Number of completion callbacks */
+    w25q_result_t res;                          /* Result from completion callback */
+} check_req_t;
+
+/* Accumulated emulator statistics of one execution path */
+typedef struct {
+    uint64_t page_programs;                     /* Page program commands */
+    uint64_t erases;                            /* Sector and block erase commands */
+    uint64_t time_ns;                           /* Modeled time */
+    uint64_t violations;                        /* Protocol violations */
+} check_stats_t;
+
+static w25q_t flash;
+static w25q_sched_t sched;
+static check_req_t reqs[W25Q_SCHED_MAX_REQS];
+static uint8_t data[W25Q_SCHED_MAX_REQS][CHECK_MAX_WRITE];
+static uint8_t base[CHECK_REGION], expect[CHECK_REGION], got[CHECK_REGION];
+static check_stats_t serial_stats, sched_stats;
+static uint32_t rng = 0x12345678UL;
+static uint32_t failures;
+
+/**
+ * \brief           Pseudo random number
+ * \return          Next value
+ */
+static uint32_t
+prv_rand(void) {
+    rng = rng * 1664525UL + 1013904223UL;
+    return rng >> 8;
+}
+
+/**
+ * \brief           Check API result
+ * \param[in]       res: Result to check
+ */
+static void
+prv_check(w25q_result_t res) {
+    if (res != W25Q_OK) {
+        failures++;
+    }
+}
+
+/**
+ * \brief           Write data with page programs, not crossing page boundaries
+ * \param[in]       address: Flash address
+ * \param[in]       buf: Data to write
+ * \param[in]       len: Number of bytes
+ */
+static void
+prv_write(uint32_t address, const uint8_t* buf, uint32_t len) {
+    uint32_t n;
+
+    for (; len > 0; address += n, buf += n, len -= n) {
+        n = flash.info.page_size - (address % flash.info.page_size);
+        n = (n < len) ? n : len;
+        prv_check(w25q_write_page(&flash, address, buf, n));
+    }
+}
+
+/**
+ * \brief           Restore region to round's initial content, not measured
+ */
+static void
+prv_restore(void) {
+    prv_check(w25q_erase_range(&flash, 0, CHECK_REGION));
+    prv_write(0, base, CHECK_REGION);
+}
+
+/**
+ * \brief           Add emulator statistics since last reset
+ * \param[out]      stats: Statistics to add to
+ */
+static void
+prv_account(check_stats_t* stats) {
+    w25q_emu_stats_t s;
+
+    w25q_emu_get_stats(&s);
+    stats->page_programs += s.page_programs;
+    stats->erases += s.sector_erases + s.block32_erases + s.block64_erases;
+    stats->time_ns += s.time_ns;
+    stats->violations += s.violations;
+}
+
+/**
+ * \brief           Create random request set and initial content
+ * \return          Number of requests
+ */
+static uint32_t
+prv_generate(void) {
+    uint32_t count = 1 + prv_rand() % W25Q_SCHED_MAX_REQS;
+    check_req_t* r;
+
+    for (uint32_t i = 0; i < CHECK_REGION; ++i) {
+        /* Some erased bytes, so writes into them show up after an erase */
+        base[i] = (prv_rand() % 4) ? (uint8_t)prv_rand() : 0xFF;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        r = &reqs[i];
+        memset(r, 0x00, sizeof(*r));
+        if (prv_rand() % 3 == 0) {
+            r->erase = 1;
+            r->address = (prv_rand() % (CHECK_REGION / flash.info.sector_size)) * flash.info.sector_size;
+            r->len = (1 + prv_rand() % CHECK_MAX_SECTORS) * flash.info.sector_size;
+            r->len = (r->len < CHECK_REGION - r->address) ? r->len : CHECK_REGION - r->address;
+        } else {
+            r->address = prv_rand() % CHECK_REGION;
+            r->len = 1 + prv_rand() % CHECK_MAX_WRITE;
+            r->len = (r->len < CHECK_REGION - r->address) ? r->len : CHECK_REGION - r->address;
+            for (uint32_t j = 0; j < r->len; ++j) {
+                data[i][j] = (uint8_t)prv_rand();
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * \brief           Execute requests one by one in submit order
+ * \param[in]       count: Number of requests
+ */
+static void
+prv_run_serial(uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        if (reqs[i].erase) {
+            for (uint32_t a = reqs[i].address; a < reqs[i].address + reqs[i].len; a += flash.info.sector_size) {
+                prv_check(w25q_erase_sector(&flash, a));
+            }
+        } else {
+            prv_write(reqs[i].address, data[i], reqs[i].len);
+        }
+    }
+}
+
+/**
+ * \brief           Completion callback of scheduled request
+ * \param[in]       arg: Request
+ * \param[in]       res: Batch result
+ */
+static void
+prv_done(void* arg, w25q_result_t res) {
+    check_req_t* r = arg;
+
+    r->done++;
+    r->res = res;
+}
+
+/**
+ * \brief           Execute requests through scheduler
+ *
+ * Half of the rounds drain the queue once in the middle, so later requests
+ * meet a sweep position left by earlier batches.
+ *
+ * \param[in]       count: Number of requests
+ */
+static void
+prv_run_sched(uint32_t count) {
+    uint32_t split = (prv_rand() % 2) ? prv_rand() % count : count;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        if (i == split) {
+            prv_check(w25q_sched_run(&sched));
+        }
+        if (reqs[i].erase) {
+            prv_check(w25q_sched_erase(&sched, reqs[i].address, reqs[i].len, prv_done, &reqs[i]));
+        } else {
+            prv_check(w25q_sched_write(&sched, reqs[i].address, data[i], reqs[i].len, prv_done, &reqs[i]));
+        }
+    }
+    prv_check(w25q_sched_run(&sched));
+    if (w25q_sched_pending(&sched) != 0) {
+        failures++;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        if (reqs[i].done != 1 || reqs[i].res != W25Q_OK) {
+            failures++;
+        }
+    }
+}
+
+int
+main(int argc, char** argv) {
+    w25q_emu_cfg_t cfg;
+    uint32_t rounds = 200, requests = 0, mismatches = 0, count;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            rounds = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rng = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "usage: %s [-n rounds] [-r seed]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    w25q_emu_default_cfg(&cfg, W25Q16);
+    if (w25q_emu_init(&cfg) != 0 || w25q_init(&flash, &w25q_emu_ll) != W25Q_OK
+        || w25q_sched_init(&sched, &flash) != W25Q_OK) {
+        fprintf(stderr, "cannot initialize emulated chip\n");
+        return 1;
+    }
+
+    for (uint32_t round = 0; round < rounds; ++round) {
+        count = prv_generate();
+        requests += count;
+
+        prv_restore();
+        w25q_emu_reset_stats();
+        prv_run_serial(count);
+        prv_account(&serial_stats);
+        w25q_emu_peek(0, expect, CHECK_REGION);
+
+        prv_restore();
+        w25q_emu_reset_stats();
+        prv_run_sched(count);
+        prv_account(&sched_stats);
+        w25q_emu_peek(0, got, CHECK_REGION);
+
+        for (uint32_t a = 0; a < CHECK_REGION; ++a) {
+            if (expect[a] != got[a]) {
+                fprintf(stderr, "round %lu: 0x%06lX expected 0x%02X, got 0x%02X\n", (unsigned long)round,
+                        (unsigned long)a, expect[a], got[a]);
+                mismatches++;
+                break;
+            }
+        }
+    }
+    w25q_emu_deinit();
+
+    printf("{\n  \"rounds\": %lu, \"requests\": %lu, \"mismatches\": %lu, \"failed\": %lu,\n", (unsigned long)rounds,
+           (unsigned long)requests, (unsigned long)mismatches, (unsigned long)failures);
+    printf("  \"serial\": {\"page_programs\": %llu, \"erases\": %llu, \"time_us\": %.1f, \"violations\": %llu},\n",
+           (unsigned long long)serial_stats.page_programs, (unsigned long long)serial_stats.erases,
+           (double)serial_stats.time_ns / 1000.0, (unsigned long long)serial_stats.violations);
+    printf("  \"sched\": {\"page_programs\": %llu, \"erases\": %llu, \"time_us\": %.1f, \"violations\": %llu}\n}\n",
+           (unsigned long long)sched_stats.page_programs, (unsigned long long)sched_stats.erases,
+           (double)sched_stats.time_ns / 1000.0, (unsigned long long)sched_stats.violations);
+
+    if (mismatches > 0 || failures > 0 || serial_stats.violations > 0 || sched_stats.violations > 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -32,7 +32,11 @@
  * Version:         v1.0.1
  */
 #include "w25q.h"
+#if W25Q_CFG_CRC && W25Q_CFG_STREAM_CHUNK
+#include "w25q_crc.h"
+#endif /* W25Q_CFG_CRC && W25Q_CFG_STREAM_CHUNK */
 #include <stddef.h>
+#include <string.h>
 
 /* W25Q command definitions */
 #define W25Q_CMD_WRITE_ENABLE           0x06
@@ -55,13 +59,103 @@
 #define W25Q_CMD_JEDEC_ID               0x9F
 #define W25Q_CMD_READ_DATA              0x03
 #define W25Q_CMD_FAST_READ              0x0B
+#define W25Q_CMD_FAST_READ_DUAL_OUT     0x3B
+#define W25Q_CMD_FAST_READ_QUAD_OUT     0x6B
+#define W25Q_CMD_FAST_READ_QUAD_IO      0xEB
 #define W25Q_CMD_READ_UNIQUE_ID         0x4B
 #define W25Q_CMD_ENTER_4BYTE_MODE       0xB7
 #define W25Q_CMD_EXIT_4BYTE_MODE        0xE9
+#define W25Q_CMD_ENTER_QPI              0x38
+#define W25Q_CMD_EXIT_QPI               0xFF
+#define W25Q_CMD_SET_READ_PARAMS        0xC0
+#define W25Q_CMD_JEDEC_ID_QPI           0xAF
+#define W25Q_CMD_SET_BURST_WRAP         0x77
+#define W25Q_CMD_BURST_READ_WRAP_QPI    0x0C
+#define W25Q_CMD_ENABLE_RESET           0x66
+#define W25Q_CMD_RESET                  0x99
 
 /* Status register bit definitions */
 #define W25Q_STATUS_BUSY                0x01
 #define W25Q_STATUS_WEL                 0x02
+#define W25Q_STATUS2_QE                 0x02
+#define W25Q_STATUS2_SUS                0x80
+
+#if W25Q_CFG_QPI_DUMMY != 2 && W25Q_CFG_QPI_DUMMY != 4 && W25Q_CFG_QPI_DUMMY != 6 && W25Q_CFG_QPI_DUMMY != 8
+#error "W25Q_CFG_QPI_DUMMY must be 2, 4, 6 or 8"
+#endif
+
+/* Lines used by commands without own descriptor, bus stays on 4 lines in QPI mode */
+#define prv_bus_lines(dev)              (((dev)->mode == W25Q_MODE_QPI) ? 4 : 1)
+
+#if W25Q_CFG_WRAP
+/**
+ * \brief           Get wrap length bits for wrap line size
+ * \param[in]       wrap: Line size, member of \ref w25q_wrap_t
+ * \return          `0` to `3` for 8 to 64 bytes
+ */
+static uint8_t
+prv_wrap_bits(uint8_t wrap) {
+    uint8_t bits = 0;
+
+    while (wrap > 8) {
+        wrap >>= 1;
+        ++bits;
+    }
+    return bits;
+}
+#else
+#define prv_wrap_bits(wrap)             0
+#endif /* W25Q_CFG_WRAP */
+
+/* Continuous read state */
+#define W25Q_CONT_OFF                   0       /* No session */
+#define W25Q_CONT_OPEN                  1       /* Session open, next read sends opcode */
+#define W25Q_CONT_ACTIVE                2       /* Chip in continuous read mode */
+#define W25Q_CONT_MODE_BITS             0x20
+
+#if W25Q_CFG_CONT_READ
+
+/**
+ * \brief           Send mode bit reset, chip leaves continuous read mode
+ *
+ * All ones on 4 lines for 16 clocks cover address and mode bits in 3- and
+ * 4-byte address mode. Chip select ends the transaction before data.
+ *
+ * \param[in]       dev: W25Q device handle
+ */
+static void
+prv_cont_reset(w25q_t* dev) {
+    static const uint8_t ones[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+    if (dev->ll.set_lines == NULL) {
+        return;
+    }
+    dev->ll.set_lines(4);
+    dev->ll.select();
+    dev->ll.transmit(ones, sizeof(ones));
+    dev->ll.deselect();
+    dev->ll.set_lines(prv_bus_lines(dev));
+}
+
+/**
+ * \brief           Select chip, leaving continuous read mode first
+ * \param[in]       dev: W25Q device handle
+ */
+static void
+prv_select(w25q_t* dev) {
+    if (dev->cont == W25Q_CONT_ACTIVE) {
+        prv_cont_reset(dev);
+        dev->cont = W25Q_CONT_OPEN;
+    }
+    dev->ll.select();
+}
+
+#else
+#define prv_select(dev)                 ((dev)->ll.select())
+#endif /* W25Q_CFG_CONT_READ */
+
+/* Busy time of command that was not sent */
+#define W25Q_NOT_SENT                   0xFFFFFFFFUL
 
 /* Chip parameters */
 #define W25Q_PAGE_SIZE                  256
@@ -69,35 +163,153 @@
 #define W25Q_BLOCK_SIZE                 65536
 #define W25Q_MANUFACTURER_WINBOND       0xEF
 #define W25Q_TIMEOUT_MS                 5000
+#define W25Q_PROGRAM_POLLS              1000    /* Polls without delay before 1 ms interval */
+
+#if W25Q_CFG_FIXED_TYPE
+/* Geometry and address width are constants, branches on them fold at compile time */
+#define prv_capacity(dev)               ((void)(dev), 1UL << W25Q_CFG_FIXED_TYPE)
+#define prv_addr_4byte(dev)             ((void)(dev), W25Q_CFG_FIXED_TYPE == W25Q256)
+#else
+#define prv_capacity(dev)               ((dev)->info.capacity_bytes)
+#define prv_addr_4byte(dev)             ((dev)->info.type == W25Q256)
+#endif /* W25Q_CFG_FIXED_TYPE */
+
+#if W25Q_CFG_STATS
+
+#define prv_stats_inc(dev, field)       ((dev)->stats.field++)
+
+/**
+ * \brief           Get current time from low-level port
+ * \param[in]       dev: W25Q device handle
+ * \return          Time in microseconds, `0` if port has no time source
+ */
+static uint32_t
+prv_time_us(w25q_t* dev) {
+    return (dev->ll.get_time_us != NULL) ? dev->ll.get_time_us() : 0;
+}
+
+/**
+ * \brief           Mark start of tracked call
+ *
+ * Start time is kept by the caller, the lock is released while waiting for
+ * a program or erase and other calls may start meanwhile.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \return          Start time to pass to \ref prv_stats_record
+ */
+static uint32_t
+prv_stats_begin(w25q_t* dev) {
+    return prv_time_us(dev);
+}
+
+/**
+ * \brief           Update statistics at end of tracked call
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       start: Start time from \ref prv_stats_begin
+ * \param[in]       op: Operation
+ * \param[in]       bytes: Bytes read, programmed or erased
+ * \param[in]       res: Operation result
+ * \param[in]       busy_ms: Time spent waiting for completion
+ */
+static void
+prv_stats_record(w25q_t* dev, uint32_t start, w25q_stats_op_t op, uint32_t bytes, w25q_result_t res,
+                 uint32_t busy_ms) {
+    w25q_op_stats_t* st = &dev->stats.op[op];
+    uint32_t latency, bucket;
+
+    if (res != W25Q_OK) {
+        st->errors++;
+        return;
+    }
+
+    latency = (dev->ll.get_time_us != NULL) ? (prv_time_us(dev) - start) : (busy_ms * 1000UL);
+    st->count++;
+    st->bytes += bytes;
+    st->busy_us += (uint64_t)busy_ms * 1000UL;
+    if (latency > st->latency_max_us) {
+        st->latency_max_us = latency;
+    }
+    for (bucket = 0; bucket < W25Q_CFG_STATS_BUCKETS - 1 && (latency >> (bucket + 1)) != 0; ++bucket) {}
+    st->hist[bucket]++;
+}
+
+#else
+
+#define prv_stats_inc(dev, field)
+#define prv_stats_begin(dev)            0
+#define prv_stats_record(dev, start, op, bytes, res, busy_ms) ((void)(start))
+
+#endif /* W25Q_CFG_STATS */
+
+#if W25Q_CFG_LOCK
+
+/**
+ * \brief           Wait 1 ms with device lock released
+ * \param[in]       dev: W25Q device handle
+ */
+static void
+prv_unlocked_delay(w25q_t* dev) {
+    dev->ll.unlock();
+    dev->ll.delay_ms(1);
+    while (dev->ll.lock() == 0) {}
+}
+
+#else
+#define prv_unlocked_delay(dev)         (dev)->ll.delay_ms(1)
+#endif /* W25Q_CFG_LOCK */
 
 /**
  * \brief           Wait until device is ready (not busy)
  * \param[in]       dev: W25Q device handle
+ * \param[in]       release: Set to `1` to release device lock between polls.
+ *                      Only for own program or erase, see \ref prv_wait_done
+ * \param[out]      elapsed_ms: Pointer to store number of milliseconds spent waiting.
+ *                      Can be set to `NULL` if not used
  * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
  */
 static w25q_result_t
-prv_wait_ready(w25q_t* dev) {
+prv_wait(w25q_t* dev, uint8_t release, uint32_t* elapsed_ms) {
     uint8_t status;
     uint32_t timeout;
 
     timeout = W25Q_TIMEOUT_MS;
     do {
-        dev->ll.select();
+        prv_select(dev);
         dev->ll.transmit((const uint8_t[]){W25Q_CMD_READ_STATUS_REG1}, 1);
         dev->ll.receive(&status, 1);
         dev->ll.deselect();
+        prv_stats_inc(dev, status_polls);
 
         if ((status & W25Q_STATUS_BUSY) == 0) {
+            if (elapsed_ms != NULL) {
+                *elapsed_ms = W25Q_TIMEOUT_MS - timeout;
+            }
             return W25Q_OK;
         }
 
-        dev->ll.delay_ms(1);
+        if (release) {
+            prv_unlocked_delay(dev);
+#if W25Q_CFG_LOCK
+            /* Erase made progress since last resume */
+            if (dev->resume_guard > 0) {
+                dev->resume_guard--;
+            }
+#endif /* W25Q_CFG_LOCK */
+        } else {
+            dev->ll.delay_ms(1);
+        }
         timeout--;
     } while (timeout > 0);
 
+    prv_stats_inc(dev, wait_timeouts);
+    if (elapsed_ms != NULL) {
+        *elapsed_ms = W25Q_TIMEOUT_MS;
+    }
     return W25Q_ERR_TIMEOUT;
 }
 
+#define prv_wait_ready(dev, elapsed_ms) prv_wait((dev), 0, (elapsed_ms))
+
 /**
  * \brief           Enable write operations
  * \param[in]       dev: W25Q device handle
@@ -107,177 +319,805 @@ static w25q_result_t
 prv_write_enable(w25q_t* dev) {
     uint8_t status;
 
-    dev->ll.select();
+    prv_select(dev);
     dev->ll.transmit((const uint8_t[]){W25Q_CMD_WRITE_ENABLE}, 1);
     dev->ll.deselect();
 
     /* Verify WEL bit is set */
-    dev->ll.select();
+    prv_select(dev);
     dev->ll.transmit((const uint8_t[]){W25Q_CMD_READ_STATUS_REG1}, 1);
     dev->ll.receive(&status, 1);
     dev->ll.deselect();
 
     if ((status & W25Q_STATUS_WEL) == 0) {
+        prv_stats_inc(dev, wel_failures);
         return W25Q_ERR;
     }
 
     return W25Q_OK;
 }
 
+#if W25Q_CFG_HEALTH
+
 /**
- * \brief           Get chip capacity based on device ID
- * \param[in]       device_id: Device ID from chip (capacity byte from JEDEC ID)
- * \return          Capacity in bytes, `0` if unknown
+ * \brief           Mark start of page program completion wait
+ *
+ * Page program takes well under a millisecond, only the port timer can
+ * resolve it.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       program: `1` if waiting for page program, `0` otherwise
  */
-static uint32_t
-prv_get_capacity(uint8_t device_id) {
-    switch (device_id) {
-        case W25Q10:  return 131072UL;      /* 128KB */
-        case W25Q20:  return 262144UL;      /* 256KB */
-        case W25Q40:  return 524288UL;      /* 512KB */
-        case W25Q80:  return 1048576UL;     /* 1MB */
-        case W25Q16:  return 2097152UL;     /* 2MB */
-        case W25Q32:  return 4194304UL;     /* 4MB */
-        case W25Q64:  return 8388608UL;     /* 8MB */
-        case W25Q128: return 16777216UL;    /* 16MB */
-        case W25Q256: return 33554432UL;    /* 32MB */
-        default:      return 0;
+static void
+prv_health_mark(w25q_t* dev, uint8_t program) {
+    if (program && dev->ll.get_time_us != NULL) {
+        dev->health_program_start = dev->ll.get_time_us();
     }
 }
 
 /**
- * \brief           Initialize W25Q device
+ * \brief           Update health table after program or erase
  * \param[in]       dev: W25Q device handle
- * \param[in]       ll_funcs: Low-level function pointers for SPI communication
- * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ * \param[in]       address: Operation address
+ * \param[in]       size: Erase size in bytes, `0` for page program
+ * \param[in]       res: Operation result
+ * \param[in]       ms: Time spent waiting for completion
  */
-w25q_result_t
-w25q_init(w25q_t* dev, const w25q_ll_t* ll_funcs) {
-    if (dev == NULL || ll_funcs == NULL) {
-        return W25Q_ERR_PARAM;
+static void
+prv_health_record(w25q_t* dev, uint32_t address, uint32_t size, w25q_result_t res, uint32_t ms) {
+    w25q_sector_health_t* entry;
+    uint32_t sector, last, program_time;
+
+    if (dev->health == NULL) {
+        return;
     }
 
-    /* Copy low-level functions */
-    dev->ll = *ll_funcs;
+    /* Program time in 100 us units */
+    if (dev->ll.get_time_us != NULL) {
+        program_time = (dev->ll.get_time_us() - dev->health_program_start + 99) / 100;
+    } else {
+        program_time = ms * 10;
+    }
 
-    /* Initialize SPI */
-    if (dev->ll.init != NULL) {
-        if (dev->ll.init() == 0) {
-            return W25Q_ERR;
+    sector = address / W25Q_SECTOR_SIZE;
+    last = (size > W25Q_SECTOR_SIZE) ? (sector + size / W25Q_SECTOR_SIZE - 1) : sector;
+    for (; sector <= last; ++sector) {
+        if (sector < dev->health_first || sector - dev->health_first >= dev->health_count) {
+            continue;
+        }
+        entry = &dev->health[sector - dev->health_first];
+
+        if (size == 0) {
+            if (res != W25Q_OK) {
+                if (entry->program_fail < 0xFF) {
+                    entry->program_fail++;
+                }
+                entry->flags |= W25Q_HEALTH_PROGRAM_FAIL;
+            } else if (program_time > entry->program_time_max) {
+                entry->program_time_max = (program_time > 0xFF) ? 0xFF : (uint8_t)program_time;
+            }
+        } else if (res != W25Q_OK) {
+            if (entry->erase_fail < 0xFF) {
+                entry->erase_fail++;
+            }
+            entry->flags |= W25Q_HEALTH_ERASE_FAIL;
+        } else if (size == W25Q_SECTOR_SIZE) {
+            /* Only sector erases are timed, block erase times are not comparable */
+            entry->erase_time = (ms > 0xFFFF) ? 0xFFFF : (uint16_t)ms;
+            if (entry->erase_time > entry->erase_time_max) {
+                entry->erase_time_max = entry->erase_time;
+            }
+            if (entry->erase_time > dev->health_erase_limit) {
+                entry->flags |= W25Q_HEALTH_SLOW_ERASE;
+            }
         }
     }
+}
 
-    /* Deselect chip */
+#else
+
+#define prv_health_mark(dev, program)
+#define prv_health_record(dev, address, size, res, ms)
+
+#endif /* W25Q_CFG_HEALTH */
+
+/**
+ * \brief           Send command without address and data
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       opcode: Command opcode
+ */
+static void
+prv_simple_cmd(w25q_t* dev, uint8_t opcode) {
+    prv_select(dev);
+    dev->ll.transmit(&opcode, 1);
     dev->ll.deselect();
+}
 
-    /* Wake up chip if it was in power-down mode */
-    w25q_wake_up(dev);
+/**
+ * \brief           Leave QPI mode, bus is on single line afterwards
+ *
+ * Harmless if chip is in SPI mode, it sees only two clocks with chip select.
+ *
+ * \param[in]       dev: W25Q device handle
+ */
+static void
+prv_qpi_exit(w25q_t* dev) {
+    if (dev->ll.set_lines == NULL) {
+        return;
+    }
+    dev->ll.set_lines(4);
+    prv_simple_cmd(dev, W25Q_CMD_EXIT_QPI);
+    dev->ll.set_lines(1);
+}
 
-    /* Detect chip type and configure */
-    if (w25q_detect(dev) != W25Q_OK) {
+/**
+ * \brief           Set QPI read parameters
+ * \param[in]       dev: W25Q device handle in QPI mode
+ */
+static void
+prv_qpi_params(w25q_t* dev) {
+    /* P5-P4 select dummy clocks, P1-P0 wrap length of burst read with wrap */
+    uint8_t param[2] = {W25Q_CMD_SET_READ_PARAMS,
+                        (uint8_t)((((W25Q_CFG_QPI_DUMMY / 2) - 1) << 4) | prv_wrap_bits(dev->wrap))};
+
+    prv_select(dev);
+    dev->ll.transmit(param, sizeof(param));
+    dev->ll.deselect();
+}
+
+/**
+ * \brief           Enter QPI mode and set read parameters, bus is on 4 lines afterwards
+ * \param[in]       dev: W25Q device handle with bus on single line
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_qpi_enter(w25q_t* dev) {
+    prv_simple_cmd(dev, W25Q_CMD_ENTER_QPI);
+    if (!dev->ll.set_lines(4)) {
         return W25Q_ERR;
     }
-
-    dev->initialized = 1;
+    prv_qpi_params(dev);
     return W25Q_OK;
 }
 
 /**
- * \brief           Deinitialize W25Q device
+ * \brief           Command descriptor, one per flash command
+ */
+typedef struct {
+    uint8_t opcode;                             /*!< Command opcode */
+    uint8_t addr_bytes;                         /*!< `0` no address, `3` device address width, `4` always 4 bytes */
+    uint8_t dummy_cycles;                       /*!< Clocks between address and data, including mode bits */
+    uint8_t cmd_lines;                          /*!< Lines for opcode phase */
+    uint8_t addr_lines;                         /*!< Lines for address and dummy phase */
+    uint8_t data_lines;                         /*!< Lines for data phase */
+    uint8_t busy;                               /*!< Busy class, member of \ref w25q_busy_t */
+    uint8_t flags;                              /*!< Combination of `W25Q_CMD_FLAG_*` */
+} w25q_cmd_t;
+
+#define W25Q_CMD_FLAG_NO_OPCODE         0x01    /*!< Chip is in continuous read mode, skip opcode and ready wait */
+#define W25Q_CMD_FLAG_CONT              0x02    /*!< Send mode bits keeping chip in continuous read mode */
+#define W25Q_CMD_FLAG_READY             0x04    /*!< Chip known to be ready, skip ready wait */
+#define W25Q_CMD_FLAG_NO_WAIT           0x08    /*!< Caller waits for program or erase completion */
+
+/**
+ * \brief           Busy class of command
+ */
+typedef enum {
+    W25Q_BUSY_NONE = 0,                         /*!< Completes with chip select release */
+    W25Q_BUSY_PROGRAM,                          /*!< Needs write enable, busy for page program time */
+    W25Q_BUSY_ERASE,                            /*!< Needs write enable, busy for erase time */
+} w25q_busy_t;
+
+/* Access class of public call */
+#define W25Q_ACCESS_READ                0       /* Served ahead of queued writers, may suspend erase */
+#define W25Q_ACCESS_WRITE               1       /* Queued in arrival order, runs alone until done */
+#define W25Q_ACCESS_STATUS              2       /* Lock only */
+
+#if W25Q_CFG_LOCK
+
+/**
+ * \brief           Wait for completion of own program or erase
+ *
+ * With a lock, it is released between status polls so that other tasks can
+ * read meanwhile. Queued writers keep waiting until the call ends.
+ *
  * \param[in]       dev: W25Q device handle
+ * \param[in]       busy: Busy class of operation, member of \ref w25q_busy_t
+ * \param[out]      elapsed_ms: Time spent waiting. Can be `NULL`
  * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
  */
-w25q_result_t
-w25q_deinit(w25q_t* dev) {
-    if (dev == NULL || dev->initialized == 0) {
-        return W25Q_ERR_PARAM;
-    }
+static w25q_result_t
+prv_wait_done(w25q_t* dev, uint8_t busy, uint32_t* elapsed_ms) {
+    w25q_result_t res;
 
-    /* Exit 4-byte mode if W25Q256 */
-    if (dev->info.type == W25Q256) {
-        dev->ll.select();
-        dev->ll.transmit((const uint8_t[]){W25Q_CMD_EXIT_4BYTE_MODE}, 1);
-        dev->ll.deselect();
+    if (dev->ll.lock == NULL) {
+        return prv_wait_ready(dev, elapsed_ms);
     }
-
-    dev->initialized = 0;
-    return W25Q_OK;
+    dev->op_busy = busy;
+    res = prv_wait(dev, 1, elapsed_ms);
+    dev->op_busy = W25Q_BUSY_NONE;
+    return res;
 }
 
+#if W25Q_CFG_ERASE_SUSPEND
+
 /**
- * \brief           Read manufacturer and device ID using JEDEC ID command
+ * \brief           Suspend erase of lock owner waiting for completion
+ *
+ * Not done for chip erase, reads overlapping the erased range, or before the
+ * owner polled twice since the last resume, so that the erase keeps making
+ * progress under frequent reads.
+ *
  * \param[in]       dev: W25Q device handle
- * \param[out]      manufacturer_id: Pointer to store manufacturer ID
- * \param[out]      device_id: Pointer to store device ID (capacity)
- * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ * \param[in]       address: Start of range to read
+ * \param[in]       len: Length of range to read, `0` if no array data is read
+ * \return          `1` if chip accepts commands now, `0` otherwise
  */
-w25q_result_t
-w25q_read_id(w25q_t* dev, uint8_t* manufacturer_id, uint8_t* device_id) {
-    uint8_t jedec_id[3];
+static uint8_t
+prv_suspend(w25q_t* dev, uint32_t address, uint32_t len) {
+    uint8_t status;
 
-    if (dev == NULL || manufacturer_id == NULL || device_id == NULL) {
-        return W25Q_ERR_PARAM;
+    if (dev->op_busy != W25Q_BUSY_ERASE || dev->op_size == 0 || dev->resume_guard > 0
+        || (len > 0 && address < dev->op_addr + dev->op_size && dev->op_addr < address + len)) {
+        return 0;
     }
 
-    /* Use JEDEC ID command (0x9F) to read correct capacity ID */
-    dev->ll.select();
-    dev->ll.transmit((const uint8_t[]){W25Q_CMD_JEDEC_ID}, 1);
-    dev->ll.receive(jedec_id, 3);
+    /* Suspend takes tSUS = 20us, erase may also have finished meanwhile */
+    prv_simple_cmd(dev, W25Q_CMD_ERASE_SUSPEND);
+    if (prv_wait_ready(dev, NULL) != W25Q_OK) {
+        return 0;
+    }
+    prv_select(dev);
+    dev->ll.transmit((const uint8_t[]){W25Q_CMD_READ_STATUS_REG2}, 1);
+    dev->ll.receive(&status, 1);
     dev->ll.deselect();
+    dev->suspended = (status & W25Q_STATUS2_SUS) ? 1 : 0;
+    return 1;
+}
 
-    *manufacturer_id = jedec_id[0];  /* 0xEF for Winbond */
-    *device_id = jedec_id[2];        /* Capacity ID: 0x15 for W25Q16 */
+#else
+#define prv_suspend(dev, address, len)  ((void)(address), (void)(len), 0)
+#endif /* W25Q_CFG_ERASE_SUSPEND */
+
+/**
+ * \brief           Take device lock for a public call
+ *
+ * While the lock owner waits for its program or erase, a reader runs after
+ * suspending a block or sector erase outside its range, otherwise when the
+ * chip is done. Writers run in ticket order, only when no reader waits.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       access: Access class, `W25Q_ACCESS_*`
+ * \param[in]       address: Start of range to read
+ * \param[in]       len: Length of range to read, `0` if no array data is read
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR_BUSY if lock was not taken
+ */
+static w25q_result_t
+prv_lock(w25q_t* dev, uint8_t access, uint32_t address, uint32_t len) {
+    uint8_t status, ticket, waiting = 0;
+
+    if (dev->ll.lock == NULL) {
+        return W25Q_OK;
+    }
+    if (dev->ll.lock() == 0) {
+        return W25Q_ERR_BUSY;
+    }
 
+    if (access == W25Q_ACCESS_WRITE) {
+        ticket = dev->ticket_next++;
+        while (ticket != dev->ticket_serving || dev->readers > 0) {
+            prv_unlocked_delay(dev);
+        }
+    } else if (access == W25Q_ACCESS_READ) {
+        while (dev->op_busy != W25Q_BUSY_NONE && !prv_suspend(dev, address, len)) {
+            prv_select(dev);
+            dev->ll.transmit((const uint8_t[]){W25Q_CMD_READ_STATUS_REG1}, 1);
+            dev->ll.receive(&status, 1);
+            dev->ll.deselect();
+            if ((status & W25Q_STATUS_BUSY) == 0) {
+                /* Done, owner notices on its next poll */
+                break;
+            }
+            if (!waiting) {
+                waiting = 1;
+                dev->readers++;
+            }
+            prv_unlocked_delay(dev);
+        }
+        if (waiting) {
+            dev->readers--;
+        }
+    }
     return W25Q_OK;
 }
 
 /**
- * \brief           Auto-detect chip type and configure device info
+ * \brief           Release device lock taken with \ref prv_lock
  * \param[in]       dev: W25Q device handle
- * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ * \param[in]       access: Access class passed to \ref prv_lock
  */
-w25q_result_t
-w25q_detect(w25q_t* dev) {
-    uint8_t manufacturer_id, device_id;
-    uint32_t capacity;
-
-    if (dev == NULL) {
-        return W25Q_ERR_PARAM;
+static void
+prv_unlock(w25q_t* dev, uint8_t access) {
+    if (dev->ll.lock == NULL) {
+        return;
+    }
+#if W25Q_CFG_ERASE_SUSPEND
+    if (dev->suspended) {
+        prv_simple_cmd(dev, W25Q_CMD_ERASE_RESUME);
+        dev->suspended = 0;
+        dev->resume_guard = 2;
+    }
+#endif /* W25Q_CFG_ERASE_SUSPEND */
+    if (access == W25Q_ACCESS_WRITE) {
+        dev->ticket_serving++;
     }
+    dev->ll.unlock();
+}
 
-    /* Read chip ID */
-    if (w25q_read_id(dev, &manufacturer_id, &device_id) != W25Q_OK) {
-        return W25Q_ERR;
+#else
+#define prv_wait_done(dev, busy, elapsed_ms) prv_wait_ready((dev), (elapsed_ms))
+#define prv_lock(dev, access, address, len) W25Q_OK
+#define prv_unlock(dev, access)
+#endif /* W25Q_CFG_LOCK */
+
+/* Read and program commands per protocol mode, indexed by \ref w25q_mode_t */
+static const w25q_cmd_t cmd_read[W25Q_MODE_COUNT] = {
+    [W25Q_MODE_SINGLE] = {W25Q_CMD_READ_DATA, 3, 0, 1, 1, 1, W25Q_BUSY_NONE, 0},
+    [W25Q_MODE_FAST] = {W25Q_CMD_FAST_READ, 3, 8, 1, 1, 1, W25Q_BUSY_NONE, 0},
+    [W25Q_MODE_DUAL_OUT] = {W25Q_CMD_FAST_READ_DUAL_OUT, 3, 8, 1, 1, 2, W25Q_BUSY_NONE, 0},
+    [W25Q_MODE_QUAD_OUT] = {W25Q_CMD_FAST_READ_QUAD_OUT, 3, 8, 1, 1, 4, W25Q_BUSY_NONE, 0},
+    [W25Q_MODE_QUAD_IO] = {W25Q_CMD_FAST_READ_QUAD_IO, 3, 6, 1, 4, 4, W25Q_BUSY_NONE, 0},
+    [W25Q_MODE_QPI] = {W25Q_CMD_FAST_READ, 3, W25Q_CFG_QPI_DUMMY, 4, 4, 4, W25Q_BUSY_NONE, 0},
+};
+static const w25q_cmd_t cmd_program[W25Q_MODE_COUNT] = {
+    [W25Q_MODE_SINGLE] = {W25Q_CMD_PAGE_PROGRAM, 3, 0, 1, 1, 1, W25Q_BUSY_PROGRAM, 0},
+    [W25Q_MODE_FAST] = {W25Q_CMD_PAGE_PROGRAM, 3, 0, 1, 1, 1, W25Q_BUSY_PROGRAM, 0},
+    [W25Q_MODE_DUAL_OUT] = {W25Q_CMD_PAGE_PROGRAM, 3, 0, 1, 1, 1, W25Q_BUSY_PROGRAM, 0},
+    [W25Q_MODE_QUAD_OUT] = {W25Q_CMD_QUAD_PAGE_PROGRAM, 3, 0, 1, 1, 4, W25Q_BUSY_PROGRAM, 0},
+    [W25Q_MODE_QUAD_IO] = {W25Q_CMD_QUAD_PAGE_PROGRAM, 3, 0, 1, 1, 4, W25Q_BUSY_PROGRAM, 0},
+    [W25Q_MODE_QPI] = {W25Q_CMD_PAGE_PROGRAM, 3, 0, 4, 4, 4, W25Q_BUSY_PROGRAM, 0},
+};
+#if W25Q_CFG_CONT_READ
+static const w25q_cmd_t cmd_read_cont_enter = {W25Q_CMD_FAST_READ_QUAD_IO, 3, 6, 1, 4, 4, W25Q_BUSY_NONE,
+                                               W25Q_CMD_FLAG_CONT};
+static const w25q_cmd_t cmd_read_cont = {W25Q_CMD_FAST_READ_QUAD_IO, 3, 6, 1, 4, 4, W25Q_BUSY_NONE,
+                                         W25Q_CMD_FLAG_CONT | W25Q_CMD_FLAG_NO_OPCODE};
+#endif /* W25Q_CFG_CONT_READ */
+#if W25Q_CFG_WRAP
+/* Wrap bits follow 6 dummy clocks on 4 lines */
+static const w25q_cmd_t cmd_set_wrap = {W25Q_CMD_SET_BURST_WRAP, 0, 6, 1, 4, 4, W25Q_BUSY_NONE, 0};
+static const w25q_cmd_t cmd_read_wrap_qpi = {W25Q_CMD_BURST_READ_WRAP_QPI, 3, W25Q_CFG_QPI_DUMMY, 4, 4, 4,
+                                             W25Q_BUSY_NONE, 0};
+#endif /* W25Q_CFG_WRAP */
+static const w25q_cmd_t cmd_erase_4k = {W25Q_CMD_SECTOR_ERASE_4K, 3, 0, 1, 1, 1, W25Q_BUSY_ERASE, 0};
+static const w25q_cmd_t cmd_erase_32k = {W25Q_CMD_BLOCK_ERASE_32K, 3, 0, 1, 1, 1, W25Q_BUSY_ERASE, 0};
+static const w25q_cmd_t cmd_erase_64k = {W25Q_CMD_BLOCK_ERASE_64K, 3, 0, 1, 1, 1, W25Q_BUSY_ERASE, 0};
+
+/**
+ * \brief           Switch bus lines if needed
+ * \param[in]       dev: W25Q device handle
+ * \param[in,out]   cur: Current number of lines
+ * \param[in]       lines: Required number of lines, raised to 4 in QPI mode
+ * \return          `1` on success, `0` otherwise
+ */
+static uint8_t
+prv_set_lines(w25q_t* dev, uint8_t* cur, uint8_t lines) {
+    if (lines < prv_bus_lines(dev)) {
+        lines = prv_bus_lines(dev);
     }
+    if (*cur == lines) {
+        return 1;
+    }
+    if (dev->ll.set_lines == NULL || !dev->ll.set_lines(lines)) {
+        return 0;
+    }
+    *cur = lines;
+    return 1;
+}
 
-    /* Verify manufacturer */
-    if (manufacturer_id != W25Q_MANUFACTURER_WINBOND) {
-        dev->info.type = W25Q_UNKNOWN;
-        return W25Q_ERR;
+/**
+ * \brief           Start command described by descriptor
+ *
+ * Waits for ready, enables write for program and erase commands, selects
+ * chip and sends opcode, address and dummy phases. Bus is left on data lines
+ * with chip selected, \ref prv_cmd_end must follow.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       cmd: Command descriptor
+ * \param[in]       address: Address, ignored for commands without address
+ * \param[out]      lines: Current number of bus lines, for \ref prv_cmd_end
+ * \param[out]      ok: Set to `1` if header was sent, `0` if a transfer failed
+ * \return          \ref W25Q_OK if chip is selected, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_cmd_begin(w25q_t* dev, const w25q_cmd_t* cmd, uint32_t address, uint8_t* lines, uint8_t* ok) {
+    uint8_t hdr[1 + 4 + 4];
+    uint8_t n = 0, alen;
+
+    *lines = prv_bus_lines(dev);
+
+    /* Wait until device is ready, chip in continuous read mode is always ready */
+    if ((cmd->flags & (W25Q_CMD_FLAG_NO_OPCODE | W25Q_CMD_FLAG_READY)) == 0 && prv_wait_ready(dev, NULL) != W25Q_OK) {
+        return W25Q_ERR_TIMEOUT;
     }
 
-    /* Get capacity */
-    capacity = prv_get_capacity(device_id);
-    if (capacity == 0) {
-        dev->info.type = W25Q_UNKNOWN;
+    /* Enable write */
+    if (cmd->busy != W25Q_BUSY_NONE && prv_write_enable(dev) != W25Q_OK) {
         return W25Q_ERR;
     }
 
-    /* Configure device info */
-    dev->info.type = (w25q_type_t)device_id;
-    dev->info.manufacturer_id = manufacturer_id;
-    dev->info.device_id = device_id;
-    dev->info.capacity_bytes = capacity;
-    dev->info.page_size = W25Q_PAGE_SIZE;
-    dev->info.sector_size = W25Q_SECTOR_SIZE;
-    dev->info.block_size = W25Q_BLOCK_SIZE;
-    dev->info.page_count = capacity / W25Q_PAGE_SIZE;
-    dev->info.sector_count = capacity / W25Q_SECTOR_SIZE;
-    dev->info.block_count = capacity / W25Q_BLOCK_SIZE;
+    /* Opcode shares one transfer with address when both use the same lines */
+    hdr[n++] = cmd->opcode;
+    if (cmd->cmd_lines != cmd->addr_lines || (cmd->flags & W25Q_CMD_FLAG_NO_OPCODE)) {
+        n = 0;
+    }
+    alen = (cmd->addr_bytes == 0) ? 0 : ((cmd->addr_bytes == 4 || prv_addr_4byte(dev)) ? 4 : 3);
+    for (; alen > 0; --alen) {
+        hdr[n++] = (uint8_t)(address >> (8 * (alen - 1)));
+    }
+    for (alen = (uint8_t)(cmd->dummy_cycles * cmd->addr_lines / 8); alen > 0; --alen) {
+        hdr[n++] = 0xFF;
+    }
+    if (cmd->flags & W25Q_CMD_FLAG_CONT) {
+        /* First dummy clocks carry M7-0, M5-4 = 10 keeps continuous read mode */
+        hdr[n - (uint8_t)(cmd->dummy_cycles * cmd->addr_lines / 8)] = W25Q_CONT_MODE_BITS;
+    }
 
-    /* W25Q256 requires 4-byte address mode for full capacity access */
-    if (device_id == W25Q256) {
+    if (cmd->flags & W25Q_CMD_FLAG_NO_OPCODE) {
         dev->ll.select();
+        *ok = prv_set_lines(dev, lines, cmd->addr_lines);
+    } else {
+        prv_select(dev);
+        *ok = prv_set_lines(dev, lines, cmd->cmd_lines);
+    }
+    if (*ok && cmd->cmd_lines != cmd->addr_lines && (cmd->flags & W25Q_CMD_FLAG_NO_OPCODE) == 0) {
+        *ok = dev->ll.transmit(&cmd->opcode, 1) && prv_set_lines(dev, lines, cmd->addr_lines);
+    }
+    if (*ok && n > 0) {
+        *ok = dev->ll.transmit(hdr, n);
+    }
+    *ok = *ok && prv_set_lines(dev, lines, cmd->data_lines);
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Finish command started with \ref prv_cmd_begin
+ *
+ * Deselects chip and waits for completion of commands that set busy. A
+ * failing transfer of a multi-line command switches the device back to
+ * \ref W25Q_MODE_SINGLE.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       cmd: Command descriptor
+ * \param[in]       lines: Current number of bus lines
+ * \param[in]       ok: `1` if all transfers succeeded, `0` otherwise
+ * \param[out]      busy_ms: Time spent waiting for completion. Can be `NULL`
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_cmd_end(w25q_t* dev, const w25q_cmd_t* cmd, uint8_t lines, uint8_t ok, uint32_t* busy_ms) {
+    dev->ll.deselect();
+    if (lines != prv_bus_lines(dev)) {
+        dev->ll.set_lines(prv_bus_lines(dev));
+    }
+
+    if (busy_ms != NULL) {
+        *busy_ms = 0;
+    }
+    if (!ok) {
+        if (dev->mode == W25Q_MODE_QPI) {
+            prv_qpi_exit(dev);
+            dev->mode = W25Q_MODE_SINGLE;
+        } else if (cmd->cmd_lines != 1 || cmd->addr_lines != 1 || cmd->data_lines != 1) {
+            dev->mode = W25Q_MODE_SINGLE;
+        }
+        return W25Q_ERR;
+    }
+
+    /* Wait for program or erase completion */
+    if (cmd->busy != W25Q_BUSY_NONE && (cmd->flags & W25Q_CMD_FLAG_NO_WAIT) == 0) {
+        prv_health_mark(dev, cmd->busy == W25Q_BUSY_PROGRAM);
+        return prv_wait_done(dev, cmd->busy, busy_ms);
+    }
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Execute command described by descriptor
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       cmd: Command descriptor
+ * \param[in]       address: Address, ignored for commands without address
+ * \param[in]       tx: Data to transmit, `NULL` to receive
+ * \param[out]      rx: Buffer for received data, `NULL` to transmit
+ * \param[in]       len: Number of data bytes, can be `0`
+ * \param[out]      busy_ms: Time spent waiting for completion, left unchanged if command
+ *                      was not sent. Can be `NULL`
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_command(w25q_t* dev, const w25q_cmd_t* cmd, uint32_t address, const uint8_t* tx, uint8_t* rx, uint32_t len,
+            uint32_t* busy_ms) {
+    w25q_result_t res;
+    uint8_t lines, ok;
+
+    res = prv_cmd_begin(dev, cmd, address, &lines, &ok);
+    if (res != W25Q_OK) {
+        return res;
+    }
+    if (ok && len > 0) {
+        ok = (tx != NULL) ? dev->ll.transmit(tx, len) : dev->ll.receive(rx, len);
+    }
+    return prv_cmd_end(dev, cmd, lines, ok, busy_ms);
+}
+
+#if W25Q_CFG_WRAP
+
+/**
+ * \brief           Program wrap setting of quad I/O read into chip
+ *
+ * Only \ref W25Q_MODE_QUAD_IO reads are affected, other SPI modes leave the
+ * chip as is until the mode is selected. QPI mode carries the wrap length in
+ * read parameters.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_wrap_sync(w25q_t* dev) {
+    uint8_t w;
+
+    if (dev->mode == W25Q_MODE_QPI) {
+        if (prv_wait_ready(dev, NULL) != W25Q_OK) {
+            return W25Q_ERR_TIMEOUT;
+        }
+        prv_qpi_params(dev);
+        return W25Q_OK;
+    }
+    if (dev->mode != W25Q_MODE_QUAD_IO) {
+        return W25Q_OK;
+    }
+
+    /* W6-W5 wrap length, W4 set disables wrap */
+    w = (dev->wrap == W25Q_WRAP_NONE) ? 0x10 : (uint8_t)(prv_wrap_bits(dev->wrap) << 5);
+    return prv_command(dev, &cmd_set_wrap, 0, &w, NULL, 1, NULL);
+}
+
+/* Quad I/O reads wrap while wrap is set, plain reads use quad output instead */
+#define prv_read_cmd(dev, mode)                                                                                        \
+    (((mode) == W25Q_MODE_QUAD_IO && (dev)->wrap != W25Q_WRAP_NONE) ? &cmd_read[W25Q_MODE_QUAD_OUT] : &cmd_read[mode])
+
+#else
+#define prv_wrap_sync(dev)              W25Q_OK
+#define prv_read_cmd(dev, mode)         (&cmd_read[mode])
+#endif /* W25Q_CFG_WRAP */
+
+/**
+ * \brief           Bring chip into state tracked in handle after reset or power loss
+ * \param[in]       dev: W25Q device handle, bus on single line
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_restore_state(w25q_t* dev) {
+    /* W25Q256 requires 4-byte address mode for full capacity access */
+    if (prv_addr_4byte(dev)) {
+        prv_simple_cmd(dev, W25Q_CMD_ENTER_4BYTE_MODE);
+    }
+    if (dev->mode == W25Q_MODE_QPI) {
+        return prv_qpi_enter(dev);
+    }
+    return prv_wrap_sync(dev);
+}
+
+#if !W25Q_CFG_FIXED_TYPE
+/**
+ * \brief           Get chip capacity based on device ID
+ * \param[in]       device_id: Device ID from chip (capacity byte from JEDEC ID)
+ * \return          Capacity in bytes, `0` if unknown
+ */
+static uint32_t
+prv_get_capacity(uint8_t device_id) {
+    switch (device_id) {
+        case W25Q10:  return 131072UL;      /* 128KB */
+        case W25Q20:  return 262144UL;      /* 256KB */
+        case W25Q40:  return 524288UL;      /* 512KB */
+        case W25Q80:  return 1048576UL;     /* 1MB */
+        case W25Q16:  return 2097152UL;     /* 2MB */
+        case W25Q32:  return 4194304UL;     /* 4MB */
+        case W25Q64:  return 8388608UL;     /* 8MB */
+        case W25Q128: return 16777216UL;    /* 16MB */
+        case W25Q256: return 33554432UL;    /* 32MB */
+        default:      return 0;
+    }
+}
+#endif /* !W25Q_CFG_FIXED_TYPE */
+
+/**
+ * \brief           Initialize W25Q device
+ *
+ * Unlike other calls, initialization, \ref w25q_detect and \ref w25q_deinit
+ * are not protected by the `lock` hook as a whole. Only the wake-up and ID
+ * reads take it, so the hooks must already work; handle reset and mode exit
+ * run unlocked. Run them while no other task uses the device.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       ll_funcs: Low-level function pointers for SPI communication
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_init(w25q_t* dev, const w25q_ll_t* ll_funcs) {
+    if (dev == NULL || ll_funcs == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+
+    /* Copy low-level functions */
+    dev->ll = *ll_funcs;
+    dev->mode = W25Q_MODE_SINGLE;
+    dev->cont = W25Q_CONT_OFF;
+    dev->wrap = W25Q_WRAP_NONE;
+    dev->initialized = 0;
+#if W25Q_CFG_LOCK
+    dev->op_busy = W25Q_BUSY_NONE;
+    dev->suspended = 0;
+    dev->resume_guard = 0;
+    dev->readers = 0;
+    dev->ticket_next = 0;
+    dev->ticket_serving = 0;
+#endif /* W25Q_CFG_LOCK */
+#if W25Q_CFG_HEALTH
+    dev->health = NULL;
+    dev->health_count = 0;
+#endif /* W25Q_CFG_HEALTH */
+#if W25Q_CFG_STATS
+    memset(&dev->stats, 0, sizeof(dev->stats));
+#endif /* W25Q_CFG_STATS */
+
+    /* Initialize SPI */
+    if (dev->ll.init != NULL) {
+        if (dev->ll.init() == 0) {
+            return W25Q_ERR;
+        }
+    }
+
+    /* Deselect chip */
+    dev->ll.deselect();
+
+    /* Chip may still be in QPI mode from before MCU reset, wake and leave it on 4 lines */
+    if (dev->ll.set_lines != NULL) {
+#if W25Q_CFG_CONT_READ
+        /* Leave continuous read mode first, chip would take next opcode as address */
+        prv_cont_reset(dev);
+#endif /* W25Q_CFG_CONT_READ */
+        dev->ll.set_lines(4);
+        prv_simple_cmd(dev, W25Q_CMD_RELEASE_POWER_DOWN);
+        dev->ll.delay_ms(1);
+        prv_qpi_exit(dev);
+    }
+
+    /* Wake up chip if it was in power-down mode */
+    w25q_wake_up(dev);
+
+    /* Detect chip type and configure */
+    if (w25q_detect(dev) != W25Q_OK) {
+        return W25Q_ERR;
+    }
+
+    dev->initialized = 1;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Deinitialize W25Q device
+ * \param[in]       dev: W25Q device handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_deinit(w25q_t* dev) {
+    if (dev == NULL || dev->initialized == 0) {
+        return W25Q_ERR_PARAM;
+    }
+
+#if W25Q_CFG_CONT_READ
+    w25q_cont_end(dev);
+#endif /* W25Q_CFG_CONT_READ */
+    if (dev->mode == W25Q_MODE_QPI) {
+        prv_qpi_exit(dev);
+    }
+    dev->mode = W25Q_MODE_SINGLE;
+
+    /* Exit 4-byte mode if W25Q256 */
+    if (prv_addr_4byte(dev)) {
+        prv_select(dev);
+        dev->ll.transmit((const uint8_t[]){W25Q_CMD_EXIT_4BYTE_MODE}, 1);
+        dev->ll.deselect();
+    }
+
+    dev->initialized = 0;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Read manufacturer and device ID using JEDEC ID command
+ * \param[in]       dev: W25Q device handle
+ * \param[out]      manufacturer_id: Pointer to store manufacturer ID
+ * \param[out]      device_id: Pointer to store device ID (capacity)
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_read_id(w25q_t* dev, uint8_t* manufacturer_id, uint8_t* device_id) {
+    uint8_t jedec_id[3];
+    w25q_result_t res;
+
+    if (dev == NULL || manufacturer_id == NULL || device_id == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+    if ((res = prv_lock(dev, W25Q_ACCESS_READ, 0, 0)) != W25Q_OK) {
+        return res;
+    }
+
+    /* Use JEDEC ID command (0x9F, 0xAF in QPI mode) to read correct capacity ID */
+    prv_select(dev);
+    dev->ll.transmit((const uint8_t[]){dev->mode == W25Q_MODE_QPI ? W25Q_CMD_JEDEC_ID_QPI : W25Q_CMD_JEDEC_ID}, 1);
+    dev->ll.receive(jedec_id, 3);
+    dev->ll.deselect();
+    prv_unlock(dev, W25Q_ACCESS_READ);
+
+    *manufacturer_id = jedec_id[0];  /* 0xEF for Winbond */
+    *device_id = jedec_id[2];        /* Capacity ID: 0x15 for W25Q16 */
+
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Auto-detect chip type and configure device info
+ * \param[in]       dev: W25Q device handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_detect(w25q_t* dev) {
+    uint8_t manufacturer_id, device_id;
+    uint32_t capacity;
+
+    if (dev == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+
+    /* Read chip ID */
+    if (w25q_read_id(dev, &manufacturer_id, &device_id) != W25Q_OK) {
+        return W25Q_ERR;
+    }
+
+    /* Verify manufacturer */
+    if (manufacturer_id != W25Q_MANUFACTURER_WINBOND) {
+        dev->info.type = W25Q_UNKNOWN;
+        return W25Q_ERR;
+    }
+
+    /* Get capacity, fixed type build only accepts the configured chip */
+#if W25Q_CFG_FIXED_TYPE
+    capacity = (device_id == W25Q_CFG_FIXED_TYPE) ? prv_capacity(dev) : 0;
+#else
+    capacity = prv_get_capacity(device_id);
+#endif /* W25Q_CFG_FIXED_TYPE */
+    if (capacity == 0) {
+        dev->info.type = W25Q_UNKNOWN;
+        return W25Q_ERR;
+    }
+
+    /* Configure device info */
+    dev->info.type = (w25q_type_t)device_id;
+    dev->info.manufacturer_id = manufacturer_id;
+    dev->info.device_id = device_id;
+    dev->info.capacity_bytes = capacity;
+    dev->info.page_size = W25Q_PAGE_SIZE;
+    dev->info.sector_size = W25Q_SECTOR_SIZE;
+    dev->info.block_size = W25Q_BLOCK_SIZE;
+    dev->info.page_count = capacity / W25Q_PAGE_SIZE;
+    dev->info.sector_count = capacity / W25Q_SECTOR_SIZE;
+    dev->info.block_count = capacity / W25Q_BLOCK_SIZE;
+
+    /* W25Q256 requires 4-byte address mode for full capacity access */
+    if (prv_addr_4byte(dev)) {
+        prv_select(dev);
         dev->ll.transmit((const uint8_t[]){W25Q_CMD_ENTER_4BYTE_MODE}, 1);
         dev->ll.deselect();
         dev->ll.delay_ms(1);
@@ -287,372 +1127,1392 @@ w25q_detect(w25q_t* dev) {
 }
 
 /**
- * \brief           Read data from flash memory
+ * \brief           Read data from flash memory
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Start address to read from
+ * \param[out]      data: Buffer to store read data
+ * \param[in]       len: Number of bytes to read
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_read(w25q_t* dev, uint32_t address, uint8_t* data, uint32_t len) {
+    uint32_t ms = W25Q_NOT_SENT, start;
+    w25q_result_t res;
+    uint8_t mode;
+
+    if (dev == NULL || data == NULL || len == 0) {
+        return W25Q_ERR_PARAM;
+    }
+
+    if (address + len > prv_capacity(dev)) {
+        return W25Q_ERR_PARAM;
+    }
+    if ((res = prv_lock(dev, W25Q_ACCESS_READ, address, len)) != W25Q_OK) {
+        return res;
+    }
+
+    start = prv_stats_begin(dev);
+
+    mode = dev->mode;
+    res = prv_command(dev, prv_read_cmd(dev, mode), address, NULL, data, len, &ms);
+    if (res == W25Q_ERR && dev->mode != mode) {
+        /* Retry after fallback to single line */
+        res = prv_command(dev, prv_read_cmd(dev, dev->mode), address, NULL, data, len, &ms);
+    }
+    if (ms != W25Q_NOT_SENT) {
+        prv_stats_record(dev, start, W25Q_STATS_READ, len, res, 0);
+    }
+    prv_unlock(dev, W25Q_ACCESS_READ);
+    return res;
+}
+
+#if W25Q_CFG_STREAM_CHUNK || __DOXYGEN__
+
+/**
+ * \brief           Read data in chunks passed to callback, with one chip select
+ *
+ * Only two chunks of \ref W25Q_CFG_STREAM_CHUNK bytes are buffered. If the
+ * port provides `receive_start`, the next chunk is received in background
+ * while the callback processes the current one.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Start address to read from
+ * \param[in]       len: Number of bytes to read
+ * \param[in]       chunk_fn: Callback receiving data
+ * \param[in]       arg: User argument for callback
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR if callback aborted,
+ *                      member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_read_stream(w25q_t* dev, uint32_t address, uint32_t len, w25q_chunk_fn chunk_fn, void* arg) {
+    uint8_t buf[2][W25Q_CFG_STREAM_CHUNK];
+    const w25q_cmd_t* cmd;
+    uint32_t done = 0, n, next, start;
+    w25q_result_t res;
+    uint8_t lines, ok, cur = 0, async, mode, aborted = 0;
+
+    if (dev == NULL || chunk_fn == NULL || len == 0) {
+        return W25Q_ERR_PARAM;
+    }
+
+    if (address + len > prv_capacity(dev)) {
+        return W25Q_ERR_PARAM;
+    }
+
+    async = dev->ll.receive_start != NULL && dev->ll.receive_wait != NULL;
+    if ((res = prv_lock(dev, W25Q_ACCESS_READ, address, len)) != W25Q_OK) {
+        return res;
+    }
+    start = prv_stats_begin(dev);
+
+    mode = dev->mode;
+    cmd = prv_read_cmd(dev, mode);
+    res = prv_cmd_begin(dev, cmd, address, &lines, &ok);
+    if (res != W25Q_OK) {
+        prv_unlock(dev, W25Q_ACCESS_READ);
+        return res;
+    }
+
+    n = (len < W25Q_CFG_STREAM_CHUNK) ? len : W25Q_CFG_STREAM_CHUNK;
+    if (ok && async) {
+        ok = dev->ll.receive_start(buf[cur], n);
+    }
+    while (ok && done < len) {
+        ok = async ? dev->ll.receive_wait() : dev->ll.receive(buf[cur], n);
+
+        /* Next chunk goes to other buffer while callback consumes this one */
+        next = len - done - n;
+        next = (next < W25Q_CFG_STREAM_CHUNK) ? next : W25Q_CFG_STREAM_CHUNK;
+        if (ok && async && next > 0) {
+            ok = dev->ll.receive_start(buf[cur ^ 1], next);
+        }
+        if (!ok) {
+            break;
+        }
+
+        if (!chunk_fn(arg, done, buf[cur], n)) {
+            if (async && next > 0) {
+                dev->ll.receive_wait();
+            }
+            aborted = 1;
+            break;
+        }
+        done += n;
+        n = next;
+        cur ^= 1;
+    }
+    res = prv_cmd_end(dev, cmd, lines, ok, NULL);
+    if (res == W25Q_ERR && done == 0 && dev->mode != mode) {
+        /* Nothing delivered yet, retry after fallback to single line */
+        prv_unlock(dev, W25Q_ACCESS_READ);
+        return w25q_read_stream(dev, address, len, chunk_fn, arg);
+    }
+    if (res == W25Q_OK && aborted) {
+        res = W25Q_ERR;
+    }
+
+    prv_stats_record(dev, start, W25Q_STATS_READ, done, res, 0);
+    prv_unlock(dev, W25Q_ACCESS_READ);
+    return res;
+}
+
+#endif /* W25Q_CFG_STREAM_CHUNK || __DOXYGEN__ */
+
+#if (W25Q_CFG_CRC && W25Q_CFG_STREAM_CHUNK) || __DOXYGEN__
+
+/**
+ * \brief           Running state of \ref w25q_crc32
+ */
+typedef struct {
+    uint32_t (*update)(uint32_t crc, const uint8_t* data, uint32_t len);    /*!< Port CRC unit or `NULL` */
+    uint32_t crc;                               /*!< Running CRC value */
+} w25q_crc_ctx_t;
+
+/**
+ * \brief           Fold one streamed chunk into running CRC
+ * \param[in]       arg: CRC context
+ * \param[in]       offset: Unused
+ * \param[in]       data: Chunk data
+ * \param[in]       len: Chunk length
+ * \return          Always `1`
+ */
+static uint8_t
+prv_crc_chunk(void* arg, uint32_t offset, const uint8_t* data, uint32_t len) {
+    w25q_crc_ctx_t* ctx = arg;
+
+    (void)offset;
+    if (ctx->update != NULL) {
+        ctx->crc = ctx->update(ctx->crc, data, len);
+    } else {
+        ctx->crc = w25q_crc32_update(ctx->crc, data, len);
+    }
+    return 1;
+}
+
+/**
+ * \brief           Compute CRC-32 of a flash range
+ *
+ * Data is streamed through \ref w25q_read_stream, so each chunk is checksummed
+ * while the next one is received. The port `crc32_update` hook is used when
+ * available, software \ref w25q_crc32_update otherwise. Result equals
+ * `W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, data, len))`.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Start address
+ * \param[in]       len: Number of bytes to checksum
+ * \param[out]      crc: Pointer to store final CRC-32
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_crc32(w25q_t* dev, uint32_t address, uint32_t len, uint32_t* crc) {
+    w25q_crc_ctx_t ctx;
+    w25q_result_t res;
+
+    if (dev == NULL || crc == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+
+    ctx.update = dev->ll.crc32_update;
+    ctx.crc = W25Q_CRC32_INIT;
+    if (len > 0 && (res = w25q_read_stream(dev, address, len, prv_crc_chunk, &ctx)) != W25Q_OK) {
+        return res;
+    }
+    *crc = W25Q_CRC32_FINAL(ctx.crc);
+    return W25Q_OK;
+}
+
+#endif /* (W25Q_CFG_CRC && W25Q_CFG_STREAM_CHUNK) || __DOXYGEN__ */
+
+/**
+ * \brief           Write data to a page (max 256 bytes)
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Page-aligned address to write to
+ * \param[in]       data: Data to write
+ * \param[in]       len: Number of bytes to write (max 256)
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_write_page(w25q_t* dev, uint32_t address, const uint8_t* data, uint32_t len) {
+    uint32_t ms = W25Q_NOT_SENT, start;
+    w25q_result_t res;
+    uint8_t mode;
+
+    if (dev == NULL || data == NULL || len == 0 || len > W25Q_PAGE_SIZE) {
+        return W25Q_ERR_PARAM;
+    }
+
+    if (address + len > prv_capacity(dev)) {
+        return W25Q_ERR_PARAM;
+    }
+
+    if ((res = prv_lock(dev, W25Q_ACCESS_WRITE, 0, 0)) != W25Q_OK) {
+        return res;
+    }
+    start = prv_stats_begin(dev);
+
+    mode = dev->mode;
+    res = prv_command(dev, &cmd_program[mode], address, data, NULL, len, &ms);
+    if (res == W25Q_ERR && dev->mode != mode) {
+        /* Programming same data again is harmless, retry after fallback */
+        res = prv_command(dev, &cmd_program[dev->mode], address, data, NULL, len, &ms);
+    }
+    if (ms != W25Q_NOT_SENT) {
+        prv_health_record(dev, address, 0, res, ms);
+        prv_stats_record(dev, start, W25Q_STATS_PROGRAM, len, res, ms);
+    }
+    prv_unlock(dev, W25Q_ACCESS_WRITE);
+    return res;
+}
+
+/**
+ * \brief           Erase sector or block
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       cmd: Erase command descriptor
+ * \param[in]       address: Address within erase unit
+ * \param[in]       size: Erase unit size in bytes
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_erase(w25q_t* dev, const w25q_cmd_t* cmd, uint32_t address, uint32_t size) {
+    uint32_t ms = W25Q_NOT_SENT, start;
+    w25q_result_t res;
+
+    if (dev == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+
+    if (address >= prv_capacity(dev)) {
+        return W25Q_ERR_PARAM;
+    }
+
+    if ((res = prv_lock(dev, W25Q_ACCESS_WRITE, 0, 0)) != W25Q_OK) {
+        return res;
+    }
+    start = prv_stats_begin(dev);
+
+#if W25Q_CFG_LOCK
+    dev->op_addr = address - (address % size);
+    dev->op_size = size;
+#else
+    (void)size;
+#endif /* W25Q_CFG_LOCK */
+    res = prv_command(dev, cmd, address, NULL, NULL, 0, &ms);
+    if (ms != W25Q_NOT_SENT) {
+        prv_health_record(dev, address, size, res, ms);
+        prv_stats_record(dev, start,
+                         size == W25Q_SECTOR_SIZE
+                             ? W25Q_STATS_ERASE_4K
+                             : (size == W25Q_BLOCK_SIZE ? W25Q_STATS_ERASE_64K : W25Q_STATS_ERASE_32K),
+                         size, res, ms);
+    }
+    prv_unlock(dev, W25Q_ACCESS_WRITE);
+    return res;
+}
+
+/**
+ * \brief           Erase 4KB sector
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Sector address (should be sector-aligned)
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_erase_sector(w25q_t* dev, uint32_t address) {
+    return prv_erase(dev, &cmd_erase_4k, address, W25Q_SECTOR_SIZE);
+}
+
+/**
+ * \brief           Erase 32KB block
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Block address (should be 32KB-aligned)
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_erase_block_32k(w25q_t* dev, uint32_t address) {
+    return prv_erase(dev, &cmd_erase_32k, address, W25Q_BLOCK_SIZE / 2);
+}
+
+/**
+ * \brief           Erase 64KB block
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Block address (should be 64KB-aligned)
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_erase_block_64k(w25q_t* dev, uint32_t address) {
+    return prv_erase(dev, &cmd_erase_64k, address, W25Q_BLOCK_SIZE);
+}
+
+/**
+ * \brief           Erase entire chip
+ * \param[in]       dev: W25Q device handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_erase_chip(w25q_t* dev) {
+    uint32_t ms, start;
+    w25q_result_t res;
+
+    if (dev == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+
+    if ((res = prv_lock(dev, W25Q_ACCESS_WRITE, 0, 0)) != W25Q_OK) {
+        return res;
+    }
+    start = prv_stats_begin(dev);
+
+    /* Wait until device is ready */
+    if (prv_wait_ready(dev, NULL) != W25Q_OK) {
+        res = W25Q_ERR_TIMEOUT;
+    } else if (prv_write_enable(dev) != W25Q_OK) {
+        res = W25Q_ERR;
+    } else {
+        prv_select(dev);
+        dev->ll.transmit((const uint8_t[]){W25Q_CMD_CHIP_ERASE}, 1);
+        dev->ll.deselect();
+
+        /* Wait for erase completion, chip erase cannot be suspended */
+#if W25Q_CFG_LOCK
+        dev->op_size = 0;
+#endif /* W25Q_CFG_LOCK */
+        res = prv_wait_done(dev, W25Q_BUSY_ERASE, &ms);
+        prv_stats_record(dev, start, W25Q_STATS_ERASE_CHIP, prv_capacity(dev), res, ms);
+    }
+    prv_unlock(dev, W25Q_ACCESS_WRITE);
+    return res;
+}
+
+/**
+ * \brief           Erase range with fewest erase commands
+ *
+ * Uses 64KB and 32KB block erase where the range covers an aligned block,
+ * 4KB sector erase elsewhere.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Sector-aligned start address
+ * \param[in]       len: Number of bytes, multiple of sector size
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_erase_range(w25q_t* dev, uint32_t address, uint32_t len) {
+    w25q_result_t res = W25Q_OK;
+    uint32_t end;
+
+    if (dev == NULL || (address % W25Q_SECTOR_SIZE) != 0 || (len % W25Q_SECTOR_SIZE) != 0) {
+        return W25Q_ERR_PARAM;
+    }
+    if (len > prv_capacity(dev) || address > prv_capacity(dev) - len) {
+        return W25Q_ERR_PARAM;
+    }
+
+    end = address + len;
+    while (address < end && res == W25Q_OK) {
+        if ((address % W25Q_BLOCK_SIZE) == 0 && end - address >= W25Q_BLOCK_SIZE) {
+            res = w25q_erase_block_64k(dev, address);
+            address += W25Q_BLOCK_SIZE;
+        } else if ((address % (W25Q_BLOCK_SIZE / 2)) == 0 && end - address >= W25Q_BLOCK_SIZE / 2) {
+            res = w25q_erase_block_32k(dev, address);
+            address += W25Q_BLOCK_SIZE / 2;
+        } else {
+            res = w25q_erase_sector(dev, address);
+            address += W25Q_SECTOR_SIZE;
+        }
+    }
+    return res;
+}
+
+/**
+ * \brief           Put device into power-down mode
+ * \param[in]       dev: W25Q device handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_power_down(w25q_t* dev) {
+    w25q_result_t res;
+
+    if (dev == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+    if ((res = prv_lock(dev, W25Q_ACCESS_WRITE, 0, 0)) != W25Q_OK) {
+        return res;
+    }
+
+    prv_select(dev);
+    dev->ll.transmit((const uint8_t[]){W25Q_CMD_POWER_DOWN}, 1);
+    dev->ll.deselect();
+
+    prv_unlock(dev, W25Q_ACCESS_WRITE);
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Wake up device from power-down mode
+ * \param[in]       dev: W25Q device handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_wake_up(w25q_t* dev) {
+    w25q_result_t res = W25Q_OK;
+
+    if (dev == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+    if ((res = prv_lock(dev, W25Q_ACCESS_WRITE, 0, 0)) != W25Q_OK) {
+        return res;
+    }
+
+    prv_select(dev);
+    dev->ll.transmit((const uint8_t[]){W25Q_CMD_RELEASE_POWER_DOWN}, 1);
+    dev->ll.deselect();
+
+    /* Wait for device to wake up (tRES2 = 3us min, use 1ms to be safe) */
+    dev->ll.delay_ms(1);
+
+    /* Chip is back in SPI mode if it lost power while sleeping */
+    if (dev->initialized && dev->mode == W25Q_MODE_QPI) {
+        prv_qpi_exit(dev);
+        res = prv_restore_state(dev);
+    }
+
+    prv_unlock(dev, W25Q_ACCESS_WRITE);
+    return res;
+}
+
+/**
+ * \brief           Software reset of device
+ *
+ * Waits for running operation to finish, resets the chip and restores 4-byte
+ * address mode and QPI mode tracked in the handle.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_reset(w25q_t* dev) {
+    w25q_result_t res;
+
+    if (dev == NULL || dev->initialized == 0) {
+        return W25Q_ERR_PARAM;
+    }
+    if ((res = prv_lock(dev, W25Q_ACCESS_WRITE, 0, 0)) != W25Q_OK) {
+        return res;
+    }
+
+    if (prv_wait_ready(dev, NULL) != W25Q_OK) {
+        res = W25Q_ERR_TIMEOUT;
+    } else {
+        prv_simple_cmd(dev, W25Q_CMD_ENABLE_RESET);
+        prv_simple_cmd(dev, W25Q_CMD_RESET);
+
+        /* Reset takes tRST = 30us, chip returns to SPI mode */
+        dev->ll.delay_ms(1);
+        if (prv_bus_lines(dev) != 1) {
+            dev->ll.set_lines(1);
+        }
+        res = prv_restore_state(dev);
+    }
+
+    prv_unlock(dev, W25Q_ACCESS_WRITE);
+    return res;
+}
+
+/**
+ * \brief           Get chip information
+ * \param[in]       dev: W25Q device handle
+ * \param[out]      info: Pointer to store chip information
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_get_info(w25q_t* dev, w25q_info_t* info) {
+    if (dev == NULL || info == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+
+    *info = dev->info;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Check if device is busy
+ * \param[in]       dev: W25Q device handle
+ * \return          `1` if busy, `0` if ready
+ */
+uint8_t
+w25q_is_busy(w25q_t* dev) {
+    uint8_t status;
+
+    if (dev == NULL) {
+        return 0;
+    }
+    if (prv_lock(dev, W25Q_ACCESS_STATUS, 0, 0) != W25Q_OK) {
+        return 1;
+    }
+
+    prv_select(dev);
+    dev->ll.transmit((const uint8_t[]){W25Q_CMD_READ_STATUS_REG1}, 1);
+    dev->ll.receive(&status, 1);
+    dev->ll.deselect();
+
+    prv_unlock(dev, W25Q_ACCESS_STATUS);
+    return (status & W25Q_STATUS_BUSY) ? 1 : 0;
+}
+
+/**
+ * \brief           Set quad enable bit in status register 2 if not set yet
+ * \param[in]       dev: W25Q device handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_quad_enable(w25q_t* dev) {
+    uint8_t sr[2];
+
+    if (prv_wait_ready(dev, NULL) != W25Q_OK) {
+        return W25Q_ERR_TIMEOUT;
+    }
+
+    prv_select(dev);
+    dev->ll.transmit((const uint8_t[]){W25Q_CMD_READ_STATUS_REG2}, 1);
+    dev->ll.receive(&sr[1], 1);
+    dev->ll.deselect();
+    if (sr[1] & W25Q_STATUS2_QE) {
+        return W25Q_OK;
+    }
+
+    prv_select(dev);
+    dev->ll.transmit((const uint8_t[]){W25Q_CMD_READ_STATUS_REG1}, 1);
+    dev->ll.receive(&sr[0], 1);
+    dev->ll.deselect();
+
+    /* Two-byte write of status register 1 is supported by all W25Q generations */
+    if (prv_write_enable(dev) != W25Q_OK) {
+        return W25Q_ERR;
+    }
+    sr[0] &= (uint8_t)~(W25Q_STATUS_BUSY | W25Q_STATUS_WEL);
+    sr[1] |= W25Q_STATUS2_QE;
+    prv_select(dev);
+    dev->ll.transmit((const uint8_t[]){W25Q_CMD_WRITE_STATUS_REG}, 1);
+    dev->ll.transmit(sr, 2);
+    dev->ll.deselect();
+    if (prv_wait_ready(dev, NULL) != W25Q_OK) {
+        return W25Q_ERR_TIMEOUT;
+    }
+
+    prv_select(dev);
+    dev->ll.transmit((const uint8_t[]){W25Q_CMD_READ_STATUS_REG2}, 1);
+    dev->ll.receive(&sr[1], 1);
+    dev->ll.deselect();
+    return (sr[1] & W25Q_STATUS2_QE) ? W25Q_OK : W25Q_ERR;
+}
+
+/**
+ * \brief           Switch chip and handle to protocol mode
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       mode: Protocol mode, checked by caller
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_set_mode(w25q_t* dev, w25q_mode_t mode) {
+    w25q_result_t res;
+
+    if (mode == W25Q_MODE_QUAD_OUT || mode == W25Q_MODE_QUAD_IO || mode == W25Q_MODE_QPI) {
+        res = prv_quad_enable(dev);
+        if (res != W25Q_OK) {
+            return res;
+        }
+    }
+
+#if W25Q_CFG_CONT_READ
+    /* Direct port access after mode change must find chip accepting opcodes */
+    if (dev->cont == W25Q_CONT_ACTIVE) {
+        prv_cont_reset(dev);
+        dev->cont = W25Q_CONT_OPEN;
+    }
+#endif /* W25Q_CFG_CONT_READ */
+    if (dev->mode == W25Q_MODE_QPI && mode != W25Q_MODE_QPI) {
+        prv_qpi_exit(dev);
+    } else if (dev->mode != W25Q_MODE_QPI && mode == W25Q_MODE_QPI) {
+        if (prv_wait_ready(dev, NULL) != W25Q_OK) {
+            return W25Q_ERR_TIMEOUT;
+        }
+        if (prv_qpi_enter(dev) != W25Q_OK) {
+            prv_qpi_exit(dev);
+            dev->mode = W25Q_MODE_SINGLE;
+            return W25Q_ERR;
+        }
+    }
+
+    dev->mode = (uint8_t)mode;
+
+    /* Chip keeps wrap setting across modes, possibly from before MCU reset */
+    if (mode == W25Q_MODE_QUAD_IO) {
+        return prv_wrap_sync(dev);
+    }
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Set protocol mode for read and page program
+ *
+ * Other commands use single line, or 4 lines in \ref W25Q_MODE_QPI. The QPI
+ * mode is restored by \ref w25q_wake_up and \ref w25q_reset. If a transfer
+ * fails in a multi-line mode, the driver falls back to \ref W25Q_MODE_SINGLE
+ * and retries once.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       mode: Protocol mode
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR_PARAM if port has no `set_lines`
+ *                      for multi-line mode, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_set_mode(w25q_t* dev, w25q_mode_t mode) {
+    w25q_result_t res;
+
+    if (dev == NULL || mode >= W25Q_MODE_COUNT) {
+        return W25Q_ERR_PARAM;
+    }
+    if (mode >= W25Q_MODE_DUAL_OUT && dev->ll.set_lines == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+    if ((res = prv_lock(dev, W25Q_ACCESS_WRITE, 0, 0)) != W25Q_OK) {
+        return res;
+    }
+
+    res = prv_set_mode(dev, mode);
+    prv_unlock(dev, W25Q_ACCESS_WRITE);
+    return res;
+}
+
+/**
+ * \brief           Get current protocol mode
+ * \param[in]       dev: W25Q device handle
+ * \return          Protocol mode, changes to \ref W25Q_MODE_SINGLE after transfer failure
+ */
+w25q_mode_t
+w25q_get_mode(w25q_t* dev) {
+    return (dev != NULL) ? (w25q_mode_t)dev->mode : W25Q_MODE_SINGLE;
+}
+
+#if W25Q_CFG_CONT_READ || __DOXYGEN__
+
+/**
+ * \brief           Begin continuous read session
+ *
+ * Reads with \ref w25q_cont_read keep the chip in continuous read mode, so
+ * only address, mode bits and dummy clocks precede the data. Any other call
+ * leaves the mode first and the next session read sends the opcode again.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR_PARAM if mode is not
+ *                      \ref W25Q_MODE_QUAD_IO or wrap is set, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_cont_begin(w25q_t* dev) {
+    if (dev == NULL || dev->mode != W25Q_MODE_QUAD_IO || dev->wrap != W25Q_WRAP_NONE) {
+        return W25Q_ERR_PARAM;
+    }
+    if (dev->cont == W25Q_CONT_OFF) {
+        dev->cont = W25Q_CONT_OPEN;
+    }
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Read data inside continuous read session
+ *
+ * Falls back to \ref w25q_read once the mode is no longer
+ * \ref W25Q_MODE_QUAD_IO, e.g. after a transfer failure.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Start address to read from
+ * \param[out]      data: Buffer to store read data
+ * \param[in]       len: Number of bytes to read
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_cont_read(w25q_t* dev, uint32_t address, uint8_t* data, uint32_t len) {
+    uint32_t ms = W25Q_NOT_SENT, start;
+    w25q_result_t res;
+
+    if (dev == NULL || data == NULL || len == 0 || dev->cont == W25Q_CONT_OFF) {
+        return W25Q_ERR_PARAM;
+    }
+    if (dev->mode != W25Q_MODE_QUAD_IO) {
+        return w25q_read(dev, address, data, len);
+    }
+
+    if (address + len > prv_capacity(dev)) {
+        return W25Q_ERR_PARAM;
+    }
+    if ((res = prv_lock(dev, W25Q_ACCESS_READ, address, len)) != W25Q_OK) {
+        return res;
+    }
+
+    start = prv_stats_begin(dev);
+
+    if (dev->cont == W25Q_CONT_ACTIVE) {
+        res = prv_command(dev, &cmd_read_cont, address, NULL, data, len, &ms);
+    } else {
+        res = prv_command(dev, &cmd_read_cont_enter, address, NULL, data, len, &ms);
+    }
+    dev->cont = W25Q_CONT_ACTIVE;
+    if (res != W25Q_OK) {
+        /* Chip state is unknown, leave mode and send opcode on next read */
+        prv_cont_reset(dev);
+        dev->cont = W25Q_CONT_OPEN;
+        if (dev->mode != W25Q_MODE_QUAD_IO) {
+            /* Retry after fallback to single line */
+            prv_unlock(dev, W25Q_ACCESS_READ);
+            return w25q_read(dev, address, data, len);
+        }
+    }
+    if (ms != W25Q_NOT_SENT) {
+        prv_stats_record(dev, start, W25Q_STATS_READ, len, res, 0);
+    }
+    prv_unlock(dev, W25Q_ACCESS_READ);
+    return res;
+}
+
+/**
+ * \brief           End continuous read session, chip accepts opcodes again
  * \param[in]       dev: W25Q device handle
- * \param[in]       address: Start address to read from
- * \param[out]      data: Buffer to store read data
- * \param[in]       len: Number of bytes to read
  * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
  */
 w25q_result_t
-w25q_read(w25q_t* dev, uint32_t address, uint8_t* data, uint32_t len) {
-    uint8_t cmd[5];
-    uint8_t addr_len;
-
-    if (dev == NULL || data == NULL || len == 0) {
-        return W25Q_ERR_PARAM;
-    }
+w25q_cont_end(w25q_t* dev) {
+    w25q_result_t res;
 
-    if (address + len > dev->info.capacity_bytes) {
+    if (dev == NULL) {
         return W25Q_ERR_PARAM;
     }
-
-    /* Wait until device is ready */
-    if (prv_wait_ready(dev) != W25Q_OK) {
-        return W25Q_ERR_TIMEOUT;
+    if ((res = prv_lock(dev, W25Q_ACCESS_READ, 0, 0)) != W25Q_OK) {
+        return res;
     }
-
-    /* W25Q256 uses 4-byte address */
-    if (dev->info.type == W25Q256) {
-        cmd[0] = W25Q_CMD_READ_DATA;
-        cmd[1] = (address >> 24) & 0xFF;
-        cmd[2] = (address >> 16) & 0xFF;
-        cmd[3] = (address >> 8) & 0xFF;
-        cmd[4] = address & 0xFF;
-        addr_len = 5;
-    } else {
-        cmd[0] = W25Q_CMD_READ_DATA;
-        cmd[1] = (address >> 16) & 0xFF;
-        cmd[2] = (address >> 8) & 0xFF;
-        cmd[3] = address & 0xFF;
-        addr_len = 4;
+    if (dev->cont == W25Q_CONT_ACTIVE) {
+        prv_cont_reset(dev);
     }
-
-    dev->ll.select();
-    dev->ll.transmit(cmd, addr_len);
-    dev->ll.receive(data, len);
-    dev->ll.deselect();
-
+    dev->cont = W25Q_CONT_OFF;
+    prv_unlock(dev, W25Q_ACCESS_READ);
     return W25Q_OK;
 }
 
+#endif /* W25Q_CFG_CONT_READ || __DOXYGEN__ */
+
+#if W25Q_CFG_WRAP || __DOXYGEN__
+
 /**
- * \brief           Write data to a page (max 256 bytes)
+ * \brief           Set burst wrap line size for \ref w25q_read_wrapped
+ *
+ * Chip wraps in \ref W25Q_MODE_QUAD_IO (`0x77`) and \ref W25Q_MODE_QPI
+ * (read parameters). Plain reads in quad I/O mode switch to quad output
+ * while wrap is set. In other modes wrapped reads are split in two.
+ *
  * \param[in]       dev: W25Q device handle
- * \param[in]       address: Page-aligned address to write to
- * \param[in]       data: Data to write
- * \param[in]       len: Number of bytes to write (max 256)
- * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ * \param[in]       wrap: Line size, \ref W25Q_WRAP_NONE to disable
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR_PARAM during continuous
+ *                      read session, member of \ref w25q_result_t otherwise
  */
 w25q_result_t
-w25q_write_page(w25q_t* dev, uint32_t address, const uint8_t* data, uint32_t len) {
-    uint8_t cmd[5];
-    uint8_t addr_len;
+w25q_set_wrap(w25q_t* dev, w25q_wrap_t wrap) {
+    w25q_result_t res;
 
-    if (dev == NULL || data == NULL || len == 0 || len > W25Q_PAGE_SIZE) {
+    if (dev == NULL || dev->cont != W25Q_CONT_OFF) {
         return W25Q_ERR_PARAM;
     }
-
-    if (address + len > dev->info.capacity_bytes) {
+    if (wrap != W25Q_WRAP_NONE && wrap != W25Q_WRAP_8 && wrap != W25Q_WRAP_16 && wrap != W25Q_WRAP_32
+        && wrap != W25Q_WRAP_64) {
         return W25Q_ERR_PARAM;
     }
-
-    /* Wait until device is ready */
-    if (prv_wait_ready(dev) != W25Q_OK) {
-        return W25Q_ERR_TIMEOUT;
-    }
-
-    /* Enable write */
-    if (prv_write_enable(dev) != W25Q_OK) {
-        return W25Q_ERR;
-    }
-
-    /* W25Q256 uses 4-byte address */
-    if (dev->info.type == W25Q256) {
-        cmd[0] = W25Q_CMD_PAGE_PROGRAM;
-        cmd[1] = (address >> 24) & 0xFF;
-        cmd[2] = (address >> 16) & 0xFF;
-        cmd[3] = (address >> 8) & 0xFF;
-        cmd[4] = address & 0xFF;
-        addr_len = 5;
-    } else {
-        cmd[0] = W25Q_CMD_PAGE_PROGRAM;
-        cmd[1] = (address >> 16) & 0xFF;
-        cmd[2] = (address >> 8) & 0xFF;
-        cmd[3] = address & 0xFF;
-        addr_len = 4;
+    if ((res = prv_lock(dev, W25Q_ACCESS_WRITE, 0, 0)) != W25Q_OK) {
+        return res;
     }
 
-    dev->ll.select();
-    dev->ll.transmit(cmd, addr_len);
-    dev->ll.transmit(data, len);
-    dev->ll.deselect();
-
-    /* Wait for write completion */
-    return prv_wait_ready(dev);
+    dev->wrap = (uint8_t)wrap;
+    res = prv_wrap_sync(dev);
+    prv_unlock(dev, W25Q_ACCESS_WRITE);
+    return res;
 }
 
 /**
- * \brief           Erase 4KB sector
+ * \brief           Read within wrap line, starting at requested address
+ *
+ * Data starts with byte at `address`, continues to end of line and wraps
+ * to line start, so the critical word arrives first.
+ *
  * \param[in]       dev: W25Q device handle
- * \param[in]       address: Sector address (should be sector-aligned)
+ * \param[in]       address: Address of first byte to read
+ * \param[out]      data: Buffer to store read data
+ * \param[in]       len: Number of bytes to read, up to wrap line size
  * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
  */
 w25q_result_t
-w25q_erase_sector(w25q_t* dev, uint32_t address) {
-    uint8_t cmd[5];
-    uint8_t addr_len;
+w25q_read_wrapped(w25q_t* dev, uint32_t address, uint8_t* data, uint32_t len) {
+    uint32_t ms = W25Q_NOT_SENT, first, start;
+    w25q_result_t res;
+    uint8_t mode;
 
-    if (dev == NULL) {
+    if (dev == NULL || data == NULL || len == 0 || len > dev->wrap) {
         return W25Q_ERR_PARAM;
     }
-
-    if (address >= dev->info.capacity_bytes) {
+    if (address >= prv_capacity(dev)) {
         return W25Q_ERR_PARAM;
     }
 
-    /* Wait until device is ready */
-    if (prv_wait_ready(dev) != W25Q_OK) {
-        return W25Q_ERR_TIMEOUT;
+    if (dev->mode == W25Q_MODE_QUAD_IO || dev->mode == W25Q_MODE_QPI) {
+        if ((res = prv_lock(dev, W25Q_ACCESS_READ, address & ~(dev->wrap - 1U), dev->wrap)) != W25Q_OK) {
+            return res;
+        }
+        start = prv_stats_begin(dev);
+        mode = dev->mode;
+        res = prv_command(dev, (mode == W25Q_MODE_QPI) ? &cmd_read_wrap_qpi : &cmd_read[W25Q_MODE_QUAD_IO],
+                          address, NULL, data, len, &ms);
+        if (res != W25Q_ERR || dev->mode == mode) {
+            if (ms != W25Q_NOT_SENT) {
+                prv_stats_record(dev, start, W25Q_STATS_READ, len, res, 0);
+            }
+            prv_unlock(dev, W25Q_ACCESS_READ);
+            return res;
+        }
+        /* Fell back to single line, retry with split read */
+        prv_unlock(dev, W25Q_ACCESS_READ);
     }
 
-    /* Enable write */
-    if (prv_write_enable(dev) != W25Q_OK) {
-        return W25Q_ERR;
+    /* No chip wrap in this mode, read up to line end and from line start */
+    first = dev->wrap - (address & (dev->wrap - 1U));
+    if (first >= len) {
+        return w25q_read(dev, address, data, len);
     }
+    res = w25q_read(dev, address, data, first);
+    if (res == W25Q_OK) {
+        res = w25q_read(dev, address & ~(dev->wrap - 1U), &data[first], len - first);
+    }
+    return res;
+}
 
-    /* W25Q256 uses 4-byte address */
-    if (dev->info.type == W25Q256) {
-        cmd[0] = W25Q_CMD_SECTOR_ERASE_4K;
-        cmd[1] = (address >> 24) & 0xFF;
-        cmd[2] = (address >> 16) & 0xFF;
-        cmd[3] = (address >> 8) & 0xFF;
-        cmd[4] = address & 0xFF;
-        addr_len = 5;
-    } else {
-        cmd[0] = W25Q_CMD_SECTOR_ERASE_4K;
-        cmd[1] = (address >> 16) & 0xFF;
-        cmd[2] = (address >> 8) & 0xFF;
-        cmd[3] = address & 0xFF;
-        addr_len = 4;
+#endif /* W25Q_CFG_WRAP || __DOXYGEN__ */
+
+#if W25Q_CFG_VECTOR || __DOXYGEN__
+
+/**
+ * \brief           Find next segment in address order
+ *
+ * Segments are visited by address, equal addresses by index, without
+ * sorting the caller's array.
+ *
+ * \param[in]       iov: Segment array
+ * \param[in]       count: Number of segments
+ * \param[in]       prev: Previous segment index, `count` to get the first
+ * \return          Segment index, `count` if no segment follows
+ */
+static uint32_t
+prv_iov_next(const w25q_iov_t* iov, uint32_t count, uint32_t prev) {
+    uint32_t next = count, i;
+
+    for (i = 0; i < count; ++i) {
+        if (prev < count
+            && (iov[i].address < iov[prev].address || (iov[i].address == iov[prev].address && i <= prev))) {
+            continue;
+        }
+        if (next == count || iov[i].address < iov[next].address) {
+            next = i;
+        }
     }
+    return next;
+}
 
-    dev->ll.select();
-    dev->ll.transmit(cmd, addr_len);
-    dev->ll.deselect();
+/**
+ * \brief           Check segment array
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       iov: Segment array
+ * \param[in]       count: Number of segments
+ * \param[in]       overlap: `1` if segments may overlap, `0` otherwise
+ * \return          `1` if valid, `0` otherwise
+ */
+static uint8_t
+prv_iov_check(w25q_t* dev, const w25q_iov_t* iov, uint32_t count, uint8_t overlap) {
+    uint32_t end = 0, i;
 
-    /* Wait for erase completion */
-    return prv_wait_ready(dev);
+    if (iov == NULL || count == 0) {
+        return 0;
+    }
+    for (i = prv_iov_next(iov, count, count); i < count; i = prv_iov_next(iov, count, i)) {
+        if (iov[i].data == NULL || iov[i].len == 0 || iov[i].len > prv_capacity(dev)
+            || iov[i].address > prv_capacity(dev) - iov[i].len) {
+            return 0;
+        }
+        if (!overlap && iov[i].address < end) {
+            return 0;
+        }
+        end = iov[i].address + iov[i].len;
+    }
+    return 1;
 }
 
 /**
- * \brief           Erase 32KB block
+ * \brief           Read segments with minimum number of commands
  * \param[in]       dev: W25Q device handle
- * \param[in]       address: Block address (should be 32KB-aligned)
+ * \param[in]       iov: Segment array
+ * \param[in]       count: Number of segments
+ * \param[out]      total: Number of bytes read
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_readv(w25q_t* dev, const w25q_iov_t* iov, uint32_t count, uint32_t* total) {
+    uint8_t gap[W25Q_CFG_VECTOR_GAP];
+    w25q_cmd_t cmd = *prv_read_cmd(dev, dev->mode);
+    w25q_result_t res;
+    uint32_t i, end;
+    uint8_t lines, ok;
+
+    i = prv_iov_next(iov, count, count);
+    while (i < count) {
+        res = prv_cmd_begin(dev, &cmd, iov[i].address, &lines, &ok);
+        if (res != W25Q_OK) {
+            return res;
+        }
+        /* Status is polled once, chip stays ready while only reading */
+        cmd.flags |= W25Q_CMD_FLAG_READY;
+
+        /* Follow with segments starting at or shortly after end of this one */
+        end = iov[i].address;
+        do {
+            if (ok && iov[i].address > end) {
+                ok = dev->ll.receive(gap, iov[i].address - end);
+            }
+            ok = ok && dev->ll.receive(iov[i].data, iov[i].len);
+            *total += iov[i].len;
+            end = iov[i].address + iov[i].len;
+            i = prv_iov_next(iov, count, i);
+        } while (i < count && iov[i].address >= end && iov[i].address - end <= W25Q_CFG_VECTOR_GAP);
+
+        res = prv_cmd_end(dev, &cmd, lines, ok, NULL);
+        if (res != W25Q_OK) {
+            return res;
+        }
+    }
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Read several regions
+ *
+ * Segments are read in address order. Adjacent segments and segments up to
+ * \ref W25Q_CFG_VECTOR_GAP bytes apart share one command, and status is
+ * polled only before the first one.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       iov: Segment array, may overlap
+ * \param[in]       count: Number of segments
  * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
  */
 w25q_result_t
-w25q_erase_block_32k(w25q_t* dev, uint32_t address) {
-    uint8_t cmd[5];
-    uint8_t addr_len;
+w25q_readv(w25q_t* dev, const w25q_iov_t* iov, uint32_t count) {
+    w25q_result_t res;
+    uint32_t total = 0, lo, hi, i, start;
+    uint8_t mode;
 
-    if (dev == NULL) {
+    if (dev == NULL || !prv_iov_check(dev, iov, count, 1)) {
         return W25Q_ERR_PARAM;
     }
 
-    if (address >= dev->info.capacity_bytes) {
-        return W25Q_ERR_PARAM;
+    /* Whole span decides whether an erase may be suspended */
+    lo = iov[0].address;
+    hi = iov[0].address + iov[0].len;
+    for (i = 1; i < count; ++i) {
+        lo = (iov[i].address < lo) ? iov[i].address : lo;
+        hi = (iov[i].address + iov[i].len > hi) ? iov[i].address + iov[i].len : hi;
     }
-
-    /* Wait until device is ready */
-    if (prv_wait_ready(dev) != W25Q_OK) {
-        return W25Q_ERR_TIMEOUT;
+    if ((res = prv_lock(dev, W25Q_ACCESS_READ, lo, hi - lo)) != W25Q_OK) {
+        return res;
     }
 
-    /* Enable write */
-    if (prv_write_enable(dev) != W25Q_OK) {
-        return W25Q_ERR;
+    start = prv_stats_begin(dev);
+
+    mode = dev->mode;
+    res = prv_readv(dev, iov, count, &total);
+    if (res == W25Q_ERR && dev->mode != mode) {
+        /* Retry after fallback to single line */
+        total = 0;
+        res = prv_readv(dev, iov, count, &total);
+    }
+    if (total != 0) {
+        prv_stats_record(dev, start, W25Q_STATS_READ, total, res, 0);
     }
+    prv_unlock(dev, W25Q_ACCESS_READ);
+    return res;
+}
 
-    /* W25Q256 uses 4-byte address */
-    if (dev->info.type == W25Q256) {
-        cmd[0] = W25Q_CMD_BLOCK_ERASE_32K;
-        cmd[1] = (address >> 24) & 0xFF;
-        cmd[2] = (address >> 16) & 0xFF;
-        cmd[3] = (address >> 8) & 0xFF;
-        cmd[4] = address & 0xFF;
-        addr_len = 5;
-    } else {
-        cmd[0] = W25Q_CMD_BLOCK_ERASE_32K;
-        cmd[1] = (address >> 16) & 0xFF;
-        cmd[2] = (address >> 8) & 0xFF;
-        cmd[3] = address & 0xFF;
-        addr_len = 4;
+/**
+ * \brief           Program part of segments falling into one page
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       iov: Segment array
+ * \param[in]       count: Number of segments
+ * \param[in,out]   idx: Current segment index, updated to first not finished one
+ * \param[in,out]   off: Offset in current segment, updated accordingly
+ * \param[out]      bytes: Number of segment bytes sent
+ * \param[out]      busy_ms: Program time, left unchanged if command was not sent
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_writev_page(w25q_t* dev, const w25q_iov_t* iov, uint32_t count, uint32_t* idx, uint32_t* off, uint32_t* bytes,
+                uint32_t* busy_ms) {
+    static const uint8_t ones[16] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                     0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    const w25q_cmd_t* cmd = &cmd_program[dev->mode];
+    uint32_t i = *idx, pos, page_end, n;
+    w25q_result_t res;
+    uint8_t lines, ok;
+
+    *bytes = 0;
+    pos = iov[i].address + *off;
+    page_end = (pos & ~(W25Q_PAGE_SIZE - 1UL)) + W25Q_PAGE_SIZE;
+    res = prv_cmd_begin(dev, cmd, pos, &lines, &ok);
+    if (res != W25Q_OK) {
+        return res;
     }
 
-    dev->ll.select();
-    dev->ll.transmit(cmd, addr_len);
-    dev->ll.deselect();
+    while (ok) {
+        n = iov[i].len - *off;
+        n = (n < page_end - pos) ? n : page_end - pos;
+        ok = dev->ll.transmit(&iov[i].data[*off], n);
+        pos += n;
+        *off += n;
+        *bytes += n;
+        if (*off < iov[i].len) {
+            break;
+        }
+        i = prv_iov_next(iov, count, i);
+        *off = 0;
+        if (i >= count || iov[i].address >= page_end) {
+            break;
+        }
 
-    /* Wait for erase completion */
-    return prv_wait_ready(dev);
+        /* Bytes between segments are programmed with 0xFF, which leaves them unchanged */
+        while (ok && pos < iov[i].address) {
+            n = iov[i].address - pos;
+            n = (n < sizeof(ones)) ? n : sizeof(ones);
+            ok = dev->ll.transmit(ones, n);
+            pos += n;
+        }
+    }
+    *idx = i;
+    return prv_cmd_end(dev, cmd, lines, ok, busy_ms);
 }
 
 /**
- * \brief           Erase 64KB block
+ * \brief           Program several regions
+ *
+ * Segments are programmed in address order. All data falling into the same
+ * page goes into one page program command, gaps between segments are sent
+ * as `0xFF`. Regions must be erased.
+ *
  * \param[in]       dev: W25Q device handle
- * \param[in]       address: Block address (should be 64KB-aligned)
+ * \param[in]       iov: Segment array, must not overlap
+ * \param[in]       count: Number of segments
  * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
  */
 w25q_result_t
-w25q_erase_block_64k(w25q_t* dev, uint32_t address) {
-    uint8_t cmd[5];
-    uint8_t addr_len;
-
-    if (dev == NULL) {
+w25q_writev(w25q_t* dev, const w25q_iov_t* iov, uint32_t count) {
+    w25q_result_t res = W25Q_OK;
+    uint32_t i, off = 0, start_i, start_off, bytes, ms, start;
+#if W25Q_CFG_HEALTH
+    uint32_t address;
+#endif /* W25Q_CFG_HEALTH */
+    uint8_t mode;
+
+    if (dev == NULL || !prv_iov_check(dev, iov, count, 0)) {
         return W25Q_ERR_PARAM;
     }
-
-    if (address >= dev->info.capacity_bytes) {
-        return W25Q_ERR_PARAM;
+    if ((res = prv_lock(dev, W25Q_ACCESS_WRITE, 0, 0)) != W25Q_OK) {
+        return res;
     }
 
-    /* Wait until device is ready */
-    if (prv_wait_ready(dev) != W25Q_OK) {
-        return W25Q_ERR_TIMEOUT;
-    }
+    i = prv_iov_next(iov, count, count);
+    while (i < count && res == W25Q_OK) {
+        start = prv_stats_begin(dev);
+
+        start_i = i;
+        start_off = off;
+#if W25Q_CFG_HEALTH
+        address = iov[i].address + off;
+#endif /* W25Q_CFG_HEALTH */
+        ms = W25Q_NOT_SENT;
+        mode = dev->mode;
+        res = prv_writev_page(dev, iov, count, &i, &off, &bytes, &ms);
+        if (res == W25Q_ERR && dev->mode != mode) {
+            /* Programming same data again is harmless, retry after fallback */
+            i = start_i;
+            off = start_off;
+            res = prv_writev_page(dev, iov, count, &i, &off, &bytes, &ms);
+        }
+        if (ms == W25Q_NOT_SENT) {
+            break;
+        }
 
-    /* Enable write */
-    if (prv_write_enable(dev) != W25Q_OK) {
-        return W25Q_ERR;
+        prv_health_record(dev, address, 0, res, ms);
+        prv_stats_record(dev, start, W25Q_STATS_PROGRAM, bytes, res, ms);
     }
+    prv_unlock(dev, W25Q_ACCESS_WRITE);
+    return res;
+}
 
-    /* W25Q256 uses 4-byte address */
-    if (dev->info.type == W25Q256) {
-        cmd[0] = W25Q_CMD_BLOCK_ERASE_64K;
-        cmd[1] = (address >> 24) & 0xFF;
-        cmd[2] = (address >> 16) & 0xFF;
-        cmd[3] = (address >> 8) & 0xFF;
-        cmd[4] = address & 0xFF;
-        addr_len = 5;
-    } else {
-        cmd[0] = W25Q_CMD_BLOCK_ERASE_64K;
-        cmd[1] = (address >> 16) & 0xFF;
-        cmd[2] = (address >> 8) & 0xFF;
-        cmd[3] = address & 0xFF;
-        addr_len = 4;
-    }
+#endif /* W25Q_CFG_VECTOR || __DOXYGEN__ */
 
-    dev->ll.select();
-    dev->ll.transmit(cmd, addr_len);
-    dev->ll.deselect();
 
-    /* Wait for erase completion */
-    return prv_wait_ready(dev);
+#if W25Q_CFG_COPY_BUF || __DOXYGEN__
+
+/**
+ * \brief           Wait for page program completion, polling without delay
+ *
+ * A page program finishes in well under the 1 ms poll interval of
+ * \ref prv_wait_ready, polling at bus speed lets a copy run at program speed.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[out]      elapsed_ms: Wait time in ms
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_wait_program(w25q_t* dev, uint32_t* elapsed_ms) {
+    uint32_t i;
+    uint8_t status;
+
+    prv_health_mark(dev, 1);
+    for (i = 0; i < W25Q_PROGRAM_POLLS; ++i) {
+        prv_select(dev);
+        dev->ll.transmit((const uint8_t[]){W25Q_CMD_READ_STATUS_REG1}, 1);
+        dev->ll.receive(&status, 1);
+        dev->ll.deselect();
+        prv_stats_inc(dev, status_polls);
+
+        if ((status & W25Q_STATUS_BUSY) == 0) {
+            *elapsed_ms = 0;
+            return W25Q_OK;
+        }
+    }
+    return prv_wait_done(dev, W25Q_BUSY_PROGRAM, elapsed_ms);
+}
+
+/**
+ * \brief           Program one chunk read by \ref w25q_copy
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       dst: Destination address of chunk
+ * \param[in]       buf: Chunk data
+ * \param[in]       chunk: Chunk length
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_copy_chunk(w25q_t* dev, uint32_t dst, const uint8_t* buf, uint32_t chunk) {
+    w25q_cmd_t cmd;
+    w25q_result_t res;
+    uint32_t pos, n, skip, end, ms, start;
+    uint8_t mode;
+
+    for (pos = 0; pos < chunk; pos += n) {
+        n = W25Q_PAGE_SIZE - ((dst + pos) % W25Q_PAGE_SIZE);
+        n = (n < chunk - pos) ? n : chunk - pos;
+
+        /* Erased bytes at start and end of page slice need no programming */
+        for (skip = 0; skip < n && buf[pos + skip] == 0xFF; ++skip) {}
+        if (skip == n) {
+            continue;
+        }
+        for (end = n; buf[pos + end - 1] == 0xFF; --end) {}
+
+        start = prv_stats_begin(dev);
+        mode = dev->mode;
+        cmd = cmd_program[mode];
+        cmd.flags |= W25Q_CMD_FLAG_NO_WAIT;
+        ms = W25Q_NOT_SENT;
+        res = prv_command(dev, &cmd, dst + pos + skip, &buf[pos + skip], NULL, end - skip, &ms);
+        if (res == W25Q_ERR && dev->mode != mode) {
+            /* Programming same data again is harmless, retry after fallback */
+            cmd = cmd_program[dev->mode];
+            cmd.flags |= W25Q_CMD_FLAG_NO_WAIT;
+            res = prv_command(dev, &cmd, dst + pos + skip, &buf[pos + skip], NULL, end - skip, &ms);
+        }
+        if (ms == W25Q_NOT_SENT) {
+            return res;
+        }
+        if (res == W25Q_OK) {
+            res = prv_wait_program(dev, &ms);
+        }
+        prv_health_record(dev, dst + pos, 0, res, ms);
+        prv_stats_record(dev, start, W25Q_STATS_PROGRAM, end - skip, res, ms);
+        if (res != W25Q_OK) {
+            return res;
+        }
+    }
+    return W25Q_OK;
 }
 
 /**
- * \brief           Erase entire chip
+ * \brief           Copy region to another region
+ *
+ * Source is read in \ref W25Q_CFG_COPY_BUF chunks, each destination page is
+ * programmed with one command and all-`0xFF` parts are skipped. Addresses
+ * and length need no alignment. Regions must not overlap.
+ *
  * \param[in]       dev: W25Q device handle
+ * \param[in]       src: Source address
+ * \param[in]       dst: Destination address
+ * \param[in]       len: Number of bytes
+ * \param[in]       erase: Set to `1` to erase destination first, then `dst` and `len` must be
+ *                      sector-aligned. Otherwise destination must be erased
  * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
  */
 w25q_result_t
-w25q_erase_chip(w25q_t* dev) {
-    if (dev == NULL) {
+w25q_copy(w25q_t* dev, uint32_t src, uint32_t dst, uint32_t len, uint8_t erase) {
+    uint8_t buf[W25Q_CFG_COPY_BUF];
+    w25q_result_t res;
+    uint32_t chunk;
+
+    if (dev == NULL || len == 0 || len > prv_capacity(dev)) {
         return W25Q_ERR_PARAM;
     }
-
-    /* Wait until device is ready */
-    if (prv_wait_ready(dev) != W25Q_OK) {
-        return W25Q_ERR_TIMEOUT;
+    if (src > prv_capacity(dev) - len || dst > prv_capacity(dev) - len || (src < dst + len && dst < src + len)) {
+        return W25Q_ERR_PARAM;
     }
 
-    /* Enable write */
-    if (prv_write_enable(dev) != W25Q_OK) {
-        return W25Q_ERR;
+    if (erase) {
+        res = w25q_erase_range(dev, dst, len);
+        if (res != W25Q_OK) {
+            return res;
+        }
     }
 
-    dev->ll.select();
-    dev->ll.transmit((const uint8_t[]){W25Q_CMD_CHIP_ERASE}, 1);
-    dev->ll.deselect();
+    while (len > 0) {
+        /* Chunk ends on destination page boundary when buffer is large enough */
+        chunk = W25Q_CFG_COPY_BUF;
+        if (chunk > W25Q_PAGE_SIZE) {
+            chunk -= dst % W25Q_PAGE_SIZE;
+        }
+        chunk = (chunk < len) ? chunk : len;
+        res = w25q_read(dev, src, buf, chunk);
+        if (res != W25Q_OK) {
+            return res;
+        }
+
+        /* Lock per chunk, reads of other tasks get in between */
+        if ((res = prv_lock(dev, W25Q_ACCESS_WRITE, 0, 0)) != W25Q_OK) {
+            return res;
+        }
+        res = prv_copy_chunk(dev, dst, buf, chunk);
+        prv_unlock(dev, W25Q_ACCESS_WRITE);
+        if (res != W25Q_OK) {
+            return res;
+        }
 
-    /* Wait for erase completion */
-    return prv_wait_ready(dev);
+        src += chunk;
+        dst += chunk;
+        len -= chunk;
+    }
+    return W25Q_OK;
 }
 
+#endif /* W25Q_CFG_COPY_BUF || __DOXYGEN__ */
+
+#if W25Q_CFG_HEALTH || __DOXYGEN__
+
 /**
- * \brief           Put device into power-down mode
+ * \brief           Attach sector health table
+ *
+ * Erase and program durations and failures of covered sectors are recorded
+ * from then on. Table content is kept, so it can be restored from
+ * non-volatile storage before attaching.
+ *
  * \param[in]       dev: W25Q device handle
+ * \param[in]       table: Table with `count` entries, zero-initialized for a new device.
+ *                      Set to `NULL` to detach
+ * \param[in]       first_sector: Index of sector described by first entry
+ * \param[in]       count: Number of entries
+ * \param[in]       erase_limit_ms: Sector erase time above which the sector is flagged
  * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
  */
 w25q_result_t
-w25q_power_down(w25q_t* dev) {
-    if (dev == NULL) {
+w25q_health_attach(w25q_t* dev, w25q_sector_health_t* table, uint32_t first_sector, uint32_t count,
+                   uint16_t erase_limit_ms) {
+    if (dev == NULL || (table != NULL && count == 0)) {
         return W25Q_ERR_PARAM;
     }
 
-    dev->ll.select();
-    dev->ll.transmit((const uint8_t[]){W25Q_CMD_POWER_DOWN}, 1);
-    dev->ll.deselect();
-
+    dev->health = table;
+    dev->health_first = first_sector;
+    dev->health_count = (table != NULL) ? count : 0;
+    dev->health_erase_limit = erase_limit_ms;
     return W25Q_OK;
 }
 
 /**
- * \brief           Wake up device from power-down mode
+ * \brief           Get health entry of sector containing address
  * \param[in]       dev: W25Q device handle
- * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ * \param[in]       address: Any address inside the sector
+ * \param[out]      entry: Pointer to store entry
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR_PARAM if sector is not tracked
  */
 w25q_result_t
-w25q_wake_up(w25q_t* dev) {
-    if (dev == NULL) {
+w25q_health_get(w25q_t* dev, uint32_t address, w25q_sector_health_t* entry) {
+    uint32_t sector;
+
+    if (dev == NULL || entry == NULL || dev->health == NULL) {
         return W25Q_ERR_PARAM;
     }
 
-    dev->ll.select();
-    dev->ll.transmit((const uint8_t[]){W25Q_CMD_RELEASE_POWER_DOWN}, 1);
-    dev->ll.deselect();
+    sector = address / W25Q_SECTOR_SIZE;
+    if (sector < dev->health_first || sector - dev->health_first >= dev->health_count) {
+        return W25Q_ERR_PARAM;
+    }
+    *entry = dev->health[sector - dev->health_first];
+    return W25Q_OK;
+}
 
-    /* Wait for device to wake up (tRES2 = 3us min, use 1ms to be safe) */
-    dev->ll.delay_ms(1);
+/**
+ * \brief           Check if sector containing address should be retired
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Any address inside the sector
+ * \return          `1` if sector is flagged as slow or failing, `0` otherwise
+ */
+uint8_t
+w25q_health_is_bad(w25q_t* dev, uint32_t address) {
+    w25q_sector_health_t entry;
 
-    return W25Q_OK;
+    if (w25q_health_get(dev, address, &entry) != W25Q_OK) {
+        return 0;
+    }
+    return entry.flags != 0;
 }
 
+#endif /* W25Q_CFG_HEALTH || __DOXYGEN__ */
+
+#if W25Q_CFG_STATS || __DOXYGEN__
+
 /**
- * \brief           Get chip information
+ * \brief           Get snapshot of driver statistics
  * \param[in]       dev: W25Q device handle
- * \param[out]      info: Pointer to store chip information
+ * \param[out]      stats: Pointer to store statistics
  * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
  */
 w25q_result_t
-w25q_get_info(w25q_t* dev, w25q_info_t* info) {
-    if (dev == NULL || info == NULL) {
+w25q_stats_get(w25q_t* dev, w25q_stats_t* stats) {
+    if (dev == NULL || stats == NULL) {
         return W25Q_ERR_PARAM;
     }
 
-    *info = dev->info;
+    *stats = dev->stats;
     return W25Q_OK;
 }
 
 /**
- * \brief           Check if device is busy
+ * \brief           Clear driver statistics
  * \param[in]       dev: W25Q device handle
- * \return          `1` if busy, `0` if ready
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
  */
-uint8_t
-w25q_is_busy(w25q_t* dev) {
-    uint8_t status;
-
+w25q_result_t
+w25q_stats_reset(w25q_t* dev) {
     if (dev == NULL) {
-        return 0;
+        return W25Q_ERR_PARAM;
     }
 
-    dev->ll.select();
-    dev->ll.transmit((const uint8_t[]){W25Q_CMD_READ_STATUS_REG1}, 1);
-    dev->ll.receive(&status, 1);
-    dev->ll.deselect();
-
-    return (status & W25Q_STATUS_BUSY) ? 1 : 0;
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    return W25Q_OK;
 }
 
+#endif /* W25Q_CFG_STATS || __DOXYGEN__ */
@@ -40,6 +40,132 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/**
+ * \brief           Enable sector health tracking (erase/program timing and failures)
+ */
+#ifndef W25Q_CFG_HEALTH
+#define W25Q_CFG_HEALTH                 1
+#endif
+
+/**
+ * \brief           Enable driver statistics (operation counters, busy time, latency histograms)
+ */
+#ifndef W25Q_CFG_STATS
+#define W25Q_CFG_STATS                  0
+#endif
+
+/**
+ * \brief           Number of log2 latency histogram buckets per operation
+ *
+ * Bucket `n` counts calls taking [2^n, 2^(n+1)) microseconds, last bucket collects everything above.
+ */
+#ifndef W25Q_CFG_STATS_BUCKETS
+#define W25Q_CFG_STATS_BUCKETS          24
+#endif
+
+/**
+ * \brief           Dummy clocks of fast read in QPI mode, set with read parameters command
+ *
+ * One of `2`, `4`, `6` or `8`. Fewer clocks shorten each read, the datasheet
+ * limits the SPI clock for each setting (W25Q128JV: 26, 50, 80, 104 MHz).
+ */
+#ifndef W25Q_CFG_QPI_DUMMY
+#define W25Q_CFG_QPI_DUMMY              8
+#endif
+
+/**
+ * \brief           Enables `1` or disables `0` continuous read session API
+ *
+ * Quad I/O reads inside a session keep the chip in continuous read mode,
+ * every read after the first skips the 8 opcode clocks.
+ */
+#ifndef W25Q_CFG_CONT_READ
+#define W25Q_CFG_CONT_READ              1
+#endif
+
+/**
+ * \brief           Enables `1` or disables `0` burst with wrap reads
+ */
+#ifndef W25Q_CFG_WRAP
+#define W25Q_CFG_WRAP                   1
+#endif
+
+/**
+ * \brief           Chunk size of \ref w25q_read_stream in bytes, `0` disables the function
+ *
+ * Two chunks are placed on the stack while streaming.
+ */
+#ifndef W25Q_CFG_STREAM_CHUNK
+#define W25Q_CFG_STREAM_CHUNK           128
+#endif
+
+/**
+ * \brief           Enables `1` or disables `0` \ref w25q_crc32
+ *
+ * Requires \ref W25Q_CFG_STREAM_CHUNK and linking `w25q_crc.c`.
+ */
+#ifndef W25Q_CFG_CRC
+#define W25Q_CFG_CRC                    1
+#endif
+
+/**
+ * \brief           Enables `1` or disables `0` sharing the device between tasks
+ *
+ * Takes effect when the port sets `lock` and `unlock`. Reads are served
+ * ahead of queued programs and erases.
+ */
+#ifndef W25Q_CFG_LOCK
+#define W25Q_CFG_LOCK                   1
+#endif
+
+/**
+ * \brief           Enables `1` or disables `0` erase suspend for reads from other tasks
+ *
+ * A read outside the range being erased suspends the erase for its duration.
+ * Requires \ref W25Q_CFG_LOCK.
+ */
+#ifndef W25Q_CFG_ERASE_SUSPEND
+#define W25Q_CFG_ERASE_SUSPEND          1
+#endif
+
+/**
+ * \brief           Enables `1` or disables `0` vectored read and write
+ */
+#ifndef W25Q_CFG_VECTOR
+#define W25Q_CFG_VECTOR                 1
+#endif
+
+/**
+ * \brief           Largest gap between segments read within one command, in bytes
+ *
+ * Clocking a few unused bytes is cheaper than a new command header and chip
+ * select. Gap bytes go to a stack buffer of this size.
+ */
+#ifndef W25Q_CFG_VECTOR_GAP
+#define W25Q_CFG_VECTOR_GAP             8
+#endif
+
+/**
+ * \brief           Buffer size of \ref w25q_copy in bytes, `0` disables the function
+ *
+ * Buffer is placed on the stack. Each read fills it, a multiple of the page
+ * size saves read commands.
+ */
+#ifndef W25Q_CFG_COPY_BUF
+#define W25Q_CFG_COPY_BUF               512
+#endif
+
+/**
+ * \brief           Fix chip type at build time
+ *
+ * Set to the JEDEC capacity ID as a number (e.g. `0x18` for W25Q128, enum
+ * names do not work in preprocessor conditions). Capacity and address width
+ * become constants, detection only accepts this chip. `0` detects at runtime.
+ */
+#ifndef W25Q_CFG_FIXED_TYPE
+#define W25Q_CFG_FIXED_TYPE             0
+#endif
+
 /**
  * \brief           W25Q chip types enumeration
  */
@@ -67,6 +193,33 @@ typedef enum {
     W25Q_ERR_BUSY,                              /*!< Device is busy */
 } w25q_result_t;
 
+/**
+ * \brief           Protocol mode used for read and page program
+ *
+ * Modes other than \ref W25Q_MODE_SINGLE and \ref W25Q_MODE_FAST need the
+ * `set_lines` low-level function. Quad and QPI modes set the QE status bit.
+ */
+typedef enum {
+    W25Q_MODE_SINGLE = 0,                       /*!< Read `0x03`, program `0x02`, all on one line */
+    W25Q_MODE_FAST,                             /*!< Fast read `0x0B` with 8 dummy clocks, for high SPI clocks */
+    W25Q_MODE_DUAL_OUT,                         /*!< Read `0x3B`, data on 2 lines */
+    W25Q_MODE_QUAD_OUT,                         /*!< Read `0x6B`, program `0x32`, data on 4 lines */
+    W25Q_MODE_QUAD_IO,                          /*!< Read `0xEB` with address on 4 lines, program `0x32` */
+    W25Q_MODE_QPI,                              /*!< QPI, every command on 4 lines, read `0x0B`, program `0x02` */
+    W25Q_MODE_COUNT,                            /*!< Number of modes */
+} w25q_mode_t;
+
+/**
+ * \brief           Burst wrap length, value is line size in bytes
+ */
+typedef enum {
+    W25Q_WRAP_NONE = 0,                         /*!< Wrap disabled */
+    W25Q_WRAP_8 = 8,                            /*!< Wrap within 8-byte line */
+    W25Q_WRAP_16 = 16,                          /*!< Wrap within 16-byte line */
+    W25Q_WRAP_32 = 32,                          /*!< Wrap within 32-byte line */
+    W25Q_WRAP_64 = 64,                          /*!< Wrap within 64-byte line */
+} w25q_wrap_t;
+
 /**
  * \brief           W25Q chip information structure
  */
@@ -94,8 +247,102 @@ typedef struct {
     uint8_t (*receive)(uint8_t* data, uint32_t len);         /*!< Receive data */
     uint8_t (*transmit_receive)(const uint8_t* tx_data, uint8_t* rx_data, uint32_t len);  /*!< Full-duplex transfer */
     void (*delay_ms)(uint32_t ms);              /*!< Delay in milliseconds */
+    uint32_t (*get_time_us)(void);              /*!< Free-running microsecond counter for statistics.
+                                                        Optional, can be `NULL` */
+    uint8_t (*set_lines)(uint8_t lines);        /*!< Use 1, 2 or 4 data lines for following transfers.
+                                                        Optional, `NULL` for single-line SPI */
+    uint8_t (*receive_start)(uint8_t* data, uint32_t len);  /*!< Start background receive, e.g. DMA.
+                                                        Optional, `NULL` to use blocking `receive` */
+    uint8_t (*receive_wait)(void);              /*!< Wait for background receive to complete.
+                                                        Required with `receive_start` */
+    uint32_t (*crc32_update)(uint32_t crc, const uint8_t* data, uint32_t len);  /*!< CRC-32 unit, same result
+                                                        as \ref w25q_crc32_update.
+                                                        Optional, `NULL` for software */
+    uint8_t (*lock)(void);                      /*!< Take mutex of the device, `1` on success, `0` on timeout.
+                                                        Optional, `NULL` for use from one task only */
+    void (*unlock)(void);                       /*!< Release mutex of the device. Required with `lock` */
 } w25q_ll_t;
 
+/**
+ * \brief           Segment of vectored read or write
+ */
+typedef struct {
+    uint32_t address;                           /*!< Flash address */
+    uint8_t* data;                              /*!< Data buffer, only read by \ref w25q_writev */
+    uint32_t len;                               /*!< Number of bytes */
+} w25q_iov_t;
+
+/**
+ * \brief           Chunk callback of \ref w25q_read_stream
+ * \param[in]       arg: User argument
+ * \param[in]       offset: Offset of first byte from stream start
+ * \param[in]       data: Chunk data, valid until callback returns
+ * \param[in]       len: Number of bytes
+ * \return          `1` to continue, `0` to abort streaming
+ */
+typedef uint8_t (*w25q_chunk_fn)(void* arg, uint32_t offset, const uint8_t* data, uint32_t len);
+
+/**
+ * \brief           Sector health flags
+ */
+#define W25Q_HEALTH_SLOW_ERASE          0x01    /*!< Sector erase took longer than the limit */
+#define W25Q_HEALTH_ERASE_FAIL          0x02    /*!< Erase failed or timed out */
+#define W25Q_HEALTH_PROGRAM_FAIL        0x04    /*!< Page program failed or timed out */
+
+/**
+ * \brief           Per-sector health record
+ */
+typedef struct {
+    uint16_t erase_time;                        /*!< Last sector erase time in ms */
+    uint16_t erase_time_max;                    /*!< Longest sector erase time in ms */
+    uint8_t program_time_max;                   /*!< Longest page program time in 100 us units, saturating.
+                                                        Measured with `get_time_us` when available,
+                                                        otherwise from busy polling. Resolution is the
+                                                        poll interval: 1 ms for page writes, bus speed
+                                                        for \ref w25q_copy */
+    uint8_t erase_fail;                         /*!< Erase failure count, saturating */
+    uint8_t program_fail;                       /*!< Program failure count, saturating */
+    uint8_t flags;                              /*!< Combination of `W25Q_HEALTH_*` flags */
+} w25q_sector_health_t;
+
+/**
+ * \brief           Operations tracked by statistics
+ */
+typedef enum {
+    W25Q_STATS_READ = 0,                        /*!< \ref w25q_read */
+    W25Q_STATS_PROGRAM,                         /*!< \ref w25q_write_page */
+    W25Q_STATS_ERASE_4K,                        /*!< \ref w25q_erase_sector */
+    W25Q_STATS_ERASE_32K,                       /*!< \ref w25q_erase_block_32k */
+    W25Q_STATS_ERASE_64K,                       /*!< \ref w25q_erase_block_64k */
+    W25Q_STATS_ERASE_CHIP,                      /*!< \ref w25q_erase_chip */
+    W25Q_STATS_OP_COUNT,                        /*!< Number of tracked operations */
+} w25q_stats_op_t;
+
+/**
+ * \brief           Statistics of one operation
+ */
+typedef struct {
+    uint32_t count;                             /*!< Completed calls */
+    uint32_t errors;                            /*!< Calls failing on completion wait */
+    uint64_t bytes;                             /*!< Bytes read, programmed or erased */
+    uint64_t busy_us;                           /*!< Time chip reported busy after command */
+    uint32_t latency_max_us;                    /*!< Longest call */
+    uint32_t hist[W25Q_CFG_STATS_BUCKETS];      /*!< Log2 latency histogram in microseconds */
+} w25q_op_stats_t;
+
+/**
+ * \brief           Driver statistics
+ *
+ * Latency covers the whole call. Without `get_time_us` it equals the busy
+ * time, which is measured in steps of the 1 ms status polling interval.
+ */
+typedef struct {
+    w25q_op_stats_t op[W25Q_STATS_OP_COUNT];    /*!< Per operation statistics */
+    uint32_t status_polls;                      /*!< Status register reads while waiting for ready */
+    uint32_t wait_timeouts;                     /*!< Ready waits that timed out */
+    uint32_t wel_failures;                      /*!< Write enable not confirmed by status register */
+} w25q_stats_t;
+
 /**
  * \brief           W25Q device handle structure
  */
@@ -103,6 +350,29 @@ typedef struct {
     w25q_info_t info;                           /*!< Chip information */
     w25q_ll_t ll;                               /*!< Low-level functions */
     uint8_t initialized;                        /*!< Initialization flag */
+    uint8_t mode;                               /*!< Protocol mode, member of \ref w25q_mode_t */
+    uint8_t cont;                               /*!< Continuous read session state */
+    uint8_t wrap;                               /*!< Wrap line size, member of \ref w25q_wrap_t */
+#if W25Q_CFG_HEALTH || __DOXYGEN__
+    w25q_sector_health_t* health;               /*!< Sector health table, `NULL` when not attached */
+    uint32_t health_first;                      /*!< Sector index of first table entry */
+    uint32_t health_count;                      /*!< Number of table entries */
+    uint16_t health_erase_limit;                /*!< Erase time limit in ms */
+    uint32_t health_program_start;              /*!< `get_time_us` at start of page program wait */
+#endif /* W25Q_CFG_HEALTH || __DOXYGEN__ */
+#if W25Q_CFG_LOCK || __DOXYGEN__
+    uint8_t op_busy;                            /*!< Busy class of program or erase waiting with lock released */
+    uint8_t suspended;                          /*!< Erase suspended by current lock holder */
+    uint8_t resume_guard;                       /*!< Owner polls left before erase may be suspended again */
+    uint8_t readers;                            /*!< Readers waiting for program or erase completion */
+    uint8_t ticket_next;                        /*!< Ticket of next writer */
+    uint8_t ticket_serving;                     /*!< Ticket of writer allowed to run */
+    uint32_t op_addr;                           /*!< Start of erase in progress */
+    uint32_t op_size;                           /*!< Size of erase in progress, `0` if it cannot be suspended */
+#endif /* W25Q_CFG_LOCK || __DOXYGEN__ */
+#if W25Q_CFG_STATS || __DOXYGEN__
+    w25q_stats_t stats;                         /*!< Statistics */
+#endif /* W25Q_CFG_STATS || __DOXYGEN__ */
 } w25q_t;
 
 /* Public function prototypes */
@@ -116,10 +386,54 @@ w25q_result_t   w25q_erase_sector(w25q_t* dev, uint32_t address);
 w25q_result_t   w25q_erase_block_32k(w25q_t* dev, uint32_t address);
 w25q_result_t   w25q_erase_block_64k(w25q_t* dev, uint32_t address);
 w25q_result_t   w25q_erase_chip(w25q_t* dev);
+w25q_result_t   w25q_erase_range(w25q_t* dev, uint32_t address, uint32_t len);
 w25q_result_t   w25q_power_down(w25q_t* dev);
 w25q_result_t   w25q_wake_up(w25q_t* dev);
 w25q_result_t   w25q_get_info(w25q_t* dev, w25q_info_t* info);
 uint8_t         w25q_is_busy(w25q_t* dev);
+w25q_result_t   w25q_reset(w25q_t* dev);
+w25q_result_t   w25q_set_mode(w25q_t* dev, w25q_mode_t mode);
+w25q_mode_t     w25q_get_mode(w25q_t* dev);
+
+#if W25Q_CFG_CONT_READ || __DOXYGEN__
+w25q_result_t   w25q_cont_begin(w25q_t* dev);
+w25q_result_t   w25q_cont_read(w25q_t* dev, uint32_t address, uint8_t* data, uint32_t len);
+w25q_result_t   w25q_cont_end(w25q_t* dev);
+#endif /* W25Q_CFG_CONT_READ || __DOXYGEN__ */
+
+#if W25Q_CFG_WRAP || __DOXYGEN__
+w25q_result_t   w25q_set_wrap(w25q_t* dev, w25q_wrap_t wrap);
+w25q_result_t   w25q_read_wrapped(w25q_t* dev, uint32_t address, uint8_t* data, uint32_t len);
+#endif /* W25Q_CFG_WRAP || __DOXYGEN__ */
+
+#if W25Q_CFG_STREAM_CHUNK || __DOXYGEN__
+w25q_result_t   w25q_read_stream(w25q_t* dev, uint32_t address, uint32_t len, w25q_chunk_fn chunk_fn, void* arg);
+#endif /* W25Q_CFG_STREAM_CHUNK || __DOXYGEN__ */
+
+#if (W25Q_CFG_CRC && W25Q_CFG_STREAM_CHUNK) || __DOXYGEN__
+w25q_result_t   w25q_crc32(w25q_t* dev, uint32_t address, uint32_t len, uint32_t* crc);
+#endif /* (W25Q_CFG_CRC && W25Q_CFG_STREAM_CHUNK) || __DOXYGEN__ */
+
+#if W25Q_CFG_VECTOR || __DOXYGEN__
+w25q_result_t   w25q_readv(w25q_t* dev, const w25q_iov_t* iov, uint32_t count);
+w25q_result_t   w25q_writev(w25q_t* dev, const w25q_iov_t* iov, uint32_t count);
+#endif /* W25Q_CFG_VECTOR || __DOXYGEN__ */
+
+#if W25Q_CFG_COPY_BUF || __DOXYGEN__
+w25q_result_t   w25q_copy(w25q_t* dev, uint32_t src, uint32_t dst, uint32_t len, uint8_t erase);
+#endif /* W25Q_CFG_COPY_BUF || __DOXYGEN__ */
+
+#if W25Q_CFG_HEALTH || __DOXYGEN__
+w25q_result_t   w25q_health_attach(w25q_t* dev, w25q_sector_health_t* table, uint32_t first_sector,
+                                   uint32_t count, uint16_t erase_limit_ms);
+w25q_result_t   w25q_health_get(w25q_t* dev, uint32_t address, w25q_sector_health_t* entry);
+uint8_t         w25q_health_is_bad(w25q_t* dev, uint32_t address);
+#endif /* W25Q_CFG_HEALTH || __DOXYGEN__ */
+
+#if W25Q_CFG_STATS || __DOXYGEN__
+w25q_result_t   w25q_stats_get(w25q_t* dev, w25q_stats_t* stats);
+w25q_result_t   w25q_stats_reset(w25q_t* dev);
+#endif /* W25Q_CFG_STATS || __DOXYGEN__ */
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,337 @@
+/**
+ * \file            w25q.hpp
+ * \brief           Header-only C++ wrapper with compile-time chip geometry
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef W25Q_HDR_HPP
+#define W25Q_HDR_HPP
+
+#if __cplusplus < 201703L
+#error "w25q.hpp requires C++17 or newer"
+#endif
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+#include "w25q.h"
+
+namespace w25q {
+
+/**
+ * \brief           Geometry of chip with given JEDEC capacity ID
+ *
+ * Custom chips can be described with a struct providing the same members.
+ */
+template <w25q_type_t Type>
+struct chip_traits {
+    static_assert(Type >= ::W25Q10 && Type <= ::W25Q256, "Unsupported chip type");
+
+    static constexpr w25q_type_t type = Type;                           /*!< Chip type */
+    static constexpr uint32_t capacity = 1UL << static_cast<uint32_t>(Type);    /*!< Capacity in bytes */
+    static constexpr uint32_t page_size = 256;                          /*!< Program page size */
+    static constexpr uint32_t sector_size = 4096;                       /*!< Smallest erase unit */
+    static constexpr uint32_t block_size = 65536;                       /*!< Large erase block */
+    static constexpr uint8_t addr_bytes = (capacity > 16777216UL) ? 4 : 3;  /*!< Address width on bus */
+};
+
+struct W25Q10 : chip_traits<::W25Q10> {};
+struct W25Q20 : chip_traits<::W25Q20> {};
+struct W25Q40 : chip_traits<::W25Q40> {};
+struct W25Q80 : chip_traits<::W25Q80> {};
+struct W25Q16 : chip_traits<::W25Q16> {};
+struct W25Q32 : chip_traits<::W25Q32> {};
+struct W25Q64 : chip_traits<::W25Q64> {};
+struct W25Q128 : chip_traits<::W25Q128> {};
+struct W25Q256 : chip_traits<::W25Q256> {};
+
+} /* namespace w25q */
+
+/**
+ * \brief           W25Q device with geometry fixed at compile time
+ *
+ * Bounds and alignment of addresses given as template arguments are checked
+ * with `static_assert`. Single-line reads are issued directly through the
+ * low-level functions with the address width of the chip, unless statistics
+ * are enabled or `lock` hooks are set. Other operations forward to the C API
+ * and share its health tracking and statistics.
+ *
+ * \code{.cpp}
+ * W25Q<w25q::W25Q128> flash;
+ * std::array<uint8_t, 64> cfg;
+ *
+ * flash.init(ll);
+ * flash.read<0x10000>(cfg);
+ * \endcode
+ *
+ * \tparam          Chip: Chip geometry, one of `w25q::W25Qxx` or custom traits
+ */
+template <typename Chip>
+class W25Q {
+  public:
+    static constexpr uint32_t capacity = Chip::capacity;
+    static constexpr uint32_t page_size = Chip::page_size;
+    static constexpr uint32_t sector_size = Chip::sector_size;
+    static constexpr uint32_t block_size = Chip::block_size;
+    static constexpr uint32_t page_count = capacity / page_size;
+    static constexpr uint32_t sector_count = capacity / sector_size;
+    static constexpr uint32_t block_count = capacity / block_size;
+    static constexpr uint8_t addr_bytes = Chip::addr_bytes;
+
+    static_assert(addr_bytes == 3 || addr_bytes == 4, "Address width must be 3 or 4 bytes");
+    static_assert(addr_bytes == 4 || capacity <= 16777216UL, "Capacity above 16MB needs 4-byte addressing");
+
+    /**
+     * \brief           Initialize device and check it matches `Chip`
+     * \param[in]       ll: Low-level functions
+     * \return          \ref W25Q_OK on success, \ref W25Q_ERR if detected chip differs,
+     *                      member of \ref w25q_result_t otherwise
+     */
+    w25q_result_t
+    init(const w25q_ll_t& ll) {
+        w25q_result_t res = w25q_init(&dev, &ll);
+
+        if (res == W25Q_OK && dev.info.capacity_bytes != capacity) {
+            w25q_deinit(&dev);
+            res = W25Q_ERR;
+        }
+        return res;
+    }
+
+    w25q_result_t
+    deinit() {
+        return w25q_deinit(&dev);
+    }
+
+    /**
+     * \brief           Get underlying C handle for functions not wrapped here
+     * \return          Device handle
+     */
+    w25q_t*
+    handle() {
+        return &dev;
+    }
+
+    /**
+     * \brief           Read data
+     * \param[in]       address: Start address
+     * \param[out]      data: Buffer to store read data
+     * \param[in]       len: Number of bytes to read
+     * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+     */
+    w25q_result_t
+    read(uint32_t address, uint8_t* data, uint32_t len) {
+        if (data == nullptr || len == 0 || address >= capacity || len > capacity - address) {
+            return W25Q_ERR_PARAM;
+        }
+        return prv_read(address, data, len);
+    }
+
+    /**
+     * \brief           Read into array from constant address
+     * \tparam          Address: Start address
+     * \param[out]      data: Buffer to store read data
+     * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+     */
+    template <uint32_t Address, std::size_t N>
+    w25q_result_t
+    read(std::array<uint8_t, N>& data) {
+        static_assert(N > 0 && Address < capacity && N <= capacity - Address, "Read outside of chip");
+        return prv_read(Address, data.data(), static_cast<uint32_t>(N));
+    }
+
+    template <std::size_t N>
+    w25q_result_t
+    read(uint32_t address, std::array<uint8_t, N>& data) {
+        static_assert(N > 0 && N <= capacity, "Read larger than chip");
+        return read(address, data.data(), static_cast<uint32_t>(N));
+    }
+
+    /**
+     * \brief           Program data within one page, target must be erased
+     * \param[in]       address: Start address
+     * \param[in]       data: Data to program
+     * \param[in]       len: Number of bytes, must not cross page boundary
+     * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+     */
+    w25q_result_t
+    write_page(uint32_t address, const uint8_t* data, uint32_t len) {
+        if (len > page_size - (address % page_size) || address >= capacity) {
+            return W25Q_ERR_PARAM;
+        }
+        return w25q_write_page(&dev, address, data, len);
+    }
+
+    /**
+     * \brief           Program array at constant address
+     * \tparam          Address: Start address
+     * \param[in]       data: Data to program, must fit in page of `Address`
+     * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+     */
+    template <uint32_t Address, std::size_t N>
+    w25q_result_t
+    write_page(const std::array<uint8_t, N>& data) {
+        static_assert(Address < capacity, "Write outside of chip");
+        static_assert(N > 0 && N <= page_size - (Address % page_size), "Write crosses page boundary");
+        return w25q_write_page(&dev, Address, data.data(), static_cast<uint32_t>(N));
+    }
+
+    template <std::size_t N>
+    w25q_result_t
+    write_page(uint32_t address, const std::array<uint8_t, N>& data) {
+        static_assert(N > 0 && N <= page_size, "Write larger than page");
+        return write_page(address, data.data(), static_cast<uint32_t>(N));
+    }
+
+#if __cplusplus >= 202002L
+    w25q_result_t
+    read(uint32_t address, std::span<uint8_t> data) {
+        return read(address, data.data(), static_cast<uint32_t>(data.size()));
+    }
+
+    template <uint32_t Address, std::size_t N>
+    w25q_result_t
+    read(std::span<uint8_t, N> data) {
+        static_assert(N != std::dynamic_extent, "Constant address needs fixed extent span");
+        static_assert(N > 0 && Address < capacity && N <= capacity - Address, "Read outside of chip");
+        return prv_read(Address, data.data(), static_cast<uint32_t>(N));
+    }
+
+    w25q_result_t
+    write_page(uint32_t address, std::span<const uint8_t> data) {
+        return write_page(address, data.data(), static_cast<uint32_t>(data.size()));
+    }
+
+    template <uint32_t Address, std::size_t N>
+    w25q_result_t
+    write_page(std::span<const uint8_t, N> data) {
+        static_assert(N != std::dynamic_extent, "Constant address needs fixed extent span");
+        static_assert(Address < capacity, "Write outside of chip");
+        static_assert(N > 0 && N <= page_size - (Address % page_size), "Write crosses page boundary");
+        return w25q_write_page(&dev, Address, data.data(), static_cast<uint32_t>(N));
+    }
+#endif /* __cplusplus >= 202002L */
+
+    w25q_result_t
+    erase_sector(uint32_t address) {
+        return w25q_erase_sector(&dev, address);
+    }
+
+    template <uint32_t Address>
+    w25q_result_t
+    erase_sector() {
+        static_assert(Address < capacity && (Address % sector_size) == 0, "Invalid sector address");
+        return w25q_erase_sector(&dev, Address);
+    }
+
+    w25q_result_t
+    erase_block_32k(uint32_t address) {
+        return w25q_erase_block_32k(&dev, address);
+    }
+
+    template <uint32_t Address>
+    w25q_result_t
+    erase_block_32k() {
+        static_assert(Address < capacity && (Address % 32768UL) == 0, "Invalid 32KB block address");
+        return w25q_erase_block_32k(&dev, Address);
+    }
+
+    w25q_result_t
+    erase_block_64k(uint32_t address) {
+        return w25q_erase_block_64k(&dev, address);
+    }
+
+    template <uint32_t Address>
+    w25q_result_t
+    erase_block_64k() {
+        static_assert(Address < capacity && (Address % block_size) == 0, "Invalid block address");
+        return w25q_erase_block_64k(&dev, Address);
+    }
+
+    w25q_result_t
+    erase_chip() {
+        return w25q_erase_chip(&dev);
+    }
+
+    w25q_result_t
+    power_down() {
+        return w25q_power_down(&dev);
+    }
+
+    w25q_result_t
+    wake_up() {
+        return w25q_wake_up(&dev);
+    }
+
+    bool
+    is_busy() {
+        return w25q_is_busy(&dev) != 0;
+    }
+
+  private:
+    /**
+     * \brief           Read with validated range, address width resolved at compile time
+     */
+    w25q_result_t
+    prv_read(uint32_t address, uint8_t* data, uint32_t len) {
+#if W25Q_CFG_STATS
+        /* Keep statistics complete */
+        return w25q_read(&dev, address, data, len);
+#else
+        uint8_t cmd[1 + addr_bytes];
+        bool ok;
+
+#if W25Q_CFG_LOCK
+        /* Shared device, lock, reader count and erase suspend stay in charge */
+        if (dev.ll.lock != nullptr) {
+            return w25q_read(&dev, address, data, len);
+        }
+#endif /* W25Q_CFG_LOCK */
+        /* Other protocol modes and busy chip are handled by the C implementation */
+        if (dev.mode != W25Q_MODE_SINGLE || w25q_is_busy(&dev)) {
+            return w25q_read(&dev, address, data, len);
+        }
+        cmd[0] = 0x03;
+        for (uint8_t i = 0; i < addr_bytes; ++i) {
+            cmd[1 + i] = static_cast<uint8_t>(address >> (8 * (addr_bytes - 1 - i)));
+        }
+        ok = dev.ll.select() && dev.ll.transmit(cmd, sizeof(cmd)) && dev.ll.receive(data, len);
+        ok = dev.ll.deselect() && ok;
+        return ok ? W25Q_OK : W25Q_ERR;
+#endif /* W25Q_CFG_STATS */
+    }
+
+    w25q_t dev{};                               /*!< C device handle */
+};
+
+#endif /* W25Q_HDR_HPP */
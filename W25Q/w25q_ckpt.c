@@ -0,0 +1,314 @@
+/**
+ * \file            w25q_ckpt.c
+ * \brief           A/B metadata checkpoint implementation
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#include "w25q_ckpt.h"
+#include "w25q_crc.h"
+#include <stddef.h>
+
+/* Checkpoint header layout, stored little-endian in the first page of a slot */
+#define W25Q_CKPT_MAGIC                 0x43353257UL    /* "W25C" */
+#define W25Q_CKPT_HDR_SIZE              24
+#define W25Q_CKPT_OFF_MAGIC             0
+#define W25Q_CKPT_OFF_SEQ               4
+#define W25Q_CKPT_OFF_LEN               8
+#define W25Q_CKPT_OFF_LOG_POS           12
+#define W25Q_CKPT_OFF_DATA_CRC          16
+#define W25Q_CKPT_OFF_HDR_CRC           20
+
+/* Slot index value when no valid checkpoint exists */
+#define W25Q_CKPT_NONE                  0xFF
+
+/**
+ * \brief           Decoded checkpoint header
+ */
+typedef struct {
+    uint32_t seq;                               /*!< Sequence number */
+    uint32_t len;                               /*!< Payload length in bytes */
+    uint32_t log_pos;                           /*!< User log position at save time */
+    uint32_t data_crc;                          /*!< CRC-32 of payload */
+} prv_ckpt_hdr_t;
+
+/**
+ * \brief           Store 32-bit value as little-endian
+ * \param[out]      buf: Output buffer
+ * \param[in]       val: Value to store
+ */
+static void
+prv_put_u32(uint8_t* buf, uint32_t val) {
+    buf[0] = (uint8_t)val;
+    buf[1] = (uint8_t)(val >> 8);
+    buf[2] = (uint8_t)(val >> 16);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
+/**
+ * \brief           Load little-endian 32-bit value
+ * \param[in]       buf: Input buffer
+ * \return          Decoded value
+ */
+static uint32_t
+prv_get_u32(const uint8_t* buf) {
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8)
+           | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/**
+ * \brief           Read and validate header of a slot
+ * \param[in]       ckpt: Checkpoint handle
+ * \param[in]       slot: Slot index
+ * \param[out]      hdr: Decoded header
+ * \return          `1` if header is valid, `0` otherwise
+ */
+static uint8_t
+prv_read_hdr(w25q_ckpt_t* ckpt, uint8_t slot, prv_ckpt_hdr_t* hdr) {
+    uint8_t raw[W25Q_CKPT_HDR_SIZE];
+    uint32_t crc;
+
+    if (w25q_read(ckpt->dev, ckpt->slot_addr[slot], raw, sizeof(raw)) != W25Q_OK) {
+        return 0;
+    }
+    if (prv_get_u32(&raw[W25Q_CKPT_OFF_MAGIC]) != W25Q_CKPT_MAGIC) {
+        return 0;
+    }
+    crc = W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, raw, W25Q_CKPT_OFF_HDR_CRC));
+    if (prv_get_u32(&raw[W25Q_CKPT_OFF_HDR_CRC]) != crc) {
+        return 0;
+    }
+
+    hdr->seq = prv_get_u32(&raw[W25Q_CKPT_OFF_SEQ]);
+    hdr->len = prv_get_u32(&raw[W25Q_CKPT_OFF_LEN]);
+    hdr->log_pos = prv_get_u32(&raw[W25Q_CKPT_OFF_LOG_POS]);
+    hdr->data_crc = prv_get_u32(&raw[W25Q_CKPT_OFF_DATA_CRC]);
+    return hdr->len <= w25q_ckpt_max_size(ckpt);
+}
+
+/**
+ * \brief           Order slots so that the newest valid header comes first
+ * \param[in]       ckpt: Checkpoint handle
+ * \param[out]      order: Slot indexes, newest first, \ref W25Q_CKPT_NONE for invalid
+ * \param[out]      hdr: Decoded headers indexed by slot
+ */
+static void
+prv_order_slots(w25q_ckpt_t* ckpt, uint8_t order[2], prv_ckpt_hdr_t hdr[2]) {
+    uint8_t valid[2];
+
+    valid[0] = prv_read_hdr(ckpt, 0, &hdr[0]);
+    valid[1] = prv_read_hdr(ckpt, 1, &hdr[1]);
+
+    order[0] = order[1] = W25Q_CKPT_NONE;
+    if (valid[0] && valid[1]) {
+        /* Wrap-safe sequence comparison */
+        order[0] = ((int32_t)(hdr[1].seq - hdr[0].seq) > 0) ? 1 : 0;
+        order[1] = order[0] ^ 1;
+    } else if (valid[0]) {
+        order[0] = 0;
+    } else if (valid[1]) {
+        order[0] = 1;
+    }
+}
+
+/**
+ * \brief           Initialize checkpoint handle and locate newest checkpoint header
+ * \note            Payload is not verified here, use \ref w25q_ckpt_load for that
+ * \param[in]       ckpt: Checkpoint handle
+ * \param[in]       dev: Initialized W25Q device handle
+ * \param[in]       slot_a: Start address of slot A (sector-aligned)
+ * \param[in]       slot_b: Start address of slot B (sector-aligned)
+ * \param[in]       slot_size: Size of each slot, multiple of sector size
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_ckpt_init(w25q_ckpt_t* ckpt, w25q_t* dev, uint32_t slot_a, uint32_t slot_b, uint32_t slot_size) {
+    prv_ckpt_hdr_t hdr[2];
+    uint8_t order[2];
+    uint32_t sector_size;
+
+    if (ckpt == NULL || dev == NULL || dev->initialized == 0) {
+        return W25Q_ERR_PARAM;
+    }
+
+    sector_size = dev->info.sector_size;
+    if (slot_size == 0 || (slot_size % sector_size) != 0
+        || (slot_a % sector_size) != 0 || (slot_b % sector_size) != 0) {
+        return W25Q_ERR_PARAM;
+    }
+    /* Both slots end within capacity, sums below cannot wrap */
+    if (slot_size > dev->info.capacity_bytes
+        || slot_a > dev->info.capacity_bytes - slot_size
+        || slot_b > dev->info.capacity_bytes - slot_size
+        || (slot_a < slot_b + slot_size && slot_b < slot_a + slot_size)) {
+        return W25Q_ERR_PARAM;
+    }
+
+    ckpt->dev = dev;
+    ckpt->slot_addr[0] = slot_a;
+    ckpt->slot_addr[1] = slot_b;
+    ckpt->slot_size = slot_size;
+
+    prv_order_slots(ckpt, order, hdr);
+    ckpt->active = order[0];
+    ckpt->seq = (order[0] != W25Q_CKPT_NONE) ? hdr[order[0]].seq : 0;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Load newest valid checkpoint
+ *
+ * If the newest checkpoint payload fails CRC check, the older one is used.
+ * After a successful load the caller replays its log from `log_pos` onwards.
+ *
+ * \param[in]       ckpt: Checkpoint handle
+ * \param[out]      data: Buffer to store checkpoint payload
+ * \param[in]       max_len: Size of `data` buffer
+ * \param[out]      len: Pointer to store payload length
+ * \param[out]      log_pos: Pointer to store log position saved with the checkpoint.
+ *                      Can be set to `NULL` if not used
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR if no valid checkpoint exists,
+ *                      member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_ckpt_load(w25q_ckpt_t* ckpt, void* data, uint32_t max_len, uint32_t* len, uint32_t* log_pos) {
+    prv_ckpt_hdr_t hdr[2];
+    uint8_t order[2], i, slot;
+    uint32_t crc;
+
+    if (ckpt == NULL || ckpt->dev == NULL || data == NULL || len == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+
+    prv_order_slots(ckpt, order, hdr);
+    for (i = 0; i < 2 && order[i] != W25Q_CKPT_NONE; ++i) {
+        slot = order[i];
+        if (hdr[slot].len > max_len) {
+            return W25Q_ERR_PARAM;
+        }
+        if (hdr[slot].len > 0) {
+            if (w25q_read(ckpt->dev, ckpt->slot_addr[slot] + ckpt->dev->info.page_size,
+                          data, hdr[slot].len) != W25Q_OK) {
+                continue;
+            }
+        }
+        crc = W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, data, hdr[slot].len));
+        if (crc != hdr[slot].data_crc) {
+            continue;
+        }
+
+        ckpt->active = slot;
+        ckpt->seq = hdr[slot].seq;
+        *len = hdr[slot].len;
+        if (log_pos != NULL) {
+            *log_pos = hdr[slot].log_pos;
+        }
+        return W25Q_OK;
+    }
+
+    ckpt->active = W25Q_CKPT_NONE;
+    return W25Q_ERR;
+}
+
+/**
+ * \brief           Write new checkpoint to the inactive slot
+ *
+ * Only sectors covering the new checkpoint are erased. Header is programmed
+ * last and commits the checkpoint.
+ *
+ * \param[in]       ckpt: Checkpoint handle
+ * \param[in]       data: Payload to store (indexes, bitmaps, write heads, ...)
+ * \param[in]       len: Payload length, max \ref w25q_ckpt_max_size bytes
+ * \param[in]       log_pos: Position of user log at snapshot time, returned on load
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_ckpt_save(w25q_ckpt_t* ckpt, const void* data, uint32_t len, uint32_t log_pos) {
+    uint8_t raw[W25Q_CKPT_HDR_SIZE];
+    const uint8_t* src = data;
+    uint32_t base, page_size, sector_size, off, chunk, seq;
+    uint8_t slot;
+    w25q_result_t res;
+
+    if (ckpt == NULL || ckpt->dev == NULL || (data == NULL && len > 0)
+        || len > w25q_ckpt_max_size(ckpt)) {
+        return W25Q_ERR_PARAM;
+    }
+
+    slot = (ckpt->active == 0) ? 1 : 0;
+    seq = (ckpt->active == W25Q_CKPT_NONE) ? 1 : (ckpt->seq + 1);
+    base = ckpt->slot_addr[slot];
+    page_size = ckpt->dev->info.page_size;
+    sector_size = ckpt->dev->info.sector_size;
+
+    /* Erase only what the new checkpoint occupies */
+    for (off = 0; off < page_size + len; off += sector_size) {
+        if ((res = w25q_erase_sector(ckpt->dev, base + off)) != W25Q_OK) {
+            return res;
+        }
+    }
+
+    /* Payload goes first, page after header */
+    for (off = 0; off < len; off += chunk) {
+        chunk = (len - off) > page_size ? page_size : (len - off);
+        if ((res = w25q_write_page(ckpt->dev, base + page_size + off, &src[off], chunk)) != W25Q_OK) {
+            return res;
+        }
+    }
+
+    /* Header commits the checkpoint */
+    prv_put_u32(&raw[W25Q_CKPT_OFF_MAGIC], W25Q_CKPT_MAGIC);
+    prv_put_u32(&raw[W25Q_CKPT_OFF_SEQ], seq);
+    prv_put_u32(&raw[W25Q_CKPT_OFF_LEN], len);
+    prv_put_u32(&raw[W25Q_CKPT_OFF_LOG_POS], log_pos);
+    prv_put_u32(&raw[W25Q_CKPT_OFF_DATA_CRC],
+                W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, src, len)));
+    prv_put_u32(&raw[W25Q_CKPT_OFF_HDR_CRC],
+                W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, raw, W25Q_CKPT_OFF_HDR_CRC)));
+    if ((res = w25q_write_page(ckpt->dev, base, raw, sizeof(raw))) != W25Q_OK) {
+        return res;
+    }
+
+    ckpt->active = slot;
+    ckpt->seq = seq;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Get maximum checkpoint payload size
+ * \param[in]       ckpt: Checkpoint handle
+ * \return          Maximum payload size in bytes
+ */
+uint32_t
+w25q_ckpt_max_size(const w25q_ckpt_t* ckpt) {
+    if (ckpt == NULL || ckpt->dev == NULL) {
+        return 0;
+    }
+    return ckpt->slot_size - ckpt->dev->info.page_size;
+}
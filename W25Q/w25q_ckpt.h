@@ -0,0 +1,69 @@
+/**
+ * \file            w25q_ckpt.h
+ * \brief           A/B metadata checkpoint for W25Q flash library
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef W25Q_CKPT_HDR_H
+#define W25Q_CKPT_HDR_H
+
+#include <stdint.h>
+#include "w25q.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           Checkpoint handle
+ *
+ * Two equally sized slots are used in A/B fashion. A new checkpoint is always
+ * written to the slot that does not hold the newest valid one, so a power
+ * loss during save leaves the previous checkpoint intact.
+ */
+typedef struct {
+    w25q_t* dev;                                /*!< Flash device */
+    uint32_t slot_addr[2];                      /*!< Slot A/B start addresses (sector-aligned) */
+    uint32_t slot_size;                         /*!< Size of each slot in bytes (multiple of sector size) */
+    uint32_t seq;                               /*!< Sequence number of newest valid checkpoint */
+    uint8_t active;                             /*!< Slot index with newest valid checkpoint, `0xFF` if none */
+} w25q_ckpt_t;
+
+/* Public function prototypes */
+w25q_result_t   w25q_ckpt_init(w25q_ckpt_t* ckpt, w25q_t* dev, uint32_t slot_a, uint32_t slot_b, uint32_t slot_size);
+w25q_result_t   w25q_ckpt_load(w25q_ckpt_t* ckpt, void* data, uint32_t max_len, uint32_t* len, uint32_t* log_pos);
+w25q_result_t   w25q_ckpt_save(w25q_ckpt_t* ckpt, const void* data, uint32_t len, uint32_t log_pos);
+uint32_t        w25q_ckpt_max_size(const w25q_ckpt_t* ckpt);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* W25Q_CKPT_HDR_H */
@@ -0,0 +1,69 @@
+/**
+ * \file            w25q_crc.h
+ * \brief           CRC-32 helper for W25Q flash library
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef W25Q_CRC_HDR_H
+#define W25Q_CRC_HDR_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           Enables `1` or disables `0` slicing-by-4 lookup tables
+ *
+ * Tables take 4 KB of constant data and process four bytes per step.
+ * Disabled, CRC is computed bit by bit without tables.
+ */
+#ifndef W25Q_CFG_CRC_SLICING
+#define W25Q_CFG_CRC_SLICING            1
+#endif
+
+/**
+ * \brief           Initial value for \ref w25q_crc32_update
+ */
+#define W25Q_CRC32_INIT                 0xFFFFFFFFUL
+
+/**
+ * \brief           Finalize CRC-32 value returned by \ref w25q_crc32_update
+ */
+#define W25Q_CRC32_FINAL(crc)           ((uint32_t)((crc) ^ 0xFFFFFFFFUL))
+
+uint32_t        w25q_crc32_update(uint32_t crc, const void* data, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* W25Q_CRC_HDR_H */
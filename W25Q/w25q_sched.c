@@ -0,0 +1,346 @@
+/**
+ * \file            w25q_sched.c
+ * \brief           Elevator I/O scheduler implementation
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#include "w25q_sched.h"
+#include <stddef.h>
+
+#if W25Q_CFG_VECTOR || __DOXYGEN__
+
+/* Request kinds for \ref prv_find */
+#define W25Q_SCHED_ERASE                0
+#define W25Q_SCHED_WRITE                1
+#define W25Q_SCHED_ANY                  2
+
+/**
+ * \brief           Take device mutex for queue access
+ * \param[in]       sched: Scheduler handle
+ * \return          `1` on success, `0` on lock timeout
+ */
+static uint8_t
+prv_lock(w25q_sched_t* sched) {
+#if W25Q_CFG_LOCK
+    if (sched->dev->ll.lock != NULL) {
+        return sched->dev->ll.lock();
+    }
+#else
+    (void)sched;
+#endif /* W25Q_CFG_LOCK */
+    return 1;
+}
+
+/**
+ * \brief           Release device mutex taken with \ref prv_lock
+ * \param[in]       sched: Scheduler handle
+ */
+static void
+prv_unlock(w25q_sched_t* sched) {
+#if W25Q_CFG_LOCK
+    if (sched->dev->ll.lock != NULL) {
+        sched->dev->ll.unlock();
+    }
+#else
+    (void)sched;
+#endif /* W25Q_CFG_LOCK */
+}
+
+/**
+ * \brief           Queue request
+ * \param[in]       sched: Scheduler handle
+ * \param[in]       req: Request to copy into queue, `seq` and `batch` are set here
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR_BUSY if queue is full or lock timed out
+ */
+static w25q_result_t
+prv_submit(w25q_sched_t* sched, const w25q_sched_req_t* req) {
+    w25q_result_t res = W25Q_ERR_BUSY;
+
+    if (!prv_lock(sched)) {
+        return W25Q_ERR_BUSY;
+    }
+    if (sched->count < W25Q_SCHED_MAX_REQS) {
+        sched->reqs[sched->count] = *req;
+        sched->reqs[sched->count].seq = sched->seq++;
+        sched->reqs[sched->count].batch = 0;
+        sched->count++;
+        res = W25Q_OK;
+    }
+    prv_unlock(sched);
+    return res;
+}
+
+/**
+ * \brief           Check if request may run now
+ *
+ * Writes and erases do not commute, a request waits for every earlier
+ * request it overlaps. The oldest request is always ready.
+ *
+ * \param[in]       sched: Scheduler handle
+ * \param[in]       idx: Request index
+ * \return          `1` if no earlier request overlaps it, `0` otherwise
+ */
+static uint8_t
+prv_ready(w25q_sched_t* sched, uint32_t idx) {
+    const w25q_sched_req_t* r = &sched->reqs[idx];
+    const w25q_sched_req_t* o;
+    uint32_t i;
+
+    for (i = 0; i < sched->count; ++i) {
+        o = &sched->reqs[i];
+        if (i != idx && (int32_t)(o->seq - r->seq) < 0 && o->address < r->address + r->len
+            && r->address < o->address + o->len) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * \brief           Find ready request with lowest start address in range
+ * \param[in]       sched: Scheduler handle
+ * \param[in]       kind: `W25Q_SCHED_ERASE`, `W25Q_SCHED_WRITE` or `W25Q_SCHED_ANY`
+ * \param[in]       from: Lowest start address
+ * \param[in]       to: Highest start address
+ * \return          Request index, `sched->count` if none
+ */
+static uint32_t
+prv_find(w25q_sched_t* sched, uint8_t kind, uint32_t from, uint32_t to) {
+    const w25q_sched_req_t* r;
+    uint32_t best = sched->count, i;
+
+    for (i = 0; i < sched->count; ++i) {
+        r = &sched->reqs[i];
+        if (r->batch || r->address < from || r->address > to
+            || (kind != W25Q_SCHED_ANY && kind != (r->data != NULL))) {
+            continue;
+        }
+        if ((best == sched->count || r->address < sched->reqs[best].address) && prv_ready(sched, i)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * \brief           Remove requests of the finished batch
+ * \param[in]       sched: Scheduler handle
+ */
+static void
+prv_remove_batch(w25q_sched_t* sched) {
+    uint32_t i;
+
+    for (i = 0; i < sched->count;) {
+        if (sched->reqs[i].batch) {
+            sched->reqs[i] = sched->reqs[--sched->count];
+        } else {
+            ++i;
+        }
+    }
+}
+
+/**
+ * \brief           Initialize scheduler
+ * \param[in]       sched: Scheduler handle
+ * \param[in]       dev: Initialized flash device
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_sched_init(w25q_sched_t* sched, w25q_t* dev) {
+    if (sched == NULL || dev == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+    sched->dev = dev;
+    sched->head = 0;
+    sched->seq = 0;
+    sched->count = 0;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Queue write request
+ *
+ * Nothing is sent to the chip until \ref w25q_sched_run. The region must be
+ * erased, or queued for erase before this request.
+ *
+ * \param[in]       sched: Scheduler handle
+ * \param[in]       address: Flash address
+ * \param[in]       data: Data to write, must stay valid until `done` is called
+ * \param[in]       len: Number of bytes, no alignment needed
+ * \param[in]       done: Completion callback, may be `NULL`
+ * \param[in]       arg: Callback argument
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR_BUSY if queue is full,
+ *                  member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_sched_write(w25q_sched_t* sched, uint32_t address, const uint8_t* data, uint32_t len,
+                 w25q_sched_done_fn done, void* arg) {
+    w25q_sched_req_t req = {address, len, data, done, arg, 0, 0};
+
+    if (sched == NULL || sched->dev == NULL || data == NULL || len == 0) {
+        return W25Q_ERR_PARAM;
+    }
+    if (len > sched->dev->info.capacity_bytes || address > sched->dev->info.capacity_bytes - len) {
+        return W25Q_ERR_PARAM;
+    }
+    return prv_submit(sched, &req);
+}
+
+/**
+ * \brief           Queue erase request
+ * \param[in]       sched: Scheduler handle
+ * \param[in]       address: Sector-aligned start address
+ * \param[in]       len: Number of bytes, multiple of sector size
+ * \param[in]       done: Completion callback, may be `NULL`
+ * \param[in]       arg: Callback argument
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR_BUSY if queue is full,
+ *                  member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_sched_erase(w25q_sched_t* sched, uint32_t address, uint32_t len, w25q_sched_done_fn done, void* arg) {
+    w25q_sched_req_t req = {address, len, NULL, done, arg, 0, 0};
+
+    if (sched == NULL || sched->dev == NULL || len == 0) {
+        return W25Q_ERR_PARAM;
+    }
+    if ((address % sched->dev->info.sector_size) != 0 || (len % sched->dev->info.sector_size) != 0
+        || len > sched->dev->info.capacity_bytes || address > sched->dev->info.capacity_bytes - len) {
+        return W25Q_ERR_PARAM;
+    }
+    return prv_submit(sched, &req);
+}
+
+/**
+ * \brief           Execute all queued requests
+ *
+ * Requests are taken in one-way sweeps by start address, continuing after
+ * the previous batch. Each batch is one device call:
+ * - writes starting at or inside the page where the previous one ended go to
+ *   one \ref w25q_writev, which sends each page as a single program
+ * - erases continuing each other's range go to one \ref w25q_erase_range,
+ *   which uses 32KB and 64KB block erases where the union covers them
+ *
+ * Every request of a batch gets the batch result. Callbacks run without the
+ * device mutex, slots are freed after the callbacks of a batch returned.
+ * Requests submitted meanwhile are served by the same call.
+ *
+ * \note            Only one task may call this function at a time
+ * \param[in]       sched: Scheduler handle
+ * \return          \ref W25Q_OK if all batches succeeded, \ref W25Q_ERR_BUSY on lock timeout,
+ *                  result of last failed batch otherwise
+ */
+w25q_result_t
+w25q_sched_run(w25q_sched_t* sched) {
+    w25q_iov_t iov[W25Q_SCHED_MAX_REQS];
+    w25q_sched_req_t* r;
+    w25q_result_t res, last = W25Q_OK;
+    uint32_t i, n, count, start, end, to;
+    uint8_t kind;
+
+    if (sched == NULL || sched->dev == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+
+    for (;;) {
+        if (!prv_lock(sched)) {
+            return W25Q_ERR_BUSY;
+        }
+        prv_remove_batch(sched);
+
+        /* Continue sweep, start over from lowest address at the end */
+        if ((i = prv_find(sched, W25Q_SCHED_ANY, sched->head, UINT32_MAX)) == sched->count) {
+            i = prv_find(sched, W25Q_SCHED_ANY, 0, UINT32_MAX);
+        }
+        if (i == sched->count) {
+            prv_unlock(sched);
+            break;
+        }
+
+        kind = (sched->reqs[i].data != NULL) ? W25Q_SCHED_WRITE : W25Q_SCHED_ERASE;
+        start = sched->reqs[i].address;
+        n = 0;
+        do {
+            r = &sched->reqs[i];
+            r->batch = 1;
+            iov[n].address = r->address;
+            iov[n].data = (uint8_t*)r->data;    /* Only read by w25q_writev */
+            iov[n].len = r->len;
+            n++;
+            end = r->address + r->len;
+
+            /* Erases must continue the range, writes may start anywhere in the last page */
+            to = end;
+            if (kind == W25Q_SCHED_WRITE && (end % sched->dev->info.page_size) != 0) {
+                to = end + sched->dev->info.page_size - (end % sched->dev->info.page_size) - 1;
+            }
+        } while ((i = prv_find(sched, kind, end, to)) != sched->count);
+        count = sched->count;
+        prv_unlock(sched);
+
+        if (kind == W25Q_SCHED_WRITE) {
+            res = w25q_writev(sched->dev, iov, n);
+        } else {
+            res = w25q_erase_range(sched->dev, start, end - start);
+        }
+        sched->head = end;
+        if (res != W25Q_OK) {
+            last = res;
+        }
+
+        /* Batch slots stay in place until next lock, later submits only append */
+        for (i = 0; i < count; ++i) {
+            if (sched->reqs[i].batch && sched->reqs[i].done != NULL) {
+                sched->reqs[i].done(sched->reqs[i].arg, res);
+            }
+        }
+    }
+    return last;
+}
+
+/**
+ * \brief           Get number of requests not yet executed
+ * \param[in]       sched: Scheduler handle
+ * \return          Number of waiting requests
+ */
+uint32_t
+w25q_sched_pending(w25q_sched_t* sched) {
+    uint32_t n = 0, i;
+
+    if (sched == NULL || !prv_lock(sched)) {
+        return 0;
+    }
+    for (i = 0; i < sched->count; ++i) {
+        n += !sched->reqs[i].batch;
+    }
+    prv_unlock(sched);
+    return n;
+}
+
+#endif /* W25Q_CFG_VECTOR || __DOXYGEN__ */
@@ -0,0 +1,98 @@
+/**
+ * \file            w25q_sched.h
+ * \brief           Elevator I/O scheduler for W25Q flash library
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef W25Q_SCHED_HDR_H
+#define W25Q_SCHED_HDR_H
+
+#include <stdint.h>
+#include "w25q.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           Maximum number of queued requests
+ */
+#ifndef W25Q_SCHED_MAX_REQS
+#define W25Q_SCHED_MAX_REQS             16
+#endif
+
+/**
+ * \brief           Completion callback of a queued request
+ * \param[in]       arg: User argument passed at submit
+ * \param[in]       res: Result of the command the request was merged into
+ */
+typedef void (*w25q_sched_done_fn)(void* arg, w25q_result_t res);
+
+/**
+ * \brief           Queued write or erase request
+ */
+typedef struct {
+    uint32_t address;                           /*!< Flash address */
+    uint32_t len;                               /*!< Number of bytes */
+    const uint8_t* data;                        /*!< Write data, `NULL` for erase */
+    w25q_sched_done_fn done;                    /*!< Completion callback, may be `NULL` */
+    void* arg;                                  /*!< Callback argument */
+    uint32_t seq;                               /*!< Submit order */
+    uint8_t batch;                              /*!< Set to `1` while part of the running batch */
+} w25q_sched_req_t;
+
+/**
+ * \brief           Scheduler handle
+ *
+ * Requests are served in one-way sweeps by address. A request waits for all
+ * earlier requests overlapping it, so reordering never changes flash content.
+ */
+typedef struct {
+    w25q_t* dev;                                /*!< Flash device */
+    uint32_t head;                              /*!< Sweep position, end of last batch */
+    uint32_t seq;                               /*!< Next submit order number */
+    uint32_t count;                             /*!< Number of queued requests */
+    w25q_sched_req_t reqs[W25Q_SCHED_MAX_REQS]; /*!< Queued requests, unordered */
+} w25q_sched_t;
+
+/* Public function prototypes */
+w25q_result_t   w25q_sched_init(w25q_sched_t* sched, w25q_t* dev);
+w25q_result_t   w25q_sched_write(w25q_sched_t* sched, uint32_t address, const uint8_t* data, uint32_t len,
+                                 w25q_sched_done_fn done, void* arg);
+w25q_result_t   w25q_sched_erase(w25q_sched_t* sched, uint32_t address, uint32_t len,
+                                 w25q_sched_done_fn done, void* arg);
+w25q_result_t   w25q_sched_run(w25q_sched_t* sched);
+uint32_t        w25q_sched_pending(w25q_sched_t* sched);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* W25Q_SCHED_HDR_H */
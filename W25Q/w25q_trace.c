@@ -0,0 +1,359 @@
+/**
+ * \file            w25q_trace.c
+ * \brief           SPI transaction trace ring buffer implementation
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#include "w25q_trace.h"
+#include "w25q_crc.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Export stream layout, all values little-endian */
+#define W25Q_TRACE_MAGIC                0x52353257UL    /* "W25R" */
+#define W25Q_TRACE_VERSION              2
+#define W25Q_TRACE_HDR_SIZE             16
+
+/* Header bytes kept in `addr`, and limit of `hdr_len` */
+#define W25Q_TRACE_ADDR_BYTES           4
+#define W25Q_TRACE_MAX_HDR              0x7F
+
+/* Trace receiving low-level calls */
+static w25q_trace_t* trace_active;
+
+/**
+ * \brief           Store 32-bit value as little-endian
+ * \param[out]      buf: Output buffer
+ * \param[in]       val: Value to store
+ */
+static void
+prv_put_u32(uint8_t* buf, uint32_t val) {
+    buf[0] = (uint8_t)val;
+    buf[1] = (uint8_t)(val >> 8);
+    buf[2] = (uint8_t)(val >> 16);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
+/**
+ * \brief           Get timestamp from original low-level functions
+ * \param[in]       trace: Trace handle
+ * \return          Time in microseconds, `0` if port has no time source
+ */
+static uint32_t
+prv_now(w25q_trace_t* trace) {
+    return (trace->ll.get_time_us != NULL) ? trace->ll.get_time_us() : 0;
+}
+
+/**
+ * \brief           Check if transaction starts without opcode
+ *
+ * Continuous read mode skips the opcode, the address goes out on the wider
+ * address lines right after select. Only QPI sends opcodes on more lines.
+ *
+ * \param[in]       trace: Trace handle
+ * \return          `1` if first header byte is not an opcode, `0` otherwise
+ */
+static uint8_t
+prv_no_opcode(const w25q_trace_t* trace) {
+    return trace->lines > 1 && trace->dev->mode != W25Q_MODE_QPI;
+}
+
+/**
+ * \brief           Account transferred bytes to open record
+ * \param[in]       tx: Transmitted data, `NULL` for receive only
+ * \param[in]       len: Number of bytes
+ */
+static void
+prv_account(const uint8_t* tx, uint32_t len) {
+    w25q_trace_rec_t* rec;
+    uint32_t i = 0;
+    uint8_t hdr, skip;
+
+    if (!trace_active->open || len == 0) {
+        return;
+    }
+    rec = &trace_active->recs[trace_active->head];
+    if (tx != NULL && (rec->hdr_len == 0 || trace_active->hdr_cont)) {
+        if (rec->hdr_len == 0) {
+            if (prv_no_opcode(trace_active)) {
+                rec->hdr_len = W25Q_TRACE_HDR_NO_OPCODE;
+            } else {
+                rec->opcode = tx[i++];
+                rec->hdr_len = 1;
+            }
+        }
+        hdr = rec->hdr_len & (uint8_t)~W25Q_TRACE_HDR_NO_OPCODE;
+        skip = (rec->hdr_len & W25Q_TRACE_HDR_NO_OPCODE) ? 0 : 1;
+        for (; i < len && hdr < W25Q_TRACE_MAX_HDR; ++i, ++hdr) {
+            if (hdr < skip + W25Q_TRACE_ADDR_BYTES) {
+                rec->addr = (rec->addr << 8) | tx[i];
+            }
+        }
+        rec->hdr_len = (uint8_t)((rec->hdr_len & W25Q_TRACE_HDR_NO_OPCODE) | hdr);
+        len -= i;
+    }
+    trace_active->hdr_cont = 0;
+    rec->len += len;
+}
+
+static uint8_t
+prv_select(void) {
+    w25q_trace_t* trace = trace_active;
+
+    if (trace->enabled) {
+        memset(&trace->recs[trace->head], 0, sizeof(trace->recs[0]));
+        trace->recs[trace->head].time_us = prv_now(trace);
+        trace->open = 1;
+        trace->hdr_cont = 0;
+    }
+    return trace->ll.select();
+}
+
+static uint8_t
+prv_deselect(void) {
+    w25q_trace_t* trace = trace_active;
+    w25q_trace_rec_t* rec;
+    uint32_t dur;
+    uint8_t res;
+
+    res = trace->ll.deselect();
+    if (trace->open) {
+        rec = &trace->recs[trace->head];
+        dur = prv_now(trace) - rec->time_us;
+        rec->dur_us = (uint16_t)((dur > 0xFFFF) ? 0xFFFF : dur);
+        trace->open = 0;
+        trace->head = (trace->head + 1) % trace->size;
+        if (trace->count < trace->size) {
+            trace->count++;
+        } else {
+            trace->dropped++;
+        }
+    }
+    return res;
+}
+
+static uint8_t
+prv_set_lines(uint8_t lines) {
+    w25q_trace_t* trace = trace_active;
+    const w25q_trace_rec_t* rec = &trace->recs[trace->head];
+
+    /* Opcode on one line, address on more: address phase is a separate transmit */
+    if (trace->open && rec->hdr_len == 1 && rec->len == 0) {
+        trace->hdr_cont = 1;
+    }
+    trace->lines = lines;
+    return trace->ll.set_lines(lines);
+}
+
+static uint8_t
+prv_transmit(const uint8_t* data, uint32_t len) {
+    prv_account(data, len);
+    return trace_active->ll.transmit(data, len);
+}
+
+static uint8_t
+prv_receive(uint8_t* data, uint32_t len) {
+    prv_account(NULL, len);
+    return trace_active->ll.receive(data, len);
+}
+
+static uint8_t
+prv_transmit_receive(const uint8_t* tx_data, uint8_t* rx_data, uint32_t len) {
+    prv_account(tx_data, len);
+    return trace_active->ll.transmit_receive(tx_data, rx_data, len);
+}
+
+/**
+ * \brief           Initialize trace handle
+ * \param[in]       trace: Trace handle
+ * \param[in]       recs: Record ring storage
+ * \param[in]       size: Number of records in `recs`
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_trace_init(w25q_trace_t* trace, w25q_trace_rec_t* recs, uint32_t size) {
+    if (trace == NULL || recs == NULL || size == 0) {
+        return W25Q_ERR_PARAM;
+    }
+
+    memset(trace, 0, sizeof(*trace));
+    trace->recs = recs;
+    trace->size = size;
+    trace->enabled = 1;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Start tracing device by interposing its low-level functions
+ * \param[in]       trace: Trace handle
+ * \param[in]       dev: Initialized W25Q device handle
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR_BUSY if a trace is already attached
+ */
+w25q_result_t
+w25q_trace_attach(w25q_trace_t* trace, w25q_t* dev) {
+    if (trace == NULL || dev == NULL || trace->recs == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+    if (trace_active != NULL) {
+        return W25Q_ERR_BUSY;
+    }
+
+    trace->dev = dev;
+    trace->ll = dev->ll;
+    trace->open = 0;
+    trace->lines = (dev->mode == W25Q_MODE_QPI) ? 4 : 1;
+    trace_active = trace;
+
+    dev->ll.select = prv_select;
+    dev->ll.deselect = prv_deselect;
+    dev->ll.transmit = prv_transmit;
+    dev->ll.receive = prv_receive;
+    if (dev->ll.transmit_receive != NULL) {
+        dev->ll.transmit_receive = prv_transmit_receive;
+    }
+    if (dev->ll.set_lines != NULL) {
+        dev->ll.set_lines = prv_set_lines;
+    }
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Stop tracing and restore original low-level functions
+ * \param[in]       trace: Trace handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_trace_detach(w25q_trace_t* trace) {
+    if (trace == NULL || trace != trace_active) {
+        return W25Q_ERR_PARAM;
+    }
+
+    trace->dev->ll = trace->ll;
+    trace->dev = NULL;
+    trace_active = NULL;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Pause or resume recording
+ * \param[in]       trace: Trace handle
+ * \param[in]       enable: `1` to record, `0` to pause
+ */
+void
+w25q_trace_enable(w25q_trace_t* trace, uint8_t enable) {
+    if (trace != NULL) {
+        trace->enabled = enable ? 1 : 0;
+    }
+}
+
+/**
+ * \brief           Discard all records
+ * \param[in]       trace: Trace handle
+ */
+void
+w25q_trace_clear(w25q_trace_t* trace) {
+    if (trace != NULL) {
+        trace->head = 0;
+        trace->count = 0;
+        trace->dropped = 0;
+        trace->open = 0;
+    }
+}
+
+/**
+ * \brief           Export records, oldest first, in binary format
+ *
+ * Stream layout, all values little-endian:
+ * - Header: magic `W25R`, version (1 byte), record size (1 byte), 2 reserved bytes,
+ *   record count, dropped record count
+ * - Records of \ref W25Q_TRACE_REC_SIZE bytes: time_us, addr, len, dur_us (2 bytes),
+ *   opcode, hdr_len with \ref W25Q_TRACE_HDR_NO_OPCODE flag
+ * - CRC-32 of header and records
+ *
+ * Recording is paused while exporting. Call from the context using the device.
+ *
+ * \param[in]       trace: Trace handle
+ * \param[in]       fn: Output function
+ * \param[in]       arg: User argument passed to `fn`
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_trace_export(w25q_trace_t* trace, w25q_trace_write_fn fn, void* arg) {
+    uint8_t buf[W25Q_TRACE_HDR_SIZE], enabled;
+    uint32_t crc, idx, i;
+    const w25q_trace_rec_t* rec;
+    w25q_result_t res = W25Q_OK;
+
+    if (trace == NULL || fn == NULL || trace->recs == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+
+    enabled = trace->enabled;
+    trace->enabled = 0;
+
+    prv_put_u32(&buf[0], W25Q_TRACE_MAGIC);
+    buf[4] = W25Q_TRACE_VERSION;
+    buf[5] = W25Q_TRACE_REC_SIZE;
+    buf[6] = 0;
+    buf[7] = 0;
+    prv_put_u32(&buf[8], trace->count);
+    prv_put_u32(&buf[12], trace->dropped);
+    crc = w25q_crc32_update(W25Q_CRC32_INIT, buf, W25Q_TRACE_HDR_SIZE);
+    if (!fn(buf, W25Q_TRACE_HDR_SIZE, arg)) {
+        res = W25Q_ERR;
+    }
+
+    idx = (trace->head + trace->size - trace->count) % trace->size;
+    for (i = 0; i < trace->count && res == W25Q_OK; ++i) {
+        rec = &trace->recs[idx];
+        prv_put_u32(&buf[0], rec->time_us);
+        prv_put_u32(&buf[4], rec->addr);
+        prv_put_u32(&buf[8], rec->len);
+        buf[12] = (uint8_t)rec->dur_us;
+        buf[13] = (uint8_t)(rec->dur_us >> 8);
+        buf[14] = rec->opcode;
+        buf[15] = rec->hdr_len;
+        crc = w25q_crc32_update(crc, buf, W25Q_TRACE_REC_SIZE);
+        if (!fn(buf, W25Q_TRACE_REC_SIZE, arg)) {
+            res = W25Q_ERR;
+        }
+        idx = (idx + 1) % trace->size;
+    }
+
+    if (res == W25Q_OK) {
+        prv_put_u32(&buf[0], W25Q_CRC32_FINAL(crc));
+        if (!fn(buf, 4, arg)) {
+            res = W25Q_ERR;
+        }
+    }
+
+    trace->enabled = enabled;
+    return res;
+}
@@ -0,0 +1,118 @@
+/**
+ * \file            w25q_trace.h
+ * \brief           SPI transaction trace ring buffer
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef W25Q_TRACE_HDR_H
+#define W25Q_TRACE_HDR_H
+
+#include <stdint.h>
+#include "w25q.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           Size of one exported trace record in bytes
+ */
+#define W25Q_TRACE_REC_SIZE             16
+
+/**
+ * \brief           Flag in `hdr_len` of a transaction without opcode
+ *
+ * Set for continuous read transactions, which start with the address
+ * directly. `opcode` is `0` and `addr` holds the first header bytes.
+ */
+#define W25Q_TRACE_HDR_NO_OPCODE        0x80
+
+/**
+ * \brief           One chip select transaction
+ *
+ * The first transmit after select is the command header: opcode followed by
+ * address, mode and dummy bytes, if any. When the opcode goes out alone and
+ * the bus width changes before the next transmit (dual and quad I/O reads),
+ * that transmit belongs to the header as well. A first transmit on more
+ * than one line outside QPI mode has no opcode and is marked with
+ * \ref W25Q_TRACE_HDR_NO_OPCODE. All further bytes are counted in `len`.
+ */
+typedef struct {
+    uint32_t time_us;                           /*!< Select time from `get_time_us` */
+    uint32_t addr;                              /*!< First 4 header bytes after opcode, big-endian as sent */
+    uint32_t len;                               /*!< Data bytes transferred after header */
+    uint16_t dur_us;                            /*!< Select to deselect time, saturating */
+    uint8_t opcode;                             /*!< Command opcode, `0` without opcode */
+    uint8_t hdr_len;                            /*!< Header length including opcode, \ref W25Q_TRACE_HDR_NO_OPCODE flag */
+} w25q_trace_rec_t;
+
+/**
+ * \brief           Function writing exported trace data
+ * \param[in]       data: Data to write
+ * \param[in]       len: Number of bytes
+ * \param[in]       arg: User argument
+ * \return          `1` on success, `0` otherwise
+ */
+typedef uint8_t (*w25q_trace_write_fn)(const void* data, uint32_t len, void* arg);
+
+/**
+ * \brief           Trace handle
+ *
+ * Records live in a caller provided ring, oldest records are overwritten.
+ * Low-level callbacks have no context argument, so only one trace can be
+ * attached at a time.
+ */
+typedef struct {
+    w25q_t* dev;                                /*!< Traced device, `NULL` when detached */
+    w25q_ll_t ll;                               /*!< Original low-level functions */
+    w25q_trace_rec_t* recs;                     /*!< Record ring */
+    uint32_t size;                              /*!< Ring size in records */
+    uint32_t head;                              /*!< Next record index */
+    uint32_t count;                             /*!< Valid records in ring */
+    uint32_t dropped;                           /*!< Records overwritten since clear */
+    uint8_t enabled;                            /*!< Recording enabled */
+    uint8_t open;                               /*!< Chip is selected, record at `head` is open */
+    uint8_t lines;                              /*!< Current bus lines, from `set_lines` */
+    uint8_t hdr_cont;                           /*!< Next transmit continues header after lone opcode */
+} w25q_trace_t;
+
+/* Public function prototypes */
+w25q_result_t   w25q_trace_init(w25q_trace_t* trace, w25q_trace_rec_t* recs, uint32_t size);
+w25q_result_t   w25q_trace_attach(w25q_trace_t* trace, w25q_t* dev);
+w25q_result_t   w25q_trace_detach(w25q_trace_t* trace);
+void            w25q_trace_enable(w25q_trace_t* trace, uint8_t enable);
+void            w25q_trace_clear(w25q_trace_t* trace);
+w25q_result_t   w25q_trace_export(w25q_trace_t* trace, w25q_trace_write_fn fn, void* arg);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* W25Q_TRACE_HDR_H */
@@ -0,0 +1,577 @@
+/**
+ * \file            w25q_txn.c
+ * \brief           Power-fail-atomic multi-page transactions implementation
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#include "w25q_txn.h"
+#include "w25q_crc.h"
+#include <stddef.h>
+
+#if W25Q_TXN_MAX_PAGES < 1 || W25Q_TXN_MAX_PAGES > 19
+#error "W25Q_TXN_MAX_PAGES must be between 1 and 19"
+#endif
+
+/* Commit record layout, stored little-endian in one journal page */
+#define W25Q_TXN_MAGIC                  0x54353257UL    /* "W25T" */
+#define W25Q_TXN_OFF_MAGIC              0
+#define W25Q_TXN_OFF_SEQ                4
+#define W25Q_TXN_OFF_ROOT               8
+#define W25Q_TXN_OFF_MODE               12
+#define W25Q_TXN_OFF_COUNT              13
+#define W25Q_TXN_OFF_ENTRIES            16
+#define W25Q_TXN_ENTRY_SIZE             12
+#define W25Q_TXN_OFF_APPLIED            252     /* Not covered by CRC, programmed to 0 once applied */
+#define W25Q_TXN_REC_SIZE               256
+
+/**
+ * \brief           Store 32-bit value as little-endian
+ * \param[out]      buf: Output buffer
+ * \param[in]       val: Value to store
+ */
+static void
+prv_put_u32(uint8_t* buf, uint32_t val) {
+    buf[0] = (uint8_t)val;
+    buf[1] = (uint8_t)(val >> 8);
+    buf[2] = (uint8_t)(val >> 16);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
+/**
+ * \brief           Load little-endian 32-bit value
+ * \param[in]       buf: Input buffer
+ * \return          Decoded value
+ */
+static uint32_t
+prv_get_u32(const uint8_t* buf) {
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8)
+           | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+/**
+ * \brief           Check if buffer holds erased flash only
+ * \param[in]       buf: Data to check
+ * \param[in]       len: Number of bytes
+ * \return          `1` if all bytes are `0xFF`, `0` otherwise
+ */
+static uint8_t
+prv_is_erased(const uint8_t* buf, uint32_t len) {
+    uint32_t i;
+
+    for (i = 0; i < len; ++i) {
+        if (buf[i] != 0xFF) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * \brief           Get number of journal pages a transaction may need
+ *
+ * Journal mode stages one page per write, then copies every touched home
+ * sector into a journal sector of its own, which may skip up to one sector
+ * worth of pages for alignment. Both modes end with a commit record.
+ *
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       mode: Transaction mode
+ * \return          Number of pages, including one page of slack
+ */
+static uint32_t
+prv_need_pages(const w25q_t* dev, w25q_txn_mode_t mode) {
+    uint32_t pps = dev->info.sector_size / dev->info.page_size;
+
+    if (mode == W25Q_TXN_SHADOW) {
+        return W25Q_TXN_MAX_PAGES + 2;
+    }
+    return W25Q_TXN_MAX_PAGES + (pps - 1) + W25Q_TXN_MAX_PAGES * pps + 2;
+}
+
+/**
+ * \brief           Get number of pages that can be allocated before the
+ *                  sector holding the newest commit record would be erased
+ * \param[in]       txn: Transaction handle
+ * \return          Number of free pages
+ */
+static uint32_t
+prv_free_pages(w25q_txn_t* txn) {
+    uint32_t protect;
+
+    if (!txn->has_commit) {
+        return txn->journal_size / txn->dev->info.page_size;
+    }
+    protect = txn->last_commit - (txn->last_commit % txn->dev->info.sector_size);
+    return ((protect + txn->journal_size - txn->head) % txn->journal_size) / txn->dev->info.page_size;
+}
+
+/**
+ * \brief           Allocate next journal page, erasing sectors on entry
+ * \param[in]       txn: Transaction handle
+ * \param[out]      offset: Offset of allocated page within journal area
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_alloc_page(w25q_txn_t* txn, uint32_t* offset) {
+    w25q_result_t res;
+
+    if ((txn->head % txn->dev->info.sector_size) == 0) {
+        if ((res = w25q_erase_sector(txn->dev, txn->journal_addr + txn->head)) != W25Q_OK) {
+            return res;
+        }
+    }
+    *offset = txn->head;
+    txn->head = (txn->head + txn->dev->info.page_size) % txn->journal_size;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Append commit record for current entries
+ * \param[in]       txn: Transaction handle
+ * \param[in]       mode: Mode stored in the record
+ * \param[in]       count: Number of entries stored in the record
+ * \param[in]       root: Root pointer stored in the record
+ * \param[in]       applied: Set to `1` to write record as already applied
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_write_commit(w25q_txn_t* txn, w25q_txn_mode_t mode, uint8_t count, uint32_t root, uint8_t applied) {
+    uint8_t rec[W25Q_TXN_REC_SIZE];
+    uint8_t* p;
+    uint32_t offset, i;
+    w25q_result_t res;
+
+    for (i = 0; i < sizeof(rec); ++i) {
+        rec[i] = 0xFF;
+    }
+    prv_put_u32(&rec[W25Q_TXN_OFF_MAGIC], W25Q_TXN_MAGIC);
+    prv_put_u32(&rec[W25Q_TXN_OFF_SEQ], txn->seq + 1);
+    prv_put_u32(&rec[W25Q_TXN_OFF_ROOT], root);
+    rec[W25Q_TXN_OFF_MODE] = (uint8_t)mode;
+    rec[W25Q_TXN_OFF_COUNT] = count;
+    p = &rec[W25Q_TXN_OFF_ENTRIES];
+    for (i = 0; i < count; ++i, p += W25Q_TXN_ENTRY_SIZE) {
+        prv_put_u32(&p[0], txn->entries[i].target);
+        prv_put_u32(&p[4], txn->entries[i].jaddr);
+        p[8] = (uint8_t)txn->entries[i].len;
+        p[9] = (uint8_t)(txn->entries[i].len >> 8);
+    }
+    prv_put_u32(p, W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, rec, (uint32_t)(p - rec))));
+    if (applied) {
+        prv_put_u32(&rec[W25Q_TXN_OFF_APPLIED], 0);
+    }
+
+    if ((res = prv_alloc_page(txn, &offset)) != W25Q_OK) {
+        return res;
+    }
+    if ((res = w25q_write_page(txn->dev, txn->journal_addr + offset, rec, sizeof(rec))) != W25Q_OK) {
+        return res;
+    }
+
+    /* Record is durable, it is now the newest commit */
+    txn->last_commit = offset;
+    txn->has_commit = 1;
+    txn->seq++;
+    txn->root = root;
+    txn->count = count;
+    txn->pending = !applied;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Copy journaled home sectors of newest commit back to their
+ *                  home location and mark the commit as applied
+ * \note            Safe to repeat after power loss, every home sector is
+ *                  erased and rewritten from its complete journal copy
+ * \param[in]       txn: Transaction handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_apply(w25q_txn_t* txn) {
+    uint8_t buf[W25Q_TXN_REC_SIZE];
+    const w25q_txn_entry_t* entry;
+    uint32_t pos, page_size;
+    uint8_t i;
+    w25q_result_t res;
+
+    page_size = txn->dev->info.page_size;
+    for (i = 0; i < txn->count; ++i) {
+        entry = &txn->entries[i];
+        if ((res = w25q_erase_sector(txn->dev, entry->target)) != W25Q_OK) {
+            return res;
+        }
+        for (pos = 0; pos < entry->len; pos += page_size) {
+            if ((res = w25q_read(txn->dev, entry->jaddr + pos, buf, page_size)) != W25Q_OK) {
+                return res;
+            }
+            if (!prv_is_erased(buf, page_size)
+                && (res = w25q_write_page(txn->dev, entry->target + pos, buf, page_size)) != W25Q_OK) {
+                return res;
+            }
+        }
+    }
+
+    prv_put_u32(buf, 0);
+    if ((res = w25q_write_page(txn->dev, txn->journal_addr + txn->last_commit + W25Q_TXN_OFF_APPLIED,
+                               buf, 4)) != W25Q_OK) {
+        return res;
+    }
+    txn->pending = 0;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Copy home sector into the journal with staged writes merged in
+ *
+ * The copy starts on a journal sector boundary and fills the whole sector,
+ * pages left erased are not programmed.
+ *
+ * \param[in]       txn: Transaction handle
+ * \param[in]       sector: Home sector address
+ * \param[out]      jaddr: Address of sector copy in journal
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+static w25q_result_t
+prv_copy_sector(w25q_txn_t* txn, uint32_t sector, uint32_t* jaddr) {
+    uint8_t buf[W25Q_TXN_REC_SIZE];
+    const w25q_txn_entry_t* entry;
+    uint32_t page, offset, page_size, sector_size;
+    uint8_t i;
+    w25q_result_t res;
+
+    page_size = txn->dev->info.page_size;
+    sector_size = txn->dev->info.sector_size;
+    if ((txn->head % sector_size) != 0) {
+        txn->head = (txn->head - (txn->head % sector_size) + sector_size) % txn->journal_size;
+    }
+    *jaddr = txn->journal_addr + txn->head;
+
+    for (page = sector; page < sector + sector_size; page += page_size) {
+        if ((res = prv_alloc_page(txn, &offset)) != W25Q_OK
+            || (res = w25q_read(txn->dev, page, buf, page_size)) != W25Q_OK) {
+            return res;
+        }
+
+        /* Later writes to the same bytes win */
+        for (i = 0; i < txn->count; ++i) {
+            entry = &txn->entries[i];
+            if (entry->target - (entry->target % page_size) == page
+                && (res = w25q_read(txn->dev, entry->jaddr, &buf[entry->target % page_size], entry->len))
+                       != W25Q_OK) {
+                return res;
+            }
+        }
+        if (!prv_is_erased(buf, page_size)
+            && (res = w25q_write_page(txn->dev, txn->journal_addr + offset, buf, page_size)) != W25Q_OK) {
+            return res;
+        }
+    }
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Read and validate commit record
+ * \param[in]       txn: Transaction handle
+ * \param[in]       offset: Record offset within journal area
+ * \param[out]      rec: Buffer for raw record
+ * \return          `1` if record is a valid commit, `0` otherwise
+ */
+static uint8_t
+prv_read_commit(w25q_txn_t* txn, uint32_t offset, uint8_t rec[W25Q_TXN_REC_SIZE]) {
+    uint32_t crc_off;
+
+    if (w25q_read(txn->dev, txn->journal_addr + offset, rec, W25Q_TXN_REC_SIZE) != W25Q_OK
+        || prv_get_u32(&rec[W25Q_TXN_OFF_MAGIC]) != W25Q_TXN_MAGIC
+        || rec[W25Q_TXN_OFF_COUNT] > W25Q_TXN_MAX_PAGES) {
+        return 0;
+    }
+    crc_off = W25Q_TXN_OFF_ENTRIES + (uint32_t)rec[W25Q_TXN_OFF_COUNT] * W25Q_TXN_ENTRY_SIZE;
+    return prv_get_u32(&rec[crc_off])
+           == W25Q_CRC32_FINAL(w25q_crc32_update(W25Q_CRC32_INIT, rec, crc_off));
+}
+
+/**
+ * \brief           Mount journal area and recover interrupted transactions
+ *
+ * Scans the journal for the newest commit record. If it was committed but
+ * not fully applied before power loss, its journaled home sectors are erased
+ * and copied home again.
+ *
+ * \param[in]       txn: Transaction handle
+ * \param[in]       dev: Initialized W25Q device handle
+ * \param[in]       journal_addr: Journal area start address (sector-aligned)
+ * \param[in]       journal_size: Journal area size, multiple of sector size, at least 2 sectors.
+ *                      \ref W25Q_TXN_JOURNAL mode needs one sector per write more, see \ref w25q_txn_begin
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_txn_mount(w25q_txn_t* txn, w25q_t* dev, uint32_t journal_addr, uint32_t journal_size) {
+    uint8_t rec[W25Q_TXN_REC_SIZE], magic[4];
+    const uint8_t* p;
+    uint32_t offset, seq, sector_size, page_size;
+    uint8_t i;
+
+    if (txn == NULL || dev == NULL || dev->initialized == 0) {
+        return W25Q_ERR_PARAM;
+    }
+
+    page_size = dev->info.page_size;
+    sector_size = dev->info.sector_size;
+    if ((journal_addr % sector_size) != 0 || (journal_size % sector_size) != 0
+        || journal_size < 2 * sector_size
+        || journal_size / page_size < sector_size / page_size + prv_need_pages(dev, W25Q_TXN_SHADOW)
+        || journal_addr + journal_size > dev->info.capacity_bytes) {
+        return W25Q_ERR_PARAM;
+    }
+
+    txn->dev = dev;
+    txn->journal_addr = journal_addr;
+    txn->journal_size = journal_size;
+    txn->head = 0;
+    txn->last_commit = 0;
+    txn->seq = 0;
+    txn->root = 0;
+    txn->has_commit = 0;
+    txn->pending = 0;
+    txn->active = 0;
+    txn->count = 0;
+
+    /* Find newest commit record, only commit pages start with the magic */
+    for (offset = 0; offset < journal_size; offset += page_size) {
+        if (w25q_read(dev, journal_addr + offset, magic, sizeof(magic)) != W25Q_OK) {
+            return W25Q_ERR;
+        }
+        if (prv_get_u32(magic) != W25Q_TXN_MAGIC || !prv_read_commit(txn, offset, rec)) {
+            continue;
+        }
+        seq = prv_get_u32(&rec[W25Q_TXN_OFF_SEQ]);
+        if (txn->has_commit && (int32_t)(seq - txn->seq) <= 0) {
+            continue;
+        }
+
+        txn->has_commit = 1;
+        txn->last_commit = offset;
+        txn->seq = seq;
+        txn->root = prv_get_u32(&rec[W25Q_TXN_OFF_ROOT]);
+        txn->pending = prv_get_u32(&rec[W25Q_TXN_OFF_APPLIED]) != 0;
+        txn->count = rec[W25Q_TXN_OFF_COUNT];
+        p = &rec[W25Q_TXN_OFF_ENTRIES];
+        for (i = 0; i < txn->count; ++i, p += W25Q_TXN_ENTRY_SIZE) {
+            txn->entries[i].target = prv_get_u32(&p[0]);
+            txn->entries[i].jaddr = prv_get_u32(&p[4]);
+            txn->entries[i].len = (uint16_t)(p[8] | (p[9] << 8));
+        }
+    }
+
+    /* Pages after the newest commit may hold an aborted transaction, continue on next sector */
+    if (txn->has_commit) {
+        txn->head = (txn->last_commit - (txn->last_commit % sector_size) + sector_size) % journal_size;
+        if (txn->pending) {
+            return prv_apply(txn);
+        }
+    }
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Get root pointer of newest commit
+ * \param[in]       txn: Transaction handle
+ * \param[out]      root: Pointer to store root value
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR if nothing was committed yet,
+ *                      member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_txn_get_root(w25q_txn_t* txn, uint32_t* root) {
+    if (txn == NULL || txn->dev == NULL || root == NULL) {
+        return W25Q_ERR_PARAM;
+    }
+    if (!txn->has_commit) {
+        return W25Q_ERR;
+    }
+    *root = txn->root;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Begin new transaction
+ * \param[in]       txn: Mounted transaction handle
+ * \param[in]       mode: Transaction mode.
+ *                      In \ref W25Q_TXN_JOURNAL mode writes are staged in the journal, and
+ *                      commit copies every touched home sector with the writes merged into
+ *                      the journal before home sectors are erased and rewritten. Journal
+ *                      area must hold `W25Q_TXN_MAX_PAGES + 2` sectors plus
+ *                      `W25Q_TXN_MAX_PAGES + 1` pages.
+ *                      In \ref W25Q_TXN_SHADOW mode writes go directly to (erased, unreferenced)
+ *                      target pages and the commit only publishes the new root pointer
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR_PARAM if journal area is too
+ *                      small for the mode, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_txn_begin(w25q_txn_t* txn, w25q_txn_mode_t mode) {
+    uint32_t need;
+    w25q_result_t res;
+
+    if (txn == NULL || txn->dev == NULL || txn->active
+        || (mode != W25Q_TXN_JOURNAL && mode != W25Q_TXN_SHADOW)) {
+        return W25Q_ERR_PARAM;
+    }
+    need = prv_need_pages(txn->dev, mode);
+    if (txn->journal_size / txn->dev->info.page_size
+        < txn->dev->info.sector_size / txn->dev->info.page_size + need) {
+        return W25Q_ERR_PARAM;
+    }
+
+    /* Finish previous commit if its apply phase failed */
+    if (txn->pending && (res = prv_apply(txn)) != W25Q_OK) {
+        return res;
+    }
+
+    /*
+     * Transaction must not erase the sector holding newest commit. Carry root
+     * forward when the ring is short.
+     */
+    if (prv_free_pages(txn) < need) {
+        if ((res = prv_write_commit(txn, W25Q_TXN_SHADOW, 0, txn->root, 1)) != W25Q_OK) {
+            return res;
+        }
+    }
+
+    txn->mode = mode;
+    txn->count = 0;
+    txn->active = 1;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Stage write of data within one page
+ * \param[in]       txn: Transaction handle
+ * \param[in]       address: Target address. In \ref W25Q_TXN_SHADOW mode it must point to
+ *                      erased memory, in \ref W25Q_TXN_JOURNAL mode it may hold old data
+ * \param[in]       data: Data to write
+ * \param[in]       len: Number of bytes, write must not cross page boundary
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_txn_write(w25q_txn_t* txn, uint32_t address, const uint8_t* data, uint32_t len) {
+    w25q_txn_entry_t* entry;
+    uint32_t page_size, offset;
+    w25q_result_t res;
+
+    if (txn == NULL || !txn->active || data == NULL || len == 0) {
+        return W25Q_ERR_PARAM;
+    }
+    page_size = txn->dev->info.page_size;
+    if ((address % page_size) + len > page_size || txn->count >= W25Q_TXN_MAX_PAGES
+        || (address < txn->journal_addr + txn->journal_size && address + len > txn->journal_addr)) {
+        return W25Q_ERR_PARAM;
+    }
+
+    entry = &txn->entries[txn->count];
+    entry->target = address;
+    entry->len = (uint16_t)len;
+    if (txn->mode == W25Q_TXN_JOURNAL) {
+        if ((res = prv_alloc_page(txn, &offset)) != W25Q_OK) {
+            return res;
+        }
+        entry->jaddr = txn->journal_addr + offset;
+        res = w25q_write_page(txn->dev, entry->jaddr, data, len);
+    } else {
+        entry->jaddr = 0;
+        res = w25q_write_page(txn->dev, address, data, len);
+    }
+    if (res != W25Q_OK) {
+        return res;
+    }
+    txn->count++;
+    return W25Q_OK;
+}
+
+/**
+ * \brief           Commit transaction with a single page program
+ * \param[in]       txn: Transaction handle
+ * \param[in]       root: Root pointer to publish, returned by \ref w25q_txn_get_root
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise.
+ *                      If an error is returned after the commit record was written,
+ *                      remaining copies are redone on next begin or mount
+ */
+w25q_result_t
+w25q_txn_commit(w25q_txn_t* txn, uint32_t root) {
+    w25q_txn_entry_t copies[W25Q_TXN_MAX_PAGES];
+    uint32_t sector;
+    uint8_t i, j, n = 0;
+    w25q_result_t res;
+
+    if (txn == NULL || !txn->active) {
+        return W25Q_ERR_PARAM;
+    }
+    txn->active = 0;
+
+    if (txn->mode == W25Q_TXN_SHADOW) {
+        return prv_write_commit(txn, W25Q_TXN_SHADOW, 0, root, 1);
+    }
+
+    /* Journal every touched home sector, erasing it in place must not lose the rest of it */
+    for (i = 0; i < txn->count; ++i) {
+        sector = txn->entries[i].target - (txn->entries[i].target % txn->dev->info.sector_size);
+        for (j = 0; j < n && copies[j].target != sector; ++j) {}
+        if (j < n) {
+            continue;
+        }
+        copies[n].target = sector;
+        copies[n].len = (uint16_t)txn->dev->info.sector_size;
+        if ((res = prv_copy_sector(txn, sector, &copies[n].jaddr)) != W25Q_OK) {
+            return res;
+        }
+        n++;
+    }
+    for (i = 0; i < n; ++i) {
+        txn->entries[i] = copies[i];
+    }
+    if ((res = prv_write_commit(txn, W25Q_TXN_JOURNAL, n, root, 0)) != W25Q_OK) {
+        return res;
+    }
+    return prv_apply(txn);
+}
+
+/**
+ * \brief           Abort transaction
+ * \note            Journal pages already used are skipped, not reused.
+ *                  In shadow mode the written target pages are simply unreferenced
+ * \param[in]       txn: Transaction handle
+ * \return          \ref W25Q_OK on success, member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_txn_abort(w25q_txn_t* txn) {
+    if (txn == NULL || !txn->active) {
+        return W25Q_ERR_PARAM;
+    }
+    txn->active = 0;
+    txn->count = 0;
+    return W25Q_OK;
+}
@@ -0,0 +1,104 @@
+/**
+ * \file            w25q_txn.h
+ * \brief           Power-fail-atomic multi-page transactions for W25Q flash library
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef W25Q_TXN_HDR_H
+#define W25Q_TXN_HDR_H
+
+#include <stdint.h>
+#include "w25q.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           Maximum number of page writes in one transaction
+ * \note            Commit record must fit one page, maximum value is `19`
+ */
+#ifndef W25Q_TXN_MAX_PAGES
+#define W25Q_TXN_MAX_PAGES              8
+#endif
+
+/**
+ * \brief           Transaction mode
+ */
+typedef enum {
+    W25Q_TXN_JOURNAL = 0x00,                    /*!< Journal home sectors, rewrite them after commit */
+    W25Q_TXN_SHADOW,                            /*!< Write pages out-of-place, commit flips root pointer */
+} w25q_txn_mode_t;
+
+/**
+ * \brief           Staged page write
+ */
+typedef struct {
+    uint32_t target;                            /*!< Home address of data, home sector once committed */
+    uint32_t jaddr;                             /*!< Journal address holding data (journal mode only) */
+    uint16_t len;                               /*!< Data length */
+} w25q_txn_entry_t;
+
+/**
+ * \brief           Transaction handle
+ *
+ * The journal area is a ring of pages. Every commit appends a single-page
+ * commit record, in journal mode preceded by one journal page per write
+ * and one journal sector per touched home sector.
+ */
+typedef struct {
+    w25q_t* dev;                                /*!< Flash device */
+    uint32_t journal_addr;                      /*!< Journal area start (sector-aligned) */
+    uint32_t journal_size;                      /*!< Journal area size (multiple of sector size) */
+    uint32_t head;                              /*!< Next free journal page offset */
+    uint32_t last_commit;                       /*!< Offset of newest commit record */
+    uint32_t seq;                               /*!< Sequence number of newest commit */
+    uint32_t root;                              /*!< Root pointer of newest commit */
+    uint8_t has_commit;                         /*!< Set to `1` when `last_commit` is valid */
+    uint8_t pending;                            /*!< Set to `1` when newest commit is not yet applied */
+    uint8_t active;                             /*!< Set to `1` between begin and commit/abort */
+    w25q_txn_mode_t mode;                       /*!< Mode of active transaction */
+    uint8_t count;                              /*!< Number of staged writes */
+    w25q_txn_entry_t entries[W25Q_TXN_MAX_PAGES];   /*!< Staged writes */
+} w25q_txn_t;
+
+/* Public function prototypes */
+w25q_result_t   w25q_txn_mount(w25q_txn_t* txn, w25q_t* dev, uint32_t journal_addr, uint32_t journal_size);
+w25q_result_t   w25q_txn_get_root(w25q_txn_t* txn, uint32_t* root);
+w25q_result_t   w25q_txn_begin(w25q_txn_t* txn, w25q_txn_mode_t mode);
+w25q_result_t   w25q_txn_write(w25q_txn_t* txn, uint32_t address, const uint8_t* data, uint32_t len);
+w25q_result_t   w25q_txn_commit(w25q_txn_t* txn, uint32_t root);
+w25q_result_t   w25q_txn_abort(w25q_txn_t* txn);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* W25Q_TXN_HDR_H */
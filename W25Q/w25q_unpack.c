@@ -0,0 +1,325 @@
+/**
+ * \file            w25q_unpack.c
+ * \brief           Streaming LZ/delta image decoder implementation
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#include "w25q_unpack.h"
+#include <stddef.h>
+
+/* Delta patch opcodes */
+#define W25Q_DELTA_OP_COPY              0x01    /* varint offset, varint length */
+#define W25Q_DELTA_OP_INSERT            0x02    /* varint length, literal bytes */
+#define W25Q_DELTA_OP_DIFF              0x03    /* varint offset, varint length, bytes added to old */
+
+/* LZ match token: 12-bit distance - 1, 4-bit length - 3, length nibble 15 adds next byte */
+#define W25Q_LZ_MIN_MATCH               3
+#define W25Q_LZ_LEN_EXT                 15
+
+#define W25Q_UNPACK_WINDOW_MASK         ((1UL << W25Q_UNPACK_WINDOW_BITS) - 1)
+
+/* Byte pull results */
+#define PRV_BYTE                        1
+#define PRV_END                         0
+#define PRV_ERR                         (-1)
+
+/**
+ * \brief           Get next byte of packed stream from flash
+ * \param[in]       ctx: Decoder state
+ * \param[out]      b: Byte
+ * \return          \ref PRV_BYTE, \ref PRV_END or \ref PRV_ERR
+ */
+static int
+prv_in_byte(w25q_unpack_t* ctx, uint8_t* b) {
+    uint32_t chunk;
+
+    if (ctx->in_pos == ctx->in_len) {
+        if (ctx->in_left == 0) {
+            return PRV_END;
+        }
+        chunk = ctx->in_left > sizeof(ctx->in_buf) ? sizeof(ctx->in_buf) : ctx->in_left;
+        if (w25q_read(ctx->dev, ctx->in_addr, ctx->in_buf, chunk) != W25Q_OK) {
+            return PRV_ERR;
+        }
+        ctx->in_addr += chunk;
+        ctx->in_left -= chunk;
+        ctx->in_pos = 0;
+        ctx->in_len = (uint16_t)chunk;
+    }
+    *b = ctx->in_buf[ctx->in_pos++];
+    return PRV_BYTE;
+}
+
+/**
+ * \brief           Get next byte after LZ decoding, or raw stream byte if not compressed
+ * \param[in]       ctx: Decoder state
+ * \param[out]      b: Byte
+ * \return          \ref PRV_BYTE, \ref PRV_END or \ref PRV_ERR
+ */
+static int
+prv_lz_byte(w25q_unpack_t* ctx, uint8_t* b) {
+    uint8_t lo, hi, ext;
+    int r;
+
+    if (!(ctx->cfg->format & W25Q_UNPACK_LZ)) {
+        return prv_in_byte(ctx, b);
+    }
+
+    if (ctx->match_len == 0) {
+        if (ctx->flag_cnt == 0) {
+            if ((r = prv_in_byte(ctx, &ctx->flags)) != PRV_BYTE) {
+                return r;
+            }
+            ctx->flag_cnt = 8;
+        }
+        ctx->flag_cnt--;
+        if (ctx->flags & 0x01) {
+            ctx->flags >>= 1;
+            if ((r = prv_in_byte(ctx, b)) != PRV_BYTE) {
+                return r;
+            }
+            ctx->window[ctx->win_pos] = *b;
+            ctx->win_pos = (uint16_t)((ctx->win_pos + 1) & W25Q_UNPACK_WINDOW_MASK);
+            return PRV_BYTE;
+        }
+        ctx->flags >>= 1;
+
+        /* Truncated token is a format error, clean end only happens between tokens */
+        if ((r = prv_in_byte(ctx, &lo)) != PRV_BYTE) {
+            return r;
+        }
+        if (prv_in_byte(ctx, &hi) != PRV_BYTE) {
+            return PRV_ERR;
+        }
+        ctx->match_dist = (uint16_t)((lo | ((hi & 0x0F) << 8)) + 1);
+        ctx->match_len = (uint16_t)((hi >> 4) + W25Q_LZ_MIN_MATCH);
+        if ((hi >> 4) == W25Q_LZ_LEN_EXT) {
+            if (prv_in_byte(ctx, &ext) != PRV_BYTE) {
+                return PRV_ERR;
+            }
+            ctx->match_len += ext;
+        }
+        if (ctx->match_dist > (1UL << ctx->cfg->window_bits)) {
+            return PRV_ERR;
+        }
+    }
+
+    *b = ctx->window[(ctx->win_pos - ctx->match_dist) & W25Q_UNPACK_WINDOW_MASK];
+    ctx->window[ctx->win_pos] = *b;
+    ctx->win_pos = (uint16_t)((ctx->win_pos + 1) & W25Q_UNPACK_WINDOW_MASK);
+    ctx->match_len--;
+    return PRV_BYTE;
+}
+
+/**
+ * \brief           Read LEB128 varint from LZ layer
+ * \param[in]       ctx: Decoder state
+ * \param[out]      val: Decoded value
+ * \return          `1` on success, `0` otherwise
+ */
+static uint8_t
+prv_varint(w25q_unpack_t* ctx, uint32_t* val) {
+    uint8_t b, shift;
+
+    *val = 0;
+    for (shift = 0; shift < 35; shift += 7) {
+        if (prv_lz_byte(ctx, &b) != PRV_BYTE) {
+            return 0;
+        }
+        *val |= (uint32_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief           Flush output buffer to sink
+ * \param[in]       ctx: Decoder state
+ * \return          `1` on success, `0` otherwise
+ */
+static uint8_t
+prv_flush(w25q_unpack_t* ctx) {
+    uint8_t ok = 1;
+
+    if (ctx->out_len > 0) {
+        ok = ctx->cfg->sink(ctx->cfg->arg, ctx->out_pos - ctx->out_len, ctx->out_buf, ctx->out_len);
+        ctx->out_len = 0;
+    }
+    return ok;
+}
+
+/**
+ * \brief           Emit one decoded byte
+ * \param[in]       ctx: Decoder state
+ * \param[in]       b: Byte
+ * \return          `1` on success, `0` otherwise
+ */
+static uint8_t
+prv_out_byte(w25q_unpack_t* ctx, uint8_t b) {
+    if (ctx->out_pos >= ctx->cfg->out_size) {
+        return 0;
+    }
+    ctx->out_buf[ctx->out_len++] = b;
+    ctx->out_pos++;
+    if (ctx->out_len == sizeof(ctx->out_buf)) {
+        return prv_flush(ctx);
+    }
+    return 1;
+}
+
+/**
+ * \brief           Get byte of old image for delta patch
+ * \param[in]       ctx: Decoder state
+ * \param[in]       idx: Old image offset
+ * \param[out]      b: Byte
+ * \return          `1` on success, `0` if offset is out of range or already overwritten
+ */
+static uint8_t
+prv_old_byte(w25q_unpack_t* ctx, uint32_t idx, uint8_t* b) {
+    const w25q_unpack_cfg_t* cfg = ctx->cfg;
+
+    if (idx >= cfg->old_size) {
+        return 0;
+    }
+    if (cfg->inplace_page > 0 && idx < ctx->out_pos - (ctx->out_pos % cfg->inplace_page)) {
+        return 0;
+    }
+    *b = cfg->old[idx];
+    return 1;
+}
+
+/**
+ * \brief           Apply delta patch stream
+ * \param[in]       ctx: Decoder state
+ * \return          `1` on success, `0` otherwise
+ */
+static uint8_t
+prv_delta(w25q_unpack_t* ctx) {
+    uint32_t off, len, i;
+    uint8_t op, b, old;
+
+    while (ctx->out_pos < ctx->cfg->out_size) {
+        if (prv_lz_byte(ctx, &op) != PRV_BYTE) {
+            return 0;
+        }
+        off = 0;
+        if ((op == W25Q_DELTA_OP_COPY || op == W25Q_DELTA_OP_DIFF) && !prv_varint(ctx, &off)) {
+            return 0;
+        }
+        if (!prv_varint(ctx, &len)) {
+            return 0;
+        }
+
+        for (i = 0; i < len; ++i) {
+            switch (op) {
+                case W25Q_DELTA_OP_COPY:
+                    if (!prv_old_byte(ctx, off + i, &b)) {
+                        return 0;
+                    }
+                    break;
+                case W25Q_DELTA_OP_INSERT:
+                    if (prv_lz_byte(ctx, &b) != PRV_BYTE) {
+                        return 0;
+                    }
+                    break;
+                case W25Q_DELTA_OP_DIFF:
+                    if (!prv_old_byte(ctx, off + i, &old) || prv_lz_byte(ctx, &b) != PRV_BYTE) {
+                        return 0;
+                    }
+                    b = (uint8_t)(b + old);
+                    break;
+                default:
+                    return 0;
+            }
+            if (!prv_out_byte(ctx, b)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * \brief           Decode packed image from flash into sink
+ *
+ * Data is pulled from flash with \ref w25q_read in small chunks and decoded
+ * with a fixed RAM window, so the decoded image never has to fit into RAM.
+ *
+ * \param[in]       ctx: Decoder state, can be statically allocated
+ * \param[in]       dev: W25Q device handle
+ * \param[in]       address: Flash address of packed stream
+ * \param[in]       len: Packed stream length
+ * \param[in]       cfg: Decoder configuration, must stay valid during the call
+ * \return          \ref W25Q_OK on success, \ref W25Q_ERR on malformed stream or sink error,
+ *                      member of \ref w25q_result_t otherwise
+ */
+w25q_result_t
+w25q_unpack(w25q_unpack_t* ctx, w25q_t* dev, uint32_t address, uint32_t len,
+            const w25q_unpack_cfg_t* cfg) {
+    uint8_t b;
+    uint32_t i;
+    int r;
+
+    if (ctx == NULL || dev == NULL || cfg == NULL || cfg->sink == NULL
+        || ((cfg->format & W25Q_UNPACK_LZ) && cfg->window_bits > W25Q_UNPACK_WINDOW_BITS)
+        || ((cfg->format & W25Q_UNPACK_DELTA) && cfg->old == NULL)
+        || (cfg->format & ~(W25Q_UNPACK_LZ | W25Q_UNPACK_DELTA))) {
+        return W25Q_ERR_PARAM;
+    }
+
+    ctx->dev = dev;
+    ctx->cfg = cfg;
+    ctx->in_addr = address;
+    ctx->in_left = len;
+    ctx->in_pos = ctx->in_len = 0;
+    ctx->flags = ctx->flag_cnt = 0;
+    ctx->match_len = ctx->match_dist = 0;
+    ctx->win_pos = 0;
+    ctx->out_pos = 0;
+    ctx->out_len = 0;
+    for (i = 0; i < sizeof(ctx->window); ++i) {
+        ctx->window[i] = 0;
+    }
+
+    if (cfg->format & W25Q_UNPACK_DELTA) {
+        if (!prv_delta(ctx)) {
+            return W25Q_ERR;
+        }
+    } else {
+        while (ctx->out_pos < cfg->out_size) {
+            if ((r = prv_lz_byte(ctx, &b)) != PRV_BYTE || !prv_out_byte(ctx, b)) {
+                return W25Q_ERR;
+            }
+        }
+    }
+    return prv_flush(ctx) ? W25Q_OK : W25Q_ERR;
+}
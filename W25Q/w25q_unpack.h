@@ -0,0 +1,129 @@
+/**
+ * \file            w25q_unpack.h
+ * \brief           Streaming LZ/delta image decoder for W25Q flash library
+ */
+
+/*
+ * Copyright (c) 2025 Pham Nam Hien
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE
+ * AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * This file is part of W25Q flash library.
+ *
+ * Author:          Pham Nam Hien <phamnamhien@gmail.com>
+ * Version:         v1.0.1
+ */
+#ifndef W25Q_UNPACK_HDR_H
+#define W25Q_UNPACK_HDR_H
+
+#include <stdint.h>
+#include "w25q.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * \brief           Log2 of LZ history window size kept in RAM
+ * \note            Streams packed with a larger window are rejected
+ */
+#ifndef W25Q_UNPACK_WINDOW_BITS
+#define W25Q_UNPACK_WINDOW_BITS         10
+#endif
+
+/**
+ * \brief           Size of input buffer, bytes read from flash per command
+ */
+#ifndef W25Q_UNPACK_IN_SIZE
+#define W25Q_UNPACK_IN_SIZE             128
+#endif
+
+/**
+ * \brief           Size of output buffer, bytes passed to sink per call
+ */
+#ifndef W25Q_UNPACK_OUT_SIZE
+#define W25Q_UNPACK_OUT_SIZE            128
+#endif
+
+/**
+ * \brief           Stream format flags
+ */
+#define W25Q_UNPACK_RAW                 0x00    /*!< Stored as is */
+#define W25Q_UNPACK_LZ                  0x01    /*!< LZ compressed */
+#define W25Q_UNPACK_DELTA               0x02    /*!< Delta patch against old image */
+
+/**
+ * \brief           Output sink callback
+ * \param[in]       arg: User argument from \ref w25q_unpack_cfg_t
+ * \param[in]       offset: Output offset of first byte
+ * \param[in]       data: Decoded data
+ * \param[in]       len: Number of bytes
+ * \return          `1` on success, `0` to abort decoding
+ */
+typedef uint8_t (*w25q_unpack_sink_fn)(void* arg, uint32_t offset, const uint8_t* data, uint32_t len);
+
+/**
+ * \brief           Decoder configuration
+ */
+typedef struct {
+    uint8_t format;                             /*!< Combination of `W25Q_UNPACK_*` flags */
+    uint8_t window_bits;                        /*!< LZ window bits the stream was packed with */
+    uint32_t out_size;                          /*!< Decoded size in bytes */
+    const uint8_t* old;                         /*!< Old image for delta patches, memory-mapped */
+    uint32_t old_size;                          /*!< Old image size */
+    uint32_t inplace_page;                      /*!< Page size when output overwrites `old` in place,
+                                                        `0` otherwise. Delta may only reference old data
+                                                        at or after the output page being written */
+    w25q_unpack_sink_fn sink;                   /*!< Output sink */
+    void* arg;                                  /*!< User argument for sink */
+} w25q_unpack_cfg_t;
+
+/**
+ * \brief           Decoder state, a few hundred bytes plus LZ window
+ */
+typedef struct {
+    w25q_t* dev;                                /*!< Flash device */
+    const w25q_unpack_cfg_t* cfg;               /*!< Configuration */
+    uint32_t in_addr;                           /*!< Next flash address to read */
+    uint32_t in_left;                           /*!< Bytes left in flash */
+    uint16_t in_pos;                            /*!< Read position in input buffer */
+    uint16_t in_len;                            /*!< Valid bytes in input buffer */
+    uint8_t flags;                              /*!< Remaining LZ flag bits */
+    uint8_t flag_cnt;                           /*!< Number of remaining LZ flag bits */
+    uint16_t match_len;                         /*!< Remaining bytes of current LZ match */
+    uint16_t match_dist;                        /*!< Distance of current LZ match */
+    uint16_t win_pos;                           /*!< Write position in LZ window */
+    uint32_t out_pos;                           /*!< Number of decoded bytes */
+    uint16_t out_len;                           /*!< Bytes in output buffer */
+    uint8_t in_buf[W25Q_UNPACK_IN_SIZE];        /*!< Input buffer */
+    uint8_t out_buf[W25Q_UNPACK_OUT_SIZE];      /*!< Output buffer */
+    uint8_t window[1UL << W25Q_UNPACK_WINDOW_BITS]; /*!< LZ history window */
+} w25q_unpack_t;
+
+/* Public function prototypes */
+w25q_result_t   w25q_unpack(w25q_unpack_t* ctx, w25q_t* dev, uint32_t address, uint32_t len,
+                            const w25q_unpack_cfg_t* cfg);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* W25Q_UNPACK_HDR_H */